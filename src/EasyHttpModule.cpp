@@ -1,6 +1,7 @@
 #include "EasyHttpModule.h"
 #include "easy_http/EasyHttp.h"
 #include "utils/TraceLog.h"
+#include <algorithm>
 #include <cassert>
 #include <utility>
 
@@ -21,10 +22,18 @@ namespace
     }
 }
 
-EasyHttpModule::EasyHttpModule(std::string ca_cert_path) : ca_cert_path_(std::move(ca_cert_path))
+EasyHttpModule::EasyHttpModule(std::string ca_cert_path, std::string disk_cache_directory) : ca_cert_store_(std::make_shared<CaCertStore>(std::move(ca_cert_path))),
+                                                                                             tls_session_cache_(std::make_shared<TlsSessionCache>()),
+                                                                                             origins_(std::make_shared<OriginRegistry>(kMaxOrigins)),
+                                                                                             session_reaper_(std::make_shared<SessionReaper>(std::chrono::seconds(kSessionReapIntervalSeconds), kMaxPooledSessions)),
+                                                                                             executor_(std::make_shared<RequestExecutor>(kMaxExecutorThreads, 0)),
+                                                                                             host_rate_limiter_(std::make_shared<RateLimiter>()),
+                                                                                             host_connect_policies_(std::make_shared<ConnectPolicies>()),
+                                                                                             response_cache_(std::make_shared<ResponseCache>(kDefaultResponseCacheBytes)),
+                                                                                             disk_cache_directory_(std::move(disk_cache_directory))
 {
     // as this is a first insertion in queue then these EasyHttps will have QueueId == 1 and therefore QueueId == QueueId::Main
-    CreateQueue();
+    CreateQueue(kMainQueueThreads, kMainQueueMinThreads, kMainQueueMaxPerHost);
     ezhttp::trace::Writef("EasyHttpModule", "ctor this=%p main_queue_created queues=%zu", this, easy_http_pack_.size());
 }
 
@@ -33,6 +42,10 @@ EasyHttpModule::~EasyHttpModule()
     ezhttp::trace::Writef("EasyHttpModule", "dtor begin this=%p forgotten=%zu requests=%zu queues=%zu", this, forgotten_easy_http_.size(), requests_.size(), easy_http_pack_.size());
     ShutdownWithoutCallbacks();
 
+    // requests waiting for rate limits, a retry backoff or a server block could hold the unload for minutes
+    for (auto &forgotten_ez : forgotten_easy_http_)
+        forgotten_ez->DropPendingRequests();
+
     while (!forgotten_easy_http_.empty())
         RunCleanupFrameForForgottenEasyHttp();
 
@@ -44,6 +57,7 @@ void EasyHttpModule::RunFrame()
     RunFrameEasyHttp();
     RunCleanupFrameForForgottenEasyHttp();
     CleanupCompletedForgottenRequests();
+    executor_->RunFrame();
 }
 
 void EasyHttpModule::ServerDeactivate()
@@ -62,15 +76,170 @@ RequestId EasyHttpModule::SendRequest(
     int callback_data_len,
     OptionsId source_options_id)
 {
-    QueueId queue_id = options.queue_id;
-    if (!IsQueueExists(queue_id))
+    if (!CanSendRequest(options, url))
+        return RequestId::Null;
+
+    RequestId request_id = AddRequest(options, callback_id, std::move(callback_data), callback_data_len, source_options_id);
+    RequestData &request = GetRequest(request_id);
+
+    auto &easy_http = GetEasyHttp(options.queue_id, options.plugin_end_behaviour);
+    request.request_control = easy_http->SendRequest(method, url, options.options_builder.Snapshot(), CreateResponseCallback(request_id, request.generation));
+
+    ezhttp::trace::Writef(
+        "EasyHttpModule",
+        "SendRequest request=%d generation=%u queue=%d behaviour=%d callback_id=%d control=%p url=%s",
+        static_cast<int>(request_id),
+        request.generation,
+        static_cast<int>(options.queue_id),
+        static_cast<int>(options.plugin_end_behaviour),
+        callback_id,
+        request.request_control.get(),
+        url.c_str());
+
+    return request_id;
+}
+
+BatchId EasyHttpModule::CreateBatch()
+{
+    BatchData batch;
+    batch.generation = ++next_batch_generation_;
+    return batches_.Add(std::move(batch));
+}
+
+int EasyHttpModule::AddBatchRequest(BatchId handle, RequestMethod method, const std::string &url, OptionsData options, OptionsId source_options_id)
+{
+    BatchData &batch = batches_.at(handle);
+    batch.requests.push_back(BatchRequestData{method, url, std::move(options), source_options_id});
+    return static_cast<int>(batch.requests.size()) - 1;
+}
+
+size_t EasyHttpModule::SendBatch(BatchId handle, int callback_id, int done_callback_id, std::unique_ptr<cell[]> callback_data, int callback_data_len)
+{
+    BatchData &batch = batches_.at(handle);
+    std::vector<BatchRequestData> batch_requests = std::move(batch.requests);
+    batch.requests.clear();
+    batch.sent = true;
+    batch.callback_id = callback_id;
+    batch.done_callback_id = done_callback_id;
+    batch.callback_data = std::move(callback_data);
+    batch.callback_data_len = callback_data_len;
+
+    // requests going to the same EasyHttp are enqueued together
+    struct EasyHttpRequests
+    {
+        EasyHttpInterface *easy_http;
+        std::vector<EasyHttpInterface::BatchRequest> requests;
+        std::vector<RequestId> request_ids;
+    };
+    std::vector<EasyHttpRequests> easy_http_requests;
+
+    for (size_t i = 0; i < batch_requests.size(); ++i)
+    {
+        BatchRequestData &batch_request = batch_requests[i];
+        if (!CanSendRequest(batch_request.options, batch_request.url))
+            continue;
+
+        std::unique_ptr<cell[]> request_data;
+        if (batch.callback_data)
+        {
+            request_data = std::make_unique<cell[]>(callback_data_len);
+            std::copy_n(batch.callback_data.get(), callback_data_len, request_data.get());
+        }
+
+        RequestId request_id = AddRequest(batch_request.options, callback_id, std::move(request_data), callback_data_len, batch_request.source_options_id);
+        RequestData &request = GetRequest(request_id);
+        request.batch_id = handle;
+        request.batch_generation = batch.generation;
+        request.batch_index = static_cast<int>(i);
+
+        EasyHttpInterface *easy_http = GetEasyHttp(batch_request.options.queue_id, batch_request.options.plugin_end_behaviour).get();
+        auto it = std::find_if(easy_http_requests.begin(), easy_http_requests.end(), [easy_http](const EasyHttpRequests &item)
+                               { return item.easy_http == easy_http; });
+        if (it == easy_http_requests.end())
+            it = easy_http_requests.insert(easy_http_requests.end(), EasyHttpRequests{easy_http, {}, {}});
+
+        it->requests.push_back(EasyHttpInterface::BatchRequest{
+            batch_request.method,
+            cpr::Url{batch_request.url},
+            batch_request.options.options_builder.Snapshot(),
+            CreateResponseCallback(request_id, request.generation)});
+        it->request_ids.push_back(request_id);
+    }
+
+    size_t sent = 0;
+    for (auto &item : easy_http_requests)
+    {
+        std::vector<std::shared_ptr<RequestControl>> request_controls = item.easy_http->SendRequests(std::move(item.requests));
+        for (size_t i = 0; i < item.request_ids.size(); ++i)
+            GetRequest(item.request_ids[i]).request_control = std::move(request_controls[i]);
+
+        sent += item.request_ids.size();
+    }
+
+    batch.remaining = sent;
+    ezhttp::trace::Writef("EasyHttpModule", "SendBatch batch=%d requests=%zu sent=%zu callback_id=%d done_callback_id=%d", static_cast<int>(handle), batch_requests.size(), sent, callback_id, done_callback_id);
+
+    // nothing will complete, so the batch is over right away
+    if (sent == 0)
+    {
+        ReleaseBatchForwards(batch);
+        batches_.Remove(handle);
+    }
+
+    return sent;
+}
+
+TemplateId EasyHttpModule::CreateTemplate(RequestMethod method, UrlTemplate url_template, OptionsData options)
+{
+    return templates_.Add(TemplateData{method, std::move(url_template), std::move(options)});
+}
+
+RequestId EasyHttpModule::SendTemplateRequest(TemplateId handle, const std::string &url, int callback_id)
+{
+    const TemplateData &request_template = templates_.at(handle);
+    const OptionsData &options = request_template.options;
+    if (!CanSendRequest(options, url))
+        return RequestId::Null;
+
+    RequestId request_id = AddRequest(options, callback_id, nullptr, 0, OptionsId::Null);
+    RequestData &request = GetRequest(request_id);
+
+    std::vector<EasyHttpInterface::BatchRequest> requests;
+    requests.push_back(EasyHttpInterface::BatchRequest{
+        request_template.method,
+        cpr::Url{url},
+        options.options_builder.Snapshot(),
+        CreateResponseCallback(request_id, request.generation),
+        request_template.url_template.GetHost(),
+        request_template.url_template.GetOrigin()});
+
+    auto &easy_http = GetEasyHttp(options.queue_id, options.plugin_end_behaviour);
+    request.request_control = easy_http->SendRequests(std::move(requests)).front();
+
+    ezhttp::trace::Writef(
+        "EasyHttpModule",
+        "SendTemplateRequest template=%d request=%d generation=%u queue=%d callback_id=%d control=%p url=%s",
+        static_cast<int>(handle),
+        static_cast<int>(request_id),
+        request.generation,
+        static_cast<int>(options.queue_id),
+        callback_id,
+        request.request_control.get(),
+        url.c_str());
+
+    return request_id;
+}
+
+bool EasyHttpModule::CanSendRequest(const OptionsData &options, const std::string &url)
+{
+    if (!IsQueueExists(options.queue_id))
     {
         ezhttp::trace::Writef(
             "EasyHttpModule",
             "SendRequest rejected invalid queue=%d url=%s",
-            static_cast<int>(queue_id),
+            static_cast<int>(options.queue_id),
             url.c_str());
-        return RequestId::Null;
+        return false;
     }
 
     if (!IsValidPluginEndBehaviour(options.plugin_end_behaviour))
@@ -79,16 +248,20 @@ RequestId EasyHttpModule::SendRequest(
             "EasyHttpModule",
             "SendRequest rejected invalid plugin_end_behaviour=%d queue=%d url=%s",
             static_cast<int>(options.plugin_end_behaviour),
-            static_cast<int>(queue_id),
+            static_cast<int>(options.queue_id),
             url.c_str());
-        return RequestId::Null;
+        return false;
     }
 
+    return true;
+}
+
+RequestId EasyHttpModule::AddRequest(const OptionsData &options, int callback_id, std::unique_ptr<cell[]> callback_data, int callback_data_len, OptionsId source_options_id)
+{
     RequestId request_id = requests_.Add(RequestData());
     RequestData &request = GetRequest(request_id);
-    const uint32_t request_generation = ++next_request_generation_;
 
-    request.generation = request_generation;
+    request.generation = ++next_request_generation_;
     request.user_data = options.user_data;
     request.callback_data = std::move(callback_data);
     request.callback_data_len = callback_data_len;
@@ -97,10 +270,12 @@ RequestId EasyHttpModule::SendRequest(
     if (source_options_id != OptionsId::Null)
         TrackAutoDestroyOptions(request, source_options_id, options.generation);
 
-    auto &easy_http = GetEasyHttp(queue_id, options.plugin_end_behaviour);
-    const RequestOptions request_options = options.options_builder.BuildOptions();
+    return request_id;
+}
 
-    EasyHttpInterface::ResponseCallback cb_proxy = [this, request_id, request_generation](const Response &response)
+EasyHttpInterface::ResponseCallback EasyHttpModule::CreateResponseCallback(RequestId request_id, uint32_t request_generation)
+{
+    return [this, request_id, request_generation](const Response &response)
     {
         ezhttp::trace::Writef("EasyHttpModule", "callback enter request=%d generation=%u", static_cast<int>(request_id), request_generation);
         if (!IsRequestExists(request_id))
@@ -120,20 +295,6 @@ RequestId EasyHttpModule::SendRequest(
         ezhttp::trace::Writef("EasyHttpModule", "callback finalize request=%d generation=%u status=%ld error=%d", static_cast<int>(request_id), request_generation, response.status_code, static_cast<int>(response.error.code));
         FinalizeRequest(request_id);
     };
-    request.request_control = easy_http->SendRequest(method, url, request_options, cb_proxy);
-
-    ezhttp::trace::Writef(
-        "EasyHttpModule",
-        "SendRequest request=%d generation=%u queue=%d behaviour=%d callback_id=%d control=%p url=%s",
-        static_cast<int>(request_id),
-        request_generation,
-        static_cast<int>(queue_id),
-        static_cast<int>(options.plugin_end_behaviour),
-        callback_id,
-        request.request_control.get(),
-        url.c_str());
-
-    return request_id;
 }
 
 bool EasyHttpModule::DeleteRequest(RequestId handle)
@@ -169,14 +330,67 @@ void EasyHttpModule::FinalizeRequest(RequestId handle)
         else
             MF_ExecuteForward(request.callback_id, handle);
 
-        MF_UnregisterSPForward(request.callback_id);
+        if (request.batch_id == BatchId::Null)
+            MF_UnregisterSPForward(request.callback_id);
+
         request.callback_id = -1;
     }
 
+    const BatchId batch_id = request.batch_id;
+    const uint32_t batch_generation = request.batch_generation;
+    const bool failed = request.response.error.code != cpr::ErrorCode::OK;
+
     DeleteRequest(handle);
+
+    if (batch_id != BatchId::Null)
+        FinishBatchRequest(batch_id, batch_generation, failed, true);
+
     ezhttp::trace::Writef("EasyHttpModule", "FinalizeRequest done request=%d", static_cast<int>(handle));
 }
 
+void EasyHttpModule::FinishBatchRequest(BatchId handle, uint32_t generation, bool failed, bool callback_executed)
+{
+    if (!IsBatchExists(handle))
+        return;
+
+    BatchData &batch = batches_.at(handle);
+    if (batch.generation != generation)
+        return;
+
+    if (failed)
+        ++batch.failed;
+
+    if (!callback_executed)
+        batch.notify_done = false;
+
+    if (batch.remaining > 0 && --batch.remaining > 0)
+        return;
+
+    ezhttp::trace::Writef("EasyHttpModule", "FinishBatchRequest batch=%d failed=%zu notify=%d", static_cast<int>(handle), batch.failed, batch.notify_done);
+    if (batch.notify_done && batch.done_callback_id != -1)
+    {
+        if (batch.callback_data)
+            MF_ExecuteForward(batch.done_callback_id, handle, static_cast<cell>(batch.failed), MF_PrepareCellArray(batch.callback_data.get(), batch.callback_data_len));
+        else
+            MF_ExecuteForward(batch.done_callback_id, handle, static_cast<cell>(batch.failed));
+    }
+
+    ReleaseBatchForwards(batch);
+    batches_.Remove(handle);
+}
+
+void EasyHttpModule::ReleaseBatchForwards(BatchData &batch)
+{
+    if (batch.callback_id != -1)
+        MF_UnregisterSPForward(batch.callback_id);
+
+    if (batch.done_callback_id != -1)
+        MF_UnregisterSPForward(batch.done_callback_id);
+
+    batch.callback_id = -1;
+    batch.done_callback_id = -1;
+}
+
 void EasyHttpModule::CleanupCompletedForgottenRequests()
 {
     for (auto it = requests_.begin(); it != requests_.end();)
@@ -188,12 +402,18 @@ void EasyHttpModule::CleanupCompletedForgottenRequests()
             continue;
         }
 
-        if (request.callback_id != -1)
+        if (request.callback_id != -1 && request.batch_id == BatchId::Null)
             MF_UnregisterSPForward(request.callback_id);
 
         ReleaseAutoDestroyOptions(request);
         ezhttp::trace::Writef("EasyHttpModule", "CleanupCompletedForgottenRequests remove request=%d control=%p", static_cast<int>(it->first), request.request_control.get());
+
+        const BatchId batch_id = request.batch_id;
+        const uint32_t batch_generation = request.batch_generation;
         it = requests_.Remove(it);
+
+        if (batch_id != BatchId::Null)
+            FinishBatchRequest(batch_id, batch_generation, false, false);
     }
 }
 
@@ -277,6 +497,8 @@ void EasyHttpModule::ShutdownWithoutCallbacks()
 
     easy_http_pack_.clear();
     requests_.clear();
+    batches_.clear();
+    templates_.clear();
     options_.clear();
     ezhttp::trace::Writef("EasyHttpModule", "ShutdownWithoutCallbacks end forgotten=%zu queues=%zu requests=%zu options=%zu", forgotten_easy_http_.size(), easy_http_pack_.size(), requests_.size(), options_.size());
 }
@@ -294,7 +516,9 @@ void EasyHttpModule::ResetForMapChangeWithoutCallbacks()
             request_kv.second.request_control.get());
         if (request_kv.second.callback_id != -1)
         {
-            MF_UnregisterSPForward(request_kv.second.callback_id);
+            if (request_kv.second.batch_id == BatchId::Null)
+                MF_UnregisterSPForward(request_kv.second.callback_id);
+
             request_kv.second.callback_id = -1;
         }
 
@@ -302,6 +526,9 @@ void EasyHttpModule::ResetForMapChangeWithoutCallbacks()
             request_kv.second.request_control->forgotten.store(true);
     }
 
+    for (auto &batch_kv : batches_)
+        ReleaseBatchForwards(batch_kv.second);
+
     for (auto &forgotten_ez : forgotten_easy_http_)
     {
         if (!forgotten_ez)
@@ -334,8 +561,10 @@ void EasyHttpModule::ResetForMapChangeWithoutCallbacks()
 
     easy_http_pack_.clear();
     requests_.clear();
+    batches_.clear();
+    templates_.clear();
     options_.clear();
-    CreateQueue();
+    CreateQueue(kMainQueueThreads, kMainQueueMinThreads, kMainQueueMaxPerHost);
     ezhttp::trace::Writef("EasyHttpModule", "ResetForMapChangeWithoutCallbacks end forgotten=%zu queues=%zu requests=%zu options=%zu", forgotten_easy_http_.size(), easy_http_pack_.size(), requests_.size(), options_.size());
 }
 
@@ -358,6 +587,8 @@ void EasyHttpModule::RunCleanupFrameForForgottenEasyHttp()
 {
     for (auto it = forgotten_easy_http_.begin(); it != forgotten_easy_http_.end();)
     {
+        // callbacks of forgotten requests are skipped, this only wakes requests waiting for rate limits
+        it->get()->RunFrame();
         it->get()->DropCompletedRequestsWithoutCallbacks();
 
         if (it->get()->GetActiveRequestCount() == 0)
@@ -373,18 +604,21 @@ void EasyHttpModule::RunCleanupFrameForForgottenEasyHttp()
 std::unique_ptr<ezhttp::EasyHttpInterface> &EasyHttpModule::GetEasyHttp(QueueId queue_id, PluginEndBehaviour end_map_behaviour)
 {
     EasyHttpPack &easy_http_pack = easy_http_pack_.at(queue_id);
-    int easy_http_threads = queue_id == QueueId::Main ? kMainQueueThreads : 1;
+    const int max_concurrency = easy_http_pack.max_concurrency;
+    const int max_per_host = easy_http_pack.max_per_host;
+    const std::shared_ptr<RateLimiter> &queue_rate_limiter = easy_http_pack.rate_limiter;
+    const std::shared_ptr<ConnectPolicies> &queue_connect_policies = easy_http_pack.connect_policies;
 
     switch (end_map_behaviour)
     {
     case PluginEndBehaviour::CancelRequests:
         if (!easy_http_pack.terminating_easy_http)
-            easy_http_pack.terminating_easy_http = std::make_unique<EasyHttp>(ca_cert_path_, easy_http_threads);
+            easy_http_pack.terminating_easy_http = std::make_unique<EasyHttp>(ca_cert_store_, tls_session_cache_, origins_, session_reaper_, executor_, max_concurrency, max_per_host, host_rate_limiter_, queue_rate_limiter, response_cache_, host_connect_policies_, queue_connect_policies);
         return easy_http_pack.terminating_easy_http;
 
     case PluginEndBehaviour::ForgetRequests:
         if (!easy_http_pack.forgettable_easy_http)
-            easy_http_pack.forgettable_easy_http = std::make_unique<EasyHttp>(ca_cert_path_, easy_http_threads);
+            easy_http_pack.forgettable_easy_http = std::make_unique<EasyHttp>(ca_cert_store_, tls_session_cache_, origins_, session_reaper_, executor_, max_concurrency, max_per_host, host_rate_limiter_, queue_rate_limiter, response_cache_, host_connect_policies_, queue_connect_policies);
         return easy_http_pack.forgettable_easy_http;
     }
 
@@ -396,12 +630,110 @@ std::unique_ptr<ezhttp::EasyHttpInterface> &EasyHttpModule::GetEasyHttp(QueueId
     assert(false && "GetEasyHttp received an unsupported plugin end behaviour");
 
     if (!easy_http_pack.terminating_easy_http)
-        easy_http_pack.terminating_easy_http = std::make_unique<EasyHttp>(ca_cert_path_, easy_http_threads);
+        easy_http_pack.terminating_easy_http = std::make_unique<EasyHttp>(ca_cert_store_, tls_session_cache_, origins_, session_reaper_, executor_, max_concurrency, max_per_host, host_rate_limiter_, queue_rate_limiter, response_cache_, host_connect_policies_, queue_connect_policies);
 
     return easy_http_pack.terminating_easy_http;
 }
 
-QueueId EasyHttpModule::CreateQueue()
+QueueId EasyHttpModule::CreateQueue(int max_concurrency, int min_threads, int max_per_host)
+{
+    QueueId queue_id = easy_http_pack_.Add(EasyHttpPack{max_concurrency, min_threads, max_per_host});
+    UpdateExecutorMinThreads();
+    return queue_id;
+}
+
+void EasyHttpModule::UpdateExecutorMinThreads()
 {
-    return easy_http_pack_.Add(EasyHttpPack{});
+    int min_threads = 0;
+    for (const auto &pack_kv : easy_http_pack_)
+        min_threads += pack_kv.second.min_threads;
+
+    executor_->SetMinThreads(min_threads);
+}
+
+void EasyHttpModule::SetQueueMaxPerHost(QueueId handle, int max_per_host)
+{
+    EasyHttpPack &easy_http_pack = easy_http_pack_.at(handle);
+    easy_http_pack.max_per_host = max_per_host;
+
+    if (easy_http_pack.terminating_easy_http)
+        easy_http_pack.terminating_easy_http->SetMaxRequestsPerHost(max_per_host);
+
+    if (easy_http_pack.forgettable_easy_http)
+        easy_http_pack.forgettable_easy_http->SetMaxRequestsPerHost(max_per_host);
+
+    ezhttp::trace::Writef("EasyHttpModule", "SetQueueMaxPerHost queue=%d max_per_host=%d", static_cast<int>(handle), max_per_host);
+}
+
+void EasyHttpModule::SetQueueRateLimit(QueueId handle, double requests_per_second, int burst)
+{
+    easy_http_pack_.at(handle).rate_limiter->SetLimit(std::string(), requests_per_second, burst);
+    ezhttp::trace::Writef("EasyHttpModule", "SetQueueRateLimit queue=%d rps=%f burst=%d", static_cast<int>(handle), requests_per_second, burst);
+}
+
+void EasyHttpModule::SetHostRateLimit(const std::string &host, double requests_per_second, int burst)
+{
+    host_rate_limiter_->SetLimit(host, requests_per_second, burst);
+    ezhttp::trace::Writef("EasyHttpModule", "SetHostRateLimit host=%s rps=%f burst=%d", host.c_str(), requests_per_second, burst);
+}
+
+void EasyHttpModule::SetQueueConnectPolicy(QueueId handle, ConnectPolicy policy)
+{
+    ezhttp::trace::Writef("EasyHttpModule", "SetQueueConnectPolicy queue=%d ip_version=%d happy_eyeballs_ms=%d", static_cast<int>(handle), static_cast<int>(policy.ip_version), policy.happy_eyeballs_timeout_ms);
+    easy_http_pack_.at(handle).connect_policies->Set(std::string(), std::move(policy));
+}
+
+void EasyHttpModule::SetHostConnectPolicy(const std::string &host, ConnectPolicy policy)
+{
+    ezhttp::trace::Writef("EasyHttpModule", "SetHostConnectPolicy host=%s ip_version=%d happy_eyeballs_ms=%d resolve=%s", host.c_str(), static_cast<int>(policy.ip_version), policy.happy_eyeballs_timeout_ms, policy.resolve_addresses.c_str());
+    host_connect_policies_->Set(host, std::move(policy));
+}
+
+void EasyHttpModule::SetResponseCacheSize(size_t max_bytes)
+{
+    response_cache_->SetMaxBytes(max_bytes);
+    ezhttp::trace::Writef("EasyHttpModule", "SetResponseCacheSize max_bytes=%zu", max_bytes);
+}
+
+void EasyHttpModule::SetDiskCacheSize(size_t max_bytes)
+{
+    if (max_bytes == 0 && !disk_cache_)
+        return;
+
+    // the index is loaded once, later changes of the size only evict
+    if (!disk_cache_)
+        disk_cache_ = std::make_shared<DiskResponseCache>(disk_cache_directory_, max_bytes);
+    else
+        disk_cache_->SetMaxBytes(max_bytes);
+
+    response_cache_->SetDiskCache(max_bytes > 0 ? disk_cache_ : nullptr);
+    ezhttp::trace::Writef("EasyHttpModule", "SetDiskCacheSize max_bytes=%zu entries=%zu", max_bytes, disk_cache_->GetCount());
+}
+
+size_t EasyHttpModule::GetQueuePendingCount(QueueId handle, ezhttp::RequestPriority priority)
+{
+    EasyHttpPack &easy_http_pack = easy_http_pack_.at(handle);
+    size_t count = 0;
+
+    if (easy_http_pack.terminating_easy_http)
+        count += easy_http_pack.terminating_easy_http->GetPendingRequestCount(priority);
+
+    if (easy_http_pack.forgettable_easy_http)
+        count += easy_http_pack.forgettable_easy_http->GetPendingRequestCount(priority);
+
+    return count;
+}
+
+int EasyHttpModule::GetQueueRunningCount(QueueId handle)
+{
+    EasyHttpPack &easy_http_pack = easy_http_pack_.at(handle);
+    int count = 0;
+
+    if (easy_http_pack.terminating_easy_http)
+        count += easy_http_pack.terminating_easy_http->GetRunningRequestCount();
+
+    if (easy_http_pack.forgettable_easy_http)
+        count += easy_http_pack.forgettable_easy_http->GetRunningRequestCount();
+
+    return count;
 }
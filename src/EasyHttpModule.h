@@ -1,7 +1,16 @@
 #pragma once
 
+#include "easy_http/CaCertStore.h"
+#include "easy_http/ConnectPolicy.h"
 #include "easy_http/EasyHttpInterface.h"
 #include "easy_http/EasyHttpOptionsBuilder.h"
+#include "easy_http/RateLimiter.h"
+#include "easy_http/RequestExecutor.h"
+#include "easy_http/ResponseCache.h"
+#include "easy_http/UrlTemplate.h"
+#include "easy_http/session_cache/OriginRegistry.h"
+#include "easy_http/session_cache/SessionReaper.h"
+#include "easy_http/session_cache/TlsSessionCache.h"
 #include "utils/ContainerWithHandles.h"
 #include "sdk/amxxmodule.h"
 #include <memory>
@@ -27,13 +36,21 @@ enum class QueueId : int
     Null = 0,
     Main = 1
 };
+enum class BatchId : int
+{
+    Null = 0
+};
+enum class TemplateId : int
+{
+    Null = 0
+};
 
 struct OptionsData
 {
     uint32_t generation = 0;
-    ezhttp::EasyHttpOptionsBuilder options_builder;
+    ezhttp::EasyHttpOptionsBuilder options_builder; // copy-on-write, so copying OptionsData is cheap
 
-    std::optional<std::vector<cell>> user_data;
+    std::shared_ptr<const std::vector<cell>> user_data; // replaced as a whole, so it is shared with the requests
     PluginEndBehaviour plugin_end_behaviour = PluginEndBehaviour::CancelRequests;
     QueueId queue_id = QueueId::Main;
     bool auto_destroy = true;
@@ -45,20 +62,61 @@ struct RequestData
     uint32_t generation = 0;
     std::shared_ptr<ezhttp::RequestControl> request_control;
     ezhttp::Response response;
-    std::optional<std::vector<cell>> user_data;
+    std::shared_ptr<const std::vector<cell>> user_data;
     std::unique_ptr<cell[]> callback_data;
     int callback_data_len = 0;
     int callback_id = -1;
     OptionsId auto_destroy_options_id = OptionsId::Null;
     uint32_t auto_destroy_options_generation = 0;
+    BatchId batch_id = BatchId::Null; // callback_id is owned by the batch then
+    uint32_t batch_generation = 0;
+    int batch_index = -1;
+};
+
+struct BatchRequestData
+{
+    ezhttp::RequestMethod method;
+    std::string url;
+    OptionsData options;
+    OptionsId source_options_id = OptionsId::Null;
+};
+
+struct BatchData
+{
+    uint32_t generation = 0;
+    std::vector<BatchRequestData> requests; // moved out when the batch is sent
+    bool sent = false;
+
+    // Registered once for the whole batch, unregistered after the last request
+    int callback_id = -1;
+    int done_callback_id = -1;
+    std::unique_ptr<cell[]> callback_data;
+    int callback_data_len = 0;
+
+    size_t remaining = 0;
+    size_t failed = 0;
+    bool notify_done = true; // false if a request was dropped without its callback
+};
+
+struct TemplateData
+{
+    ezhttp::RequestMethod method;
+    ezhttp::UrlTemplate url_template;
+    OptionsData options; // a snapshot, the request options are shared by all requests of the template
 };
 
 struct EasyHttpPack
 {
     std::unique_ptr<ezhttp::EasyHttpInterface> forgettable_easy_http = nullptr;
     std::unique_ptr<ezhttp::EasyHttpInterface> terminating_easy_http = nullptr;
+    std::shared_ptr<ezhttp::RateLimiter> rate_limiter = std::make_shared<ezhttp::RateLimiter>();
+    std::shared_ptr<ezhttp::ConnectPolicies> connect_policies = std::make_shared<ezhttp::ConnectPolicies>();
+    int max_concurrency = 1;
+    int min_threads = 0;
+    int max_per_host = 0; // 0 if requests are not grouped by host
 
     EasyHttpPack() = default;
+    EasyHttpPack(int max_concurrency, int min_threads, int max_per_host) : max_concurrency(max_concurrency), min_threads(min_threads), max_per_host(max_per_host) {}
 
     EasyHttpPack(const EasyHttpPack &other) = delete;
     EasyHttpPack &operator=(const EasyHttpPack &other) = delete;
@@ -67,12 +125,22 @@ struct EasyHttpPack
     {
         forgettable_easy_http = std::move(other.forgettable_easy_http);
         terminating_easy_http = std::move(other.terminating_easy_http);
+        rate_limiter = std::move(other.rate_limiter);
+        connect_policies = std::move(other.connect_policies);
+        max_concurrency = other.max_concurrency;
+        min_threads = other.min_threads;
+        max_per_host = other.max_per_host;
     }
 
     EasyHttpPack &operator=(EasyHttpPack &&other) noexcept
     {
         forgettable_easy_http = std::move(other.forgettable_easy_http);
         terminating_easy_http = std::move(other.terminating_easy_http);
+        rate_limiter = std::move(other.rate_limiter);
+        connect_policies = std::move(other.connect_policies);
+        max_concurrency = other.max_concurrency;
+        min_threads = other.min_threads;
+        max_per_host = other.max_per_host;
         return *this;
     }
 };
@@ -80,18 +148,44 @@ struct EasyHttpPack
 class EasyHttpModule
 {
     const int kMainQueueThreads = 6;
+    const int kMainQueueMinThreads = 1;
+    const int kMainQueueMaxPerHost = 4;
+    static const int kMaxExecutorThreads = 32;
+    static constexpr size_t kDefaultResponseCacheBytes = 8 * 1024 * 1024;
+    static const int kSessionReapIntervalSeconds = 10;
+    static const int kMaxPooledSessions = 64; // idle handles kept across all queues and hosts, the least recently used are closed first
+    static const int kMaxOrigins = 4096; // origins with a session pool, requests to any further origin open a new connection
 
-    std::string ca_cert_path_;
+    std::shared_ptr<const ezhttp::CaCertStore> ca_cert_store_; // parsed once for all queues
+    std::shared_ptr<ezhttp::TlsSessionCache> tls_session_cache_; // shared by all queues, kept across map changes
+    std::shared_ptr<ezhttp::OriginRegistry> origins_; // ids of the session pools, valid in every queue
+    std::shared_ptr<ezhttp::SessionReaper> session_reaper_; // closes idle pooled connections of every queue
     uint32_t next_request_generation_ = 0;
     uint32_t next_options_generation_ = 0;
+    uint32_t next_batch_generation_ = 0;
+
+    // Threads shared by all queues, declared before the EasyHttps so it outlives them
+    std::shared_ptr<ezhttp::RequestExecutor> executor_;
+
+    // Per host limits are shared by all queues and survive map changes along with blocks requested by servers
+    std::shared_ptr<ezhttp::RateLimiter> host_rate_limiter_;
+    std::shared_ptr<ezhttp::ConnectPolicies> host_connect_policies_;
+
+    // Responses requested with use_cache, shared by all queues and kept across map changes.
+    // The disk layer is off until a plugin sets its size
+    std::shared_ptr<ezhttp::ResponseCache> response_cache_;
+    std::string disk_cache_directory_;
+    std::shared_ptr<ezhttp::DiskResponseCache> disk_cache_;
 
     std::vector<std::unique_ptr<ezhttp::EasyHttpInterface>> forgotten_easy_http_;
     utils::ContainerWithHandles<QueueId, EasyHttpPack> easy_http_pack_;
     utils::ContainerWithHandles<OptionsId, OptionsData> options_;
     utils::ContainerWithHandles<RequestId, RequestData> requests_;
+    utils::ContainerWithHandles<BatchId, BatchData> batches_;
+    utils::ContainerWithHandles<TemplateId, TemplateData> templates_;
 
 public:
-    explicit EasyHttpModule(std::string ca_cert_path);
+    explicit EasyHttpModule(std::string ca_cert_path, std::string disk_cache_directory = std::string());
     ~EasyHttpModule();
 
     void RunFrame();
@@ -111,18 +205,54 @@ public:
     [[nodiscard]] RequestData &GetRequest(RequestId handle) { return requests_.at(handle); }
     [[nodiscard]] const RequestData &GetRequest(RequestId handle) const { return requests_.at(handle); }
 
+    // Requests of a batch share the forwards and are enqueued at once, done_callback_id is executed
+    // with the batch id and the number of failed requests after the last request's callback
+    BatchId CreateBatch();
+    int AddBatchRequest(BatchId handle, ezhttp::RequestMethod method, const std::string &url, OptionsData options, OptionsId source_options_id = OptionsId::Null);
+    size_t SendBatch(BatchId handle, int callback_id, int done_callback_id, std::unique_ptr<cell[]> callback_data = nullptr, int callback_data_len = 0);
+    [[nodiscard]] bool IsBatchExists(BatchId handle) const { return batches_.contains(handle); }
+    [[nodiscard]] const BatchData &GetBatch(BatchId handle) const { return batches_.at(handle); }
+
+    // The url pattern and the options are parsed once, sending fills the placeholders only
+    TemplateId CreateTemplate(ezhttp::RequestMethod method, ezhttp::UrlTemplate url_template, OptionsData options);
+    RequestId SendTemplateRequest(TemplateId handle, const std::string &url, int callback_id = -1);
+    bool DeleteTemplate(TemplateId handle) { return templates_.Remove(handle); }
+    [[nodiscard]] bool IsTemplateExists(TemplateId handle) const { return templates_.contains(handle); }
+    [[nodiscard]] const TemplateData &GetTemplate(TemplateId handle) const { return templates_.at(handle); }
+
     OptionsId CreateOptions(bool auto_destroy = true);
     bool DeleteOptions(OptionsId handle);
     [[nodiscard]] bool IsOptionsExists(OptionsId handle) const { return options_.contains(handle); }
     [[nodiscard]] OptionsData &GetOptions(OptionsId handle) { return options_.at(handle); }
     [[nodiscard]] const OptionsData &GetOptions(OptionsId handle) const { return options_.at(handle); }
     [[nodiscard]] ezhttp::EasyHttpOptionsBuilder &GetOptionsBuilder(OptionsId handle) { return options_.at(handle).options_builder; }
+    // Shares the request options and user data with the handle, they are copied if the handle is changed later
     [[nodiscard]] OptionsData CreateOptionsSnapshot(OptionsId handle) const { return options_.at(handle); }
 
-    QueueId CreateQueue();
+    static constexpr int kMaxQueueConcurrency = 10;
+
+    // By default requests of the queue keep their order, the main queue groups them by host with kMainQueueMaxPerHost
+    QueueId CreateQueue(int max_concurrency = 1, int min_threads = 0, int max_per_host = 0);
+    void SetQueueMaxPerHost(QueueId handle, int max_per_host);
+    void SetQueueRateLimit(QueueId handle, double requests_per_second, int burst);
+    void SetHostRateLimit(const std::string &host, double requests_per_second, int burst);
+    void SetQueueConnectPolicy(QueueId handle, ezhttp::ConnectPolicy policy);
+    void SetHostConnectPolicy(const std::string &host, ezhttp::ConnectPolicy policy);
+    void SetResponseCacheSize(size_t max_bytes);
+    void SetDiskCacheSize(size_t max_bytes);
     [[nodiscard]] bool IsQueueExists(QueueId handle) const { return easy_http_pack_.contains(handle); }
+    [[nodiscard]] size_t GetQueuePendingCount(QueueId handle, ezhttp::RequestPriority priority);
+    [[nodiscard]] int GetQueueRunningCount(QueueId handle);
+    [[nodiscard]] int GetExecutorWorkerCount() { return executor_->GetWorkerCount(); }
+    [[nodiscard]] uint64_t GetTlsFullHandshakes() const { return tls_session_cache_->GetFullHandshakes(); }
+    [[nodiscard]] uint64_t GetTlsResumedHandshakes() const { return tls_session_cache_->GetResumedHandshakes(); }
 
 private:
+    bool CanSendRequest(const OptionsData &options, const std::string &url);
+    RequestId AddRequest(const OptionsData &options, int callback_id, std::unique_ptr<cell[]> callback_data, int callback_data_len, OptionsId source_options_id);
+    ezhttp::EasyHttpInterface::ResponseCallback CreateResponseCallback(RequestId request_id, uint32_t request_generation);
+    void FinishBatchRequest(BatchId handle, uint32_t generation, bool failed, bool callback_executed);
+    void ReleaseBatchForwards(BatchData &batch);
     void FinalizeRequest(RequestId handle);
     void CleanupCompletedForgottenRequests();
     void TrackAutoDestroyOptions(RequestData &request, OptionsId options_id, uint32_t options_generation);
@@ -131,5 +261,6 @@ private:
     void ResetForMapChangeWithoutCallbacks();
     void RunFrameEasyHttp();
     void RunCleanupFrameForForgottenEasyHttp();
+    void UpdateExecutorMinThreads();
     std::unique_ptr<ezhttp::EasyHttpInterface> &GetEasyHttp(QueueId queue_id, PluginEndBehaviour end_map_behaviour);
 };
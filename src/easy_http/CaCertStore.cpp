@@ -0,0 +1,89 @@
+#include "CaCertStore.h"
+
+#include <utility>
+
+#ifdef LINUX
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#endif
+
+#include "utils/TraceLog.h"
+
+using namespace ezhttp;
+
+CaCertStore::CaCertStore(std::string path) : path_(std::move(path))
+{
+#ifdef LINUX
+    BIO *bio = BIO_new_file(path_.c_str(), "r");
+    if (!bio)
+    {
+        ezhttp::trace::Writef("CaCertStore", "ctor failed to open path=%s", path_.c_str());
+        return;
+    }
+
+    STACK_OF(X509_INFO) *infos = PEM_X509_INFO_read_bio(bio, nullptr, nullptr, nullptr);
+    BIO_free(bio);
+    if (!infos)
+    {
+        ezhttp::trace::Writef("CaCertStore", "ctor failed to parse path=%s", path_.c_str());
+        return;
+    }
+
+    X509_STORE *store = X509_STORE_new();
+    for (int i = 0; store && i < sk_X509_INFO_num(infos); ++i)
+    {
+        X509_INFO *info = sk_X509_INFO_value(infos, i);
+        if (info->x509 && X509_STORE_add_cert(store, info->x509) == 1)
+            ++cert_count_;
+
+        if (info->crl)
+            X509_STORE_add_crl(store, info->crl);
+    }
+    sk_X509_INFO_pop_free(infos, X509_INFO_free);
+
+    if (store && cert_count_ > 0)
+        store_ = store;
+    else
+        X509_STORE_free(store);
+
+    ezhttp::trace::Writef("CaCertStore", "ctor path=%s loaded=%d certs=%zu", path_.c_str(), store_ != nullptr, cert_count_);
+#endif
+}
+
+CaCertStore::~CaCertStore()
+{
+#ifdef LINUX
+    // connections still holding the store keep it alive by their own reference
+    X509_STORE_free(store_);
+#endif
+}
+
+bool CaCertStore::Apply(CURL *curl) const
+{
+    if (!store_)
+        return false;
+
+    // fails if curl is built with another TLS backend
+    if (curl_easy_setopt(curl, CURLOPT_SSL_CTX_FUNCTION, OnSslContext) != CURLE_OK)
+        return false;
+
+    curl_easy_setopt(curl, CURLOPT_SSL_CTX_DATA, const_cast<CaCertStore *>(this));
+
+    // without a file curl has nothing to load, the certificates come from the store
+    curl_easy_setopt(curl, CURLOPT_CAINFO, nullptr);
+    curl_easy_setopt(curl, CURLOPT_CAPATH, nullptr);
+    return true;
+}
+
+CURLcode CaCertStore::OnSslContext(CURL * /*curl*/, void *ssl_ctx, void *user_data)
+{
+#ifdef LINUX
+    const auto *ca_cert_store = static_cast<const CaCertStore *>(user_data);
+
+    // SSL_CTX_set_cert_store takes over a reference and frees the store curl has created
+    X509_STORE_up_ref(ca_cert_store->store_);
+    SSL_CTX_set_cert_store(static_cast<SSL_CTX *>(ssl_ctx), ca_cert_store->store_);
+#endif
+    return CURLE_OK;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <string>
+
+#include <curl/curl.h>
+
+struct x509_store_st;
+
+namespace ezhttp
+{
+    // The CA bundle parsed once into an OpenSSL X509_STORE shared by all connections, so a new connection
+    // doesn't make curl read and parse the whole file again. With a TLS backend other than OpenSSL,
+    // or if the bundle can't be parsed, handles get the file path as before
+    class CaCertStore
+    {
+        std::string path_;
+        x509_store_st *store_ = nullptr;
+        size_t cert_count_ = 0;
+
+    public:
+        explicit CaCertStore(std::string path);
+        ~CaCertStore();
+
+        CaCertStore(const CaCertStore &other) = delete;
+        CaCertStore &operator=(const CaCertStore &other) = delete;
+
+        [[nodiscard]] const std::string &GetPath() const { return path_; }
+        [[nodiscard]] bool IsLoaded() const { return store_ != nullptr; }
+        [[nodiscard]] size_t GetCertCount() const { return cert_count_; }
+
+        // Makes the handle verify peers with the shared store. Must be called after the other ssl options,
+        // as it clears the file set by them. Returns false if the handle must use GetPath() instead
+        bool Apply(CURL *curl) const;
+
+    private:
+        static CURLcode OnSslContext(CURL *curl, void *ssl_ctx, void *user_data);
+    };
+}
@@ -0,0 +1,79 @@
+#include "ConnectPolicy.h"
+
+#include <cctype>
+
+using namespace ezhttp;
+
+ConnectPolicy ConnectPolicy::WithFallback(const ConnectPolicy &fallback) const
+{
+    ConnectPolicy policy = *this;
+    if (policy.ip_version == IpVersion::Any)
+        policy.ip_version = fallback.ip_version;
+
+    if (policy.happy_eyeballs_timeout_ms < 0)
+        policy.happy_eyeballs_timeout_ms = fallback.happy_eyeballs_timeout_ms;
+
+    if (policy.resolve_addresses.empty())
+        policy.resolve_addresses = fallback.resolve_addresses;
+
+    return policy;
+}
+
+bool ConnectPolicy::IsValidResolveAddresses(const std::string &addresses)
+{
+    // curl skips the addresses it can't parse, this only rejects what is surely not an address list
+    size_t begin = 0;
+    while (begin <= addresses.size())
+    {
+        size_t end = addresses.find(',', begin);
+        if (end == std::string::npos)
+            end = addresses.size();
+
+        const std::string address = addresses.substr(begin, end - begin);
+        if (address.empty())
+            return false;
+
+        bool has_separator = false;
+        for (char c : address)
+        {
+            if (c == '.' || c == ':')
+                has_separator = true;
+            else if (!std::isxdigit(static_cast<unsigned char>(c)) && c != '[' && c != ']')
+                return false;
+        }
+
+        if (!has_separator)
+            return false;
+
+        begin = end + 1;
+    }
+
+    return true;
+}
+
+void ConnectPolicies::Set(const std::string &key, ConnectPolicy policy)
+{
+    std::lock_guard lock_guard(mutex_);
+
+    if (policy.IsDefault())
+        policies_.erase(key);
+    else
+        policies_[key] = std::move(policy);
+}
+
+std::optional<ConnectPolicy> ConnectPolicies::Find(const std::string &key) const
+{
+    std::lock_guard lock_guard(mutex_);
+
+    auto it = policies_.find(key);
+    if (it == policies_.end())
+        return std::nullopt;
+
+    return it->second;
+}
+
+bool ConnectPolicies::Empty() const
+{
+    std::lock_guard lock_guard(mutex_);
+    return policies_.empty();
+}
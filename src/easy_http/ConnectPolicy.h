@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+namespace ezhttp
+{
+    enum class IpVersion
+    {
+        Any,
+        V4,
+        V6,
+    };
+
+    // How new connections to a host are set up. Pooled connections are reused regardless of the policy
+    struct ConnectPolicy
+    {
+        IpVersion ip_version = IpVersion::Any;
+        int32_t happy_eyeballs_timeout_ms = -1; // head start of the preferred address family, -1 for the curl default
+        std::string resolve_addresses; // comma separated addresses used instead of DNS, empty to resolve normally
+
+        [[nodiscard]] bool IsDefault() const { return ip_version == IpVersion::Any && happy_eyeballs_timeout_ms < 0 && resolve_addresses.empty(); }
+
+        // Fields left at their defaults are taken from the fallback
+        [[nodiscard]] ConnectPolicy WithFallback(const ConnectPolicy &fallback) const;
+
+        // Addresses must be IPv4 or IPv6 literals, IPv6 may be in brackets
+        static bool IsValidResolveAddresses(const std::string &addresses);
+    };
+
+    // Policies keyed by host (or by an empty key for a whole queue), like RateLimiter.
+    // Thread-safe, may be shared by several EasyHttps.
+    class ConnectPolicies
+    {
+        mutable std::mutex mutex_;
+        std::unordered_map<std::string, ConnectPolicy> policies_;
+
+    public:
+        // The default policy removes the entry
+        void Set(const std::string &key, ConnectPolicy policy);
+
+        [[nodiscard]] std::optional<ConnectPolicy> Find(const std::string &key) const;
+        [[nodiscard]] bool Empty() const;
+    };
+}
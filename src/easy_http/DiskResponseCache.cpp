@@ -0,0 +1,433 @@
+#include "DiskResponseCache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <system_error>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "utils/TraceLog.h"
+#include "utils/hash_utils.h"
+
+using namespace ezhttp;
+
+namespace
+{
+    const char *const kIndexFileName = "index.bin";
+    const char *const kBlobExtension = ".blob";
+    const char *const kTempExtension = ".tmp";
+
+    // Blobs are shared by equal bodies, so the name must not collide for different ones
+    std::string GetBlobName(const std::string &body)
+    {
+        return utils::Sha256Hex(body);
+    }
+
+    // Headers the server sets per client, they must not outlive the process or reach another request
+    bool IsPrivateHeader(const std::string &name)
+    {
+        static const char *const kPrivateHeaders[] = {"Set-Cookie", "Set-Cookie2", "Authorization", "Proxy-Authorization", "Cookie"};
+        for (const char *private_header : kPrivateHeaders)
+        {
+            if (name.size() == std::strlen(private_header) &&
+                std::equal(name.begin(), name.end(), private_header, [](char a, char b) { return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b)); }))
+                return true;
+        }
+
+        return false;
+    }
+
+    bool WriteFileAtomically(const std::filesystem::path &path, const std::string &data)
+    {
+        std::filesystem::path temp_path = path;
+        temp_path += kTempExtension;
+
+        FILE *fp = std::fopen(temp_path.string().c_str(), "wb");
+        if (!fp)
+            return false;
+
+        bool written = (std::fwrite(data.data(), 1, data.size(), fp) == data.size()) && (std::fflush(fp) == 0);
+#ifndef _WIN32
+        // the data must reach the disk before the rename does
+        written = written && (fsync(fileno(fp)) == 0);
+#endif
+        written = (std::fclose(fp) == 0) && written;
+
+        std::error_code ec;
+        if (written)
+        {
+            std::filesystem::rename(temp_path, path, ec);
+            written = !ec;
+        }
+
+        if (!written)
+            std::filesystem::remove(temp_path, ec);
+
+        return written;
+    }
+
+    bool ReadFile(const std::filesystem::path &path, std::string &data)
+    {
+        FILE *fp = std::fopen(path.string().c_str(), "rb");
+        if (!fp)
+            return false;
+
+        data.clear();
+        char buffer[16 * 1024];
+        size_t read;
+        while ((read = std::fread(buffer, 1, sizeof(buffer), fp)) > 0)
+            data.append(buffer, read);
+
+        const bool failed = std::ferror(fp) != 0;
+        std::fclose(fp);
+        return !failed;
+    }
+
+    // The index is read only by the machine that wrote it, so numbers are in the native byte order
+    class IndexWriter
+    {
+        std::string &out_;
+
+    public:
+        explicit IndexWriter(std::string &out) : out_(out) {}
+
+        void U32(uint32_t value) { out_.append(reinterpret_cast<const char *>(&value), sizeof(value)); }
+        void I64(int64_t value) { out_.append(reinterpret_cast<const char *>(&value), sizeof(value)); }
+        void Str(const std::string &value)
+        {
+            U32(static_cast<uint32_t>(value.size()));
+            out_.append(value);
+        }
+    };
+
+    class IndexReader
+    {
+        const std::string &in_;
+        size_t pos_ = 0;
+        bool ok_ = true;
+
+        bool Read(void *value, size_t size)
+        {
+            if (!ok_ || in_.size() - pos_ < size)
+                return ok_ = false;
+
+            std::memcpy(value, in_.data() + pos_, size);
+            pos_ += size;
+            return true;
+        }
+
+    public:
+        explicit IndexReader(const std::string &in) : in_(in) {}
+
+        [[nodiscard]] bool Ok() const { return ok_; }
+
+        uint32_t U32()
+        {
+            uint32_t value = 0;
+            Read(&value, sizeof(value));
+            return value;
+        }
+
+        int64_t I64()
+        {
+            int64_t value = 0;
+            Read(&value, sizeof(value));
+            return value;
+        }
+
+        std::string Str()
+        {
+            const uint32_t size = U32();
+            if (!ok_ || in_.size() - pos_ < size)
+            {
+                ok_ = false;
+                return std::string();
+            }
+
+            std::string value = in_.substr(pos_, size);
+            pos_ += size;
+            return value;
+        }
+    };
+}
+
+DiskResponseCache::DiskResponseCache(std::filesystem::path directory, size_t max_bytes) : directory_(std::move(directory)),
+                                                                                         max_bytes_(max_bytes)
+{
+    std::lock_guard lock_guard(mutex_);
+    LoadIndexLocked();
+
+    if (EvictLocked())
+        SaveIndexLocked();
+
+    ezhttp::trace::Writef("DiskResponseCache", "ctor directory=%s entries=%zu blobs=%zu size=%zu", directory_.string().c_str(), entries_.size(), blobs_.size(), size_);
+}
+
+void DiskResponseCache::SetMaxBytes(size_t max_bytes)
+{
+    std::lock_guard lock_guard(mutex_);
+    max_bytes_ = max_bytes;
+
+    if (EvictLocked())
+        SaveIndexLocked();
+}
+
+std::optional<Response> DiskResponseCache::Load(const std::string &key, const cpr::Url &url, std::time_t &expires_at)
+{
+    const std::string key_digest = utils::Sha256Hex(key);
+
+    std::lock_guard lock_guard(mutex_);
+
+    auto it = entries_by_key_digest_.find(key_digest);
+    if (it == entries_by_key_digest_.end())
+        return std::nullopt;
+
+    const Entry &entry = *it->second;
+
+    std::string body;
+    if (!ReadFile(GetBlobPath(entry.blob), body) || body.size() != blobs_[entry.blob].size)
+    {
+        ezhttp::trace::Writef("DiskResponseCache", "Load dropped unreadable blob=%s", entry.blob.c_str());
+        EraseLocked(it->second);
+        SaveIndexLocked();
+        return std::nullopt;
+    }
+
+    // the new order is saved with the next change of the index
+    entries_.splice(entries_.begin(), entries_, it->second);
+
+    Response response;
+    response.status_code = entry.status_code;
+    response.url = url;
+    response.status_line = entry.status_line;
+    response.reason = entry.reason;
+    response.header = entry.header;
+    response.SetText(std::move(body));
+
+    expires_at = entry.expires_at;
+    return response;
+}
+
+void DiskResponseCache::Store(const std::string &key, const Response &response, std::time_t expires_at)
+{
+    const std::string key_digest = utils::Sha256Hex(key);
+    const std::string blob = GetBlobName(response.text());
+    const size_t size = response.text().size();
+
+    std::lock_guard lock_guard(mutex_);
+
+    auto it = entries_by_key_digest_.find(key_digest);
+    if (size > max_bytes_)
+    {
+        if (it != entries_by_key_digest_.end())
+        {
+            EraseLocked(it->second);
+            SaveIndexLocked();
+        }
+
+        return;
+    }
+
+    // a blob that is already referenced has the same contents, so it is not written again
+    if (!blobs_.count(blob))
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(directory_, ec);
+
+        if (!WriteFileAtomically(GetBlobPath(blob), response.text()))
+        {
+            ezhttp::trace::Writef("DiskResponseCache", "Store failed to write blob=%s", blob.c_str());
+            return;
+        }
+
+        blobs_[blob].size = size;
+        size_ += size;
+    }
+
+    // referenced before the old entry is erased, so a revalidated body is kept
+    ++blobs_[blob].references;
+    if (it != entries_by_key_digest_.end())
+        EraseLocked(it->second);
+
+    cpr::Header header;
+    for (const auto &header_kv : response.header)
+    {
+        if (!IsPrivateHeader(header_kv.first))
+            header.insert(header_kv);
+    }
+
+    entries_.push_front(Entry{key_digest, blob, response.status_code, response.status_line, response.reason, std::move(header), expires_at});
+    entries_by_key_digest_[key_digest] = entries_.begin();
+
+    EvictLocked();
+    SaveIndexLocked();
+}
+
+void DiskResponseCache::Remove(const std::string &key)
+{
+    const std::string key_digest = utils::Sha256Hex(key);
+
+    std::lock_guard lock_guard(mutex_);
+
+    auto it = entries_by_key_digest_.find(key_digest);
+    if (it == entries_by_key_digest_.end())
+        return;
+
+    EraseLocked(it->second);
+    SaveIndexLocked();
+}
+
+size_t DiskResponseCache::GetSize()
+{
+    std::lock_guard lock_guard(mutex_);
+    return size_;
+}
+
+size_t DiskResponseCache::GetCount()
+{
+    std::lock_guard lock_guard(mutex_);
+    return entries_.size();
+}
+
+void DiskResponseCache::LoadIndexLocked()
+{
+    std::string data;
+    if (ReadFile(directory_ / kIndexFileName, data))
+    {
+        IndexReader reader(data);
+        const bool compatible = reader.U32() == kIndexMagic && reader.U32() == kIndexVersion;
+        const uint32_t count = compatible ? reader.U32() : 0;
+
+        // an old index is dropped with its blobs rather than kept around with the keys in the clear
+        if (!compatible)
+        {
+            std::error_code ec;
+            std::filesystem::remove(directory_ / kIndexFileName, ec);
+            ezhttp::trace::Writef("DiskResponseCache", "LoadIndex dropped incompatible index directory=%s", directory_.string().c_str());
+        }
+
+        for (uint32_t i = 0; i < count && reader.Ok(); ++i)
+        {
+            Entry entry;
+            entry.key_digest = reader.Str();
+            entry.blob = reader.Str();
+            entry.status_code = static_cast<long>(reader.I64());
+            entry.status_line = reader.Str();
+            entry.reason = reader.Str();
+            entry.expires_at = static_cast<std::time_t>(reader.I64());
+
+            const uint32_t header_count = reader.U32();
+            for (uint32_t j = 0; j < header_count && reader.Ok(); ++j)
+            {
+                std::string name = reader.Str();
+                entry.header[name] = reader.Str();
+            }
+
+            if (!reader.Ok() || entries_by_key_digest_.count(entry.key_digest))
+                break;
+
+            // blobs lost since the index was written are skipped
+            std::error_code ec;
+            const auto blob_size = std::filesystem::file_size(GetBlobPath(entry.blob), ec);
+            if (ec)
+                continue;
+
+            Blob &blob = blobs_[entry.blob];
+            if (blob.references++ == 0)
+            {
+                blob.size = static_cast<size_t>(blob_size);
+                size_ += blob.size;
+            }
+
+            entries_.push_back(std::move(entry));
+            entries_by_key_digest_[entries_.back().key_digest] = std::prev(entries_.end());
+        }
+    }
+
+    // leftovers of writes interrupted by a crash
+    std::error_code ec;
+    std::vector<std::filesystem::path> orphans;
+    for (std::filesystem::directory_iterator it(directory_, ec), end; !ec && it != end; it.increment(ec))
+    {
+        const auto &path = it->path();
+        if (path.extension() == kTempExtension || (path.extension() == kBlobExtension && !blobs_.count(path.stem().string())))
+            orphans.push_back(path);
+    }
+
+    for (const auto &orphan : orphans)
+        std::filesystem::remove(orphan, ec);
+}
+
+bool DiskResponseCache::SaveIndexLocked()
+{
+    std::string data;
+    IndexWriter writer(data);
+    writer.U32(kIndexMagic);
+    writer.U32(kIndexVersion);
+    writer.U32(static_cast<uint32_t>(entries_.size()));
+
+    for (const auto &entry : entries_)
+    {
+        writer.Str(entry.key_digest);
+        writer.Str(entry.blob);
+        writer.I64(entry.status_code);
+        writer.Str(entry.status_line);
+        writer.Str(entry.reason);
+        writer.I64(static_cast<int64_t>(entry.expires_at));
+
+        writer.U32(static_cast<uint32_t>(entry.header.size()));
+        for (const auto &header_kv : entry.header)
+        {
+            writer.Str(header_kv.first);
+            writer.Str(header_kv.second);
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(directory_, ec);
+
+    if (!WriteFileAtomically(directory_ / kIndexFileName, data))
+    {
+        ezhttp::trace::Writef("DiskResponseCache", "SaveIndex failed directory=%s", directory_.string().c_str());
+        return false;
+    }
+
+    return true;
+}
+
+void DiskResponseCache::EraseLocked(std::list<Entry>::iterator it)
+{
+    auto blob_it = blobs_.find(it->blob);
+    if (blob_it != blobs_.end() && --blob_it->second.references == 0)
+    {
+        // the index no longer references the blob even if it is saved later, so a crash only leaves an orphan
+        std::error_code ec;
+        std::filesystem::remove(GetBlobPath(it->blob), ec);
+        size_ -= blob_it->second.size;
+        blobs_.erase(blob_it);
+    }
+
+    entries_by_key_digest_.erase(it->key_digest);
+    entries_.erase(it);
+}
+
+bool DiskResponseCache::EvictLocked()
+{
+    bool evicted = false;
+    while (size_ > max_bytes_ && !entries_.empty())
+    {
+        EraseLocked(std::prev(entries_.end()));
+        evicted = true;
+    }
+
+    return evicted;
+}
+
+std::filesystem::path DiskResponseCache::GetBlobPath(const std::string &blob) const
+{
+    return directory_ / (blob + kBlobExtension);
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <ctime>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include <cpr/cpr.h>
+
+#include "Response.h"
+
+namespace ezhttp
+{
+    // Responses of ResponseCache kept on disk, so they survive server restarts and map changes.
+    // Bodies are stored in blobs named by their SHA-256, so identical bodies are written once,
+    // the rest is in a compact index file. Both are written to a temporary file and renamed, so a crash
+    // leaves either the old or the new version; blobs not referenced by the index are removed on load.
+    // Least recently used responses are evicted when the blobs don't fit max_bytes.
+    // Keys may hold headers, cookies and proxy credentials, so only their SHA-256 is written to the index.
+    // For the same reason the url is not stored, a loaded response gets the url it is requested with, and
+    // cookies and credentials the server sent back are left out.
+    // Thread-safe, all I/O is done under the lock by the worker threads
+    class DiskResponseCache
+    {
+        static constexpr uint32_t kIndexMagic = 0x43485A45; // "EZHC"
+        static constexpr uint32_t kIndexVersion = 3; // 1 stored the keys themselves, 2 named blobs by FNV-1a and stored urls
+
+        struct Entry
+        {
+            std::string key_digest;
+            std::string blob;
+            long status_code = 0;
+            std::string status_line;
+            std::string reason;
+            cpr::Header header;
+            std::time_t expires_at = 0;
+        };
+
+        struct Blob
+        {
+            size_t size = 0;
+            int references = 0;
+        };
+
+        std::mutex mutex_;
+        std::filesystem::path directory_;
+        size_t max_bytes_;
+        size_t size_ = 0; // total size of the blobs
+        std::list<Entry> entries_; // the most recently used first, the index keeps this order
+        std::unordered_map<std::string, std::list<Entry>::iterator> entries_by_key_digest_;
+        std::unordered_map<std::string, Blob> blobs_;
+
+    public:
+        // Loads the index from the directory, the directory is created on the first store
+        DiskResponseCache(std::filesystem::path directory, size_t max_bytes);
+
+        void SetMaxBytes(size_t max_bytes);
+
+        // Returns the response for the url and the unix time it stays fresh until
+        [[nodiscard]] std::optional<Response> Load(const std::string &key, const cpr::Url &url, std::time_t &expires_at);
+        void Store(const std::string &key, const Response &response, std::time_t expires_at);
+        void Remove(const std::string &key);
+
+        [[nodiscard]] size_t GetSize();
+        [[nodiscard]] size_t GetCount();
+
+    private:
+        void LoadIndexLocked();
+        bool SaveIndexLocked();
+        void EraseLocked(std::list<Entry>::iterator it);
+        bool EvictLocked();
+        [[nodiscard]] std::filesystem::path GetBlobPath(const std::string &blob) const;
+    };
+}
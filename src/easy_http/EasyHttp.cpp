@@ -1,8 +1,10 @@
 #include "EasyHttp.h"
 
 #include <algorithm>
+#include <ctime>
 #include <filesystem>
 #include <fstream>
+#include <random>
 #include <system_error>
 #include <utility>
 
@@ -10,6 +12,8 @@
 
 #include "datetime_service/DateTimeService.h"
 #include "session_factory/CprSessionFactory.h"
+#include "RequestCoalescing.h"
+#include "UrlUtils.h"
 #include "utils/ftp_utils.h"
 #include "utils/TraceLog.h"
 
@@ -27,6 +31,12 @@ namespace
         bool write_failed = false;
     };
 
+    double GetRandom01()
+    {
+        thread_local std::mt19937 random_engine{std::random_device{}()};
+        return std::uniform_real_distribution<double>(0.0, 1.0)(random_engine);
+    }
+
     bool EnsureDirectoryExists(const std::filesystem::path &directory_path)
     {
         if (directory_path.empty())
@@ -103,36 +113,156 @@ namespace
     }
 }
 
-EasyHttp::EasyHttp(std::string ca_cert_path, int threads) : ca_cert_path_(std::move(ca_cert_path)),
-                                                            session_cache_(std::make_shared<CprSessionFactory>(), std::make_shared<DateTimeService>(), std::chrono::seconds(kMaxAgeConnSeconds), kMaxSessionsPerHost)
+EasyHttp::EasyHttp(std::shared_ptr<const CaCertStore> ca_cert_store,
+                   std::shared_ptr<TlsSessionCache> tls_session_cache,
+                   std::shared_ptr<OriginRegistry> origins,
+                   std::shared_ptr<SessionReaper> session_reaper,
+                   std::shared_ptr<RequestExecutor> executor,
+                   int max_concurrency,
+                   int max_per_host,
+                   std::shared_ptr<RateLimiter> host_rate_limiter,
+                   std::shared_ptr<RateLimiter> queue_rate_limiter,
+                   std::shared_ptr<ResponseCache> response_cache,
+                   std::shared_ptr<ConnectPolicies> host_connect_policies,
+                   std::shared_ptr<ConnectPolicies> queue_connect_policies) : ca_cert_store_(std::move(ca_cert_store)),
+                                                                      tls_session_cache_(std::move(tls_session_cache)),
+                                                                      session_cache_(std::make_shared<CprSessionFactory>(), std::make_shared<DateTimeService>(), std::chrono::seconds(kMaxAgeConnSeconds), kMaxSessionsPerHost, 0,
+                                                                                     std::move(origins), std::move(session_reaper)),
+                                                                      executor_(std::move(executor)),
+                                                                      max_concurrency_(std::clamp(max_concurrency, 1, kMaxConcurrency)),
+                                                                      pending_requests_(max_per_host > 0 ? max_per_host : max_concurrency_),
+                                                                      group_by_host_(max_per_host > 0),
+                                                                      host_rate_limiter_(std::move(host_rate_limiter)),
+                                                                      queue_rate_limiter_(std::move(queue_rate_limiter)),
+                                                                      host_connect_policies_(std::move(host_connect_policies)),
+                                                                      queue_connect_policies_(std::move(queue_connect_policies)),
+                                                                      response_cache_(std::move(response_cache))
 {
-    const int worker_count = std::max(1, threads);
-    worker_threads_.reserve(worker_count);
-
-    for (int i = 0; i < worker_count; ++i)
-        worker_threads_.emplace_back(&EasyHttp::WorkerLoop, this);
+    ezhttp::trace::Writef("EasyHttp", "ctor this=%p executor=%p max_concurrency=%d group_by_host=%d max_per_host=%d", this, executor_.get(), max_concurrency_, group_by_host_, pending_requests_.GetMaxPerHost());
+}
 
-    ezhttp::trace::Writef("EasyHttp", "ctor this=%p workers=%d", this, worker_count);
+std::shared_ptr<RequestControl> EasyHttp::SendRequest(RequestMethod method, const cpr::Url &url, RequestOptionsSnapshot options, const ResponseCallback &on_complete)
+{
+    std::vector<BatchRequest> requests;
+    requests.push_back(BatchRequest{method, url, std::move(options), on_complete});
+    return SendRequests(std::move(requests)).front();
 }
 
-std::shared_ptr<RequestControl> EasyHttp::SendRequest(RequestMethod method, const cpr::Url &url, const RequestOptions &options, const ResponseCallback &on_complete)
+std::vector<std::shared_ptr<RequestControl>> EasyHttp::SendRequests(std::vector<BatchRequest> requests)
 {
-    auto request_control = std::make_shared<RequestControl>();
-    cpr::Url normalized_url = url;
+    std::vector<std::shared_ptr<RequestControl>> request_controls;
+    std::vector<std::pair<PendingRequest, std::optional<std::string>>> prepared_requests; // with the coalescing key
+    std::vector<CompletedRequest> cache_hits;
+    request_controls.reserve(requests.size());
+    prepared_requests.reserve(requests.size());
+
+    // everything that doesn't need pending_requests_mutex_ is done before it is locked
+    for (auto &request : requests)
+    {
+        auto request_control = std::make_shared<RequestControl>();
+        request_controls.push_back(request_control);
+
+        if (request.method == RequestMethod::FtpUpload || request.method == RequestMethod::FtpDownload)
+            request.url = cpr::Url{utils::NormalizeFtpUrl(request.url.str())};
+
+        // requests that can share a transfer can share a cached response too
+        const bool use_cache = request.options->use_cache && response_cache_;
+        std::optional<std::string> request_key;
+        if (request.options->coalesce || use_cache)
+            request_key = GetCoalescingKey(request.method, request.url, *request.options);
+
+        std::optional<ResponseCache::CachedResponse> cached_response;
+        if (use_cache && request_key)
+        {
+            cached_response = response_cache_->Find(*request_key, ResponseCache::Clock::now());
+            if (cached_response && cached_response->fresh)
+            {
+                ezhttp::trace::Writef("EasyHttp", "SendRequests cache hit this=%p control=%p url=%s", this, request_control.get(), request.url.str().c_str());
+                cache_hits.push_back(CompletedRequest{request_control, std::move(cached_response->response), std::move(request.on_complete)});
+                continue;
+            }
+        }
+
+        // the url is parsed once here, workers look up the session pool by the interned origin
+        std::string host = std::move(request.host);
+        std::string origin = std::move(request.origin);
+        if (host.empty() || origin.empty())
+            origin = UrlUtils::GetOriginByUrl(request.url.str(), host);
+
+        const OriginId origin_id = session_cache_.GetOrigins().Intern(origin);
+        std::string group = group_by_host_ ? host : std::string();
+        PendingRequest pending_request{request_control, request.method, std::move(request.url), std::move(group), std::move(host), origin_id, std::move(request.options), std::move(request.on_complete)};
+
+        if (use_cache && request_key)
+        {
+            pending_request.cache_key = *request_key;
+            if (cached_response)
+                AddCacheValidators(pending_request, std::move(*cached_response));
+        }
+
+        std::optional<std::string> coalescing_key;
+        if (pending_request.options->coalesce)
+            coalescing_key = std::move(request_key);
 
-    if (method == RequestMethod::FtpUpload || method == RequestMethod::FtpDownload)
-        normalized_url = cpr::Url{utils::NormalizeFtpUrl(url.str())};
+        prepared_requests.emplace_back(std::move(pending_request), std::move(coalescing_key));
+    }
 
+    bool enqueued = false;
     {
         std::lock_guard lock_guard(pending_requests_mutex_);
-        pending_requests_.push_back(PendingRequest{request_control, method, normalized_url, options, on_complete});
-        ezhttp::trace::Writef("EasyHttp", "SendRequest this=%p control=%p method=%d pending=%zu url=%s", this, request_control.get(), static_cast<int>(method), pending_requests_.size(), normalized_url.str().c_str());
+        for (auto &[pending_request, coalescing_key] : prepared_requests)
+        {
+            // an identical request may have been queued earlier in this batch
+            if (coalescing_key && TryAttachToFlightLocked(*coalescing_key, pending_request.request_control, pending_request.on_complete))
+                continue;
+
+            const auto request_control = pending_request.request_control;
+            if (coalescing_key)
+            {
+                // the transfer gets its own control, so canceling the first request doesn't cancel the others
+                pending_request.flight = std::make_shared<CoalescedFlight>();
+                pending_request.flight->key = *coalescing_key;
+                pending_request.flight->requests.push_back(CoalescedRequest{request_control, std::move(pending_request.on_complete)});
+                pending_request.request_control = std::make_shared<RequestControl>();
+                pending_request.on_complete = nullptr;
+                flights_[*coalescing_key] = pending_request.flight;
+            }
+
+            const RequestMethod method = pending_request.method;
+            const RequestPriority priority = pending_request.options->priority;
+            const std::string url = pending_request.url.str();
+            const std::string group = pending_request.group;
+            pending_requests_.Push(group, priority, std::move(pending_request));
+            enqueued = true;
+
+            ezhttp::trace::Writef(
+                "EasyHttp",
+                "SendRequests this=%p control=%p method=%d priority=%d running=%d pending=%zu (high=%zu normal=%zu low=%zu) hosts=%zu url=%s",
+                this,
+                request_control.get(),
+                static_cast<int>(method),
+                static_cast<int>(priority),
+                running_requests_,
+                pending_requests_.Size(),
+                pending_requests_.Size(RequestPriority::High),
+                pending_requests_.Size(RequestPriority::Normal),
+                pending_requests_.Size(RequestPriority::Low),
+                pending_requests_.GetHostCount(),
+                url.c_str());
+        }
     }
 
-    TrackRequest(request_control);
-    pending_requests_cv_.notify_one();
+    TrackRequests(request_controls);
+
+    // cached responses complete on the next RunFrame() without a worker
+    for (auto &cache_hit : cache_hits)
+        CompleteRequest(cache_hit.request_control, std::move(cache_hit.response), std::move(cache_hit.on_complete));
 
-    return request_control;
+    // the worker that takes the first request wakes another one for the next, up to max_concurrency_
+    if (enqueued)
+        executor_->Notify(this);
+
+    return request_controls;
 }
 
 EasyHttp::~EasyHttp()
@@ -146,82 +276,335 @@ EasyHttp::~EasyHttp()
         stop_requested_ = true;
     }
 
-    pending_requests_cv_.notify_all();
-
-    for (auto &worker_thread : worker_threads_)
-    {
-        if (worker_thread.joinable())
-            worker_thread.join();
-    }
+    // requests that are already on the workers are canceled and finish quickly, queued ones are never started
+    executor_->RemoveChannel(this);
 
     DropCompletedRequestsWithoutCallbacks();
     ClearTrackedRequestsWithoutCallbacks();
 
     {
         std::lock_guard lock_guard(pending_requests_mutex_);
-        pending_requests_.clear();
+        pending_requests_.Clear();
+        backoff_requests_.clear();
+        flights_.clear();
     }
 
     ezhttp::trace::Writef("EasyHttp", "dtor end this=%p", this);
 }
 
-void EasyHttp::WorkerLoop()
+bool EasyHttp::RunNext()
 {
-    while (true)
+    PendingRequest pending_request;
+    std::string group; // kept apart, a retry moves the request back into the queue
+    bool has_free_slot;
+
     {
-        PendingRequest pending_request;
+        std::lock_guard lock_guard(pending_requests_mutex_);
+        if (stop_requested_ || running_requests_ >= max_concurrency_)
+            return false;
 
-        {
-            std::unique_lock lock_guard(pending_requests_mutex_);
-            pending_requests_cv_.wait(lock_guard, [this]()
-                                      { return stop_requested_ || !pending_requests_.empty(); });
+        // fails when nothing is waiting or every waiting host is at its limit or out of tokens
+        const auto now = RateLimiter::Clock::now();
+        RequeueDueRetriesLocked(now);
+        std::optional<RateLimiter::Clock::time_point> retry_at;
+        auto try_start = [this, now, &retry_at](const PendingRequest &request)
+        { return TryAcquireRateLimits(request, now, retry_at); };
 
-            if (pending_requests_.empty())
-                return;
+        if (!pending_requests_.TryPop(group, pending_request, try_start))
+        {
+            // RunFrame() notifies the executor again when the first token is available
+            if (retry_at && (!rate_limit_retry_at_ || *retry_at < *rate_limit_retry_at_))
+                rate_limit_retry_at_ = retry_at;
 
-            pending_request = std::move(pending_requests_.front());
-            pending_requests_.pop_front();
+            return false;
         }
 
-        ezhttp::trace::Writef(
-            "EasyHttp",
-            "WorkerLoop dequeued this=%p control=%p canceled=%d forgotten=%d url=%s",
-            this,
-            pending_request.request_control.get(),
-            pending_request.request_control->canceled.load(),
-            pending_request.request_control->forgotten.load(),
-            pending_request.url.str().c_str()
-        );
+        ++running_requests_;
+        has_free_slot = running_requests_ < max_concurrency_ && !pending_requests_.Empty();
+    }
+
+    // one Notify() starts one request, the next free slot is handed to another worker before the transfer,
+    // so a batch or the requests released by a rate limit run up to max_concurrency_ at once
+    if (has_free_slot)
+        executor_->Notify(this);
+
+    ProcessRequest(pending_request);
+
+    bool has_pending;
+    {
+        std::lock_guard lock_guard(pending_requests_mutex_);
+        --running_requests_;
+        pending_requests_.Finish(group);
+        has_pending = !stop_requested_ && !pending_requests_.Empty();
+    }
 
-        Response response = pending_request.request_control->canceled.load()
-                                ? CreateErrorResponse(pending_request.url, cpr::ErrorCode::REQUEST_CANCELLED, "Request canceled before dispatch")
-                                : SendRequest(pending_request.request_control, pending_request.method, pending_request.url, pending_request.options);
+    // requests that were skipped because of the concurrency or host cap get a worker now
+    if (has_pending)
+        executor_->Notify(this);
 
-        if (pending_request.request_control->canceled.load())
-            response = CreateErrorResponse(pending_request.url, cpr::ErrorCode::REQUEST_CANCELLED, "Request canceled before completion");
-        else if (pending_request.request_control->forgotten.load())
-            response = CreateErrorResponse(pending_request.url, cpr::ErrorCode::REQUEST_CANCELLED, "Request forgotten before completion");
+    return true;
+}
 
-        bool forgotten = pending_request.request_control->forgotten.load();
+void EasyHttp::ProcessRequest(PendingRequest &pending_request)
+{
+    ezhttp::trace::Writef(
+        "EasyHttp",
+        "ProcessRequest dequeued this=%p control=%p canceled=%d forgotten=%d url=%s",
+        this,
+        pending_request.request_control.get(),
+        pending_request.request_control->canceled.load(),
+        pending_request.request_control->forgotten.load(),
+        pending_request.url.str().c_str()
+    );
+
+    if (pending_request.flight && pending_request.flight->IsEveryRequestCanceled())
+        pending_request.request_control->canceled.store(true);
+
+    Response response;
+    if (pending_request.request_control->canceled.load())
+        response = CreateErrorResponse(pending_request.url, cpr::ErrorCode::REQUEST_CANCELLED, "Request canceled before dispatch");
+    else if (pending_request.attempt > 1 && requests_forgotten_.load())
+        response = CreateErrorResponse(pending_request.url, cpr::ErrorCode::REQUEST_CANCELLED, "Retry dropped, the request was forgotten");
+    else if (!TryLoadFromDiskCache(pending_request, response))
+        response = SendRequest(pending_request.request_control, pending_request.flight, pending_request.method, pending_request.url, pending_request.origin, *pending_request.options);
+
+    // forgotten requests still reached the server, so its limits are honored for them too
+    if (!pending_request.request_control->canceled.load() && !response.from_cache)
+    {
+        ApplyServerRateLimit(pending_request, response);
+
+        if (TryScheduleRetry(pending_request, response))
+            return;
+
+        ApplyResponseCache(pending_request, response);
+    }
+
+    response.attempts = pending_request.attempt;
+
+    if (pending_request.flight)
+        CompleteFlight(pending_request, response);
+    else
+        CompleteRequest(pending_request.request_control, std::move(response), std::move(pending_request.on_complete));
+}
+
+void EasyHttp::CompleteFlight(PendingRequest &pending_request, const Response &response)
+{
+    CoalescedFlight &flight = *pending_request.flight;
+
+    std::vector<CoalescedRequest> requests;
+    {
+        // nothing attaches to the flight once it is out of flights_
+        std::lock_guard lock_guard(pending_requests_mutex_);
+        auto it = flights_.find(flight.key);
+        if (it != flights_.end() && it->second == pending_request.flight)
+            flights_.erase(it);
+
+        std::lock_guard flight_lock_guard(flight.mutex);
+        requests.swap(flight.requests);
+    }
+
+    ezhttp::trace::Writef("EasyHttp", "CompleteFlight this=%p requests=%zu url=%s", this, requests.size(), pending_request.url.str().c_str());
+
+    for (auto &request : requests)
+        CompleteRequest(request.request_control, response, std::move(request.on_complete));
+}
+
+void EasyHttp::CompleteRequest(const std::shared_ptr<RequestControl> &request_control, Response response, ResponseCallback on_complete)
+{
+    if (request_control->canceled.load())
+        response = CreateErrorResponse(response.url, cpr::ErrorCode::REQUEST_CANCELLED, "Request canceled before completion");
+    else if (request_control->forgotten.load())
+        response = CreateErrorResponse(response.url, cpr::ErrorCode::REQUEST_CANCELLED, "Request forgotten before completion");
+
+    bool forgotten = request_control->forgotten.load();
+    if (!forgotten)
+    {
+        std::lock_guard lock_guard(completed_requests_mutex_);
+        forgotten = request_control->forgotten.load();
         if (!forgotten)
         {
-            std::lock_guard lock_guard(completed_requests_mutex_);
-            forgotten = pending_request.request_control->forgotten.load();
-            if (!forgotten)
-            {
-                completed_requests_.push_back(CompletedRequest{
-                    pending_request.request_control,
-                    std::move(response),
-                    std::move(pending_request.on_complete)});
-                ezhttp::trace::Writef("EasyHttp", "WorkerLoop queued completion this=%p control=%p completed=%zu", this, pending_request.request_control.get(), completed_requests_.size());
-                continue;
-            }
+            completed_requests_.push_back(CompletedRequest{
+                request_control,
+                std::move(response),
+                std::move(on_complete)});
+            ezhttp::trace::Writef("EasyHttp", "CompleteRequest queued completion this=%p control=%p completed=%zu", this, request_control.get(), completed_requests_.size());
+            return;
         }
+    }
+
+    request_control->completed.store(true);
+    FinishTrackedRequest(request_control);
+    ezhttp::trace::Writef("EasyHttp", "CompleteRequest dropped forgotten completion this=%p control=%p", this, request_control.get());
+}
+
+bool EasyHttp::TryAttachToFlightLocked(const std::string &key, const std::shared_ptr<RequestControl> &request_control, const ResponseCallback &on_complete)
+{
+    auto it = flights_.find(key);
+
+    // a transfer of canceled requests may be aborted at any moment, a new one is started instead
+    if (it == flights_.end() || it->second->IsEveryRequestCanceled())
+        return false;
 
-        pending_request.request_control->completed.store(true);
-        FinishTrackedRequest(pending_request.request_control);
-        ezhttp::trace::Writef("EasyHttp", "WorkerLoop dropped forgotten completion this=%p control=%p", this, pending_request.request_control.get());
+    std::lock_guard flight_lock_guard(it->second->mutex);
+    it->second->requests.push_back(CoalescedRequest{request_control, on_complete});
+
+    ezhttp::trace::Writef("EasyHttp", "TryAttachToFlight this=%p control=%p requests=%zu", this, request_control.get(), it->second->requests.size());
+    return true;
+}
+
+bool EasyHttp::TryAcquireRateLimits(const PendingRequest &pending_request, RateLimiter::Clock::time_point now, std::optional<RateLimiter::Clock::time_point> &retry_at)
+{
+    // canceled requests are not sent, so they don't wait for tokens
+    if (pending_request.request_control->canceled.load())
+        return true;
+
+    RateLimiter::Clock::time_point token_at;
+    if (queue_rate_limiter_ && !queue_rate_limiter_->TryAcquire(std::string(), now, token_at))
+    {
+        retry_at = retry_at ? std::min(*retry_at, token_at) : token_at;
+        return false;
     }
+
+    if (host_rate_limiter_ && !host_rate_limiter_->TryAcquire(pending_request.host, now, token_at))
+    {
+        if (queue_rate_limiter_)
+            queue_rate_limiter_->Refund(std::string());
+
+        retry_at = retry_at ? std::min(*retry_at, token_at) : token_at;
+        return false;
+    }
+
+    return true;
+}
+
+void EasyHttp::ApplyServerRateLimit(const PendingRequest &pending_request, const Response &response)
+{
+    if (!host_rate_limiter_ || response.error.code != cpr::ErrorCode::OK)
+        return;
+
+    const auto block_duration = RateLimiter::GetServerBlockDuration(response.status_code, response.header, std::time(nullptr));
+    if (!block_duration)
+        return;
+
+    host_rate_limiter_->BlockUntil(pending_request.host, RateLimiter::Clock::now() + *block_duration);
+    ezhttp::trace::Writef(
+        "EasyHttp",
+        "ApplyServerRateLimit this=%p host=%s status=%ld block_ms=%lld",
+        this,
+        pending_request.host.c_str(),
+        response.status_code,
+        static_cast<long long>(block_duration->count()));
+}
+
+bool EasyHttp::TryScheduleRetry(PendingRequest &pending_request, const Response &response)
+{
+    const auto &retry_policy = pending_request.options->retry_policy;
+    if (!retry_policy || pending_request.attempt >= retry_policy->max_attempts || !IsRetryableResponse(*retry_policy, response))
+        return false;
+
+    std::chrono::milliseconds delay = GetRetryDelay(*retry_policy, pending_request.attempt, GetRandom01());
+
+    // the server knows better when it is ready again
+    if (response.error.code == cpr::ErrorCode::OK)
+    {
+        const auto server_delay = RateLimiter::GetServerBlockDuration(response.status_code, response.header, std::time(nullptr));
+        if (server_delay)
+            delay = std::max(delay, *server_delay);
+    }
+
+    ezhttp::trace::Writef(
+        "EasyHttp",
+        "TryScheduleRetry this=%p control=%p attempt=%d status=%ld error=%d delay_ms=%lld",
+        this,
+        pending_request.request_control.get(),
+        pending_request.attempt,
+        response.status_code,
+        static_cast<int>(response.error.code),
+        static_cast<long long>(delay.count()));
+
+    std::lock_guard lock_guard(pending_requests_mutex_);
+    if (stop_requested_ || requests_forgotten_.load())
+        return false;
+
+    ++pending_request.attempt;
+    pending_request.not_before = RateLimiter::Clock::now() + delay;
+
+    // RunFrame() notifies the executor once the backoff is over, the request is put back in front of its group then
+    if (!rate_limit_retry_at_ || pending_request.not_before < *rate_limit_retry_at_)
+        rate_limit_retry_at_ = pending_request.not_before;
+
+    const auto not_before = pending_request.not_before;
+    backoff_requests_.emplace(not_before, std::move(pending_request));
+    return true;
+}
+
+void EasyHttp::RequeueDueRetriesLocked(RateLimiter::Clock::time_point now)
+{
+    while (!backoff_requests_.empty() && backoff_requests_.begin()->first <= now)
+    {
+        PendingRequest &pending_request = backoff_requests_.begin()->second;
+        const RequestPriority priority = pending_request.options->priority;
+        const std::string group = pending_request.group;
+        pending_requests_.PushFront(group, priority, std::move(pending_request));
+        backoff_requests_.erase(backoff_requests_.begin());
+    }
+
+    if (!backoff_requests_.empty() && (!rate_limit_retry_at_ || backoff_requests_.begin()->first < *rate_limit_retry_at_))
+        rate_limit_retry_at_ = backoff_requests_.begin()->first;
+}
+
+void EasyHttp::AddCacheValidators(PendingRequest &pending_request, ResponseCache::CachedResponse cached_response)
+{
+    // a stale copy is revalidated, unless the plugin sends its own validators
+    const auto &own_header = pending_request.options->header;
+    const bool has_own_validators = own_header && (own_header->count("If-None-Match") || own_header->count("If-Modified-Since"));
+    if (cached_response.validators.empty() || has_own_validators)
+        return;
+
+    // the shared options stay untouched, only this request gets the validators
+    auto options = std::make_shared<RequestOptions>(*pending_request.options);
+    if (!options->header)
+        options->header = cpr::Header{};
+
+    options->header->insert(cached_response.validators.begin(), cached_response.validators.end());
+    pending_request.options = std::move(options);
+    pending_request.stale_response = std::move(cached_response);
+}
+
+bool EasyHttp::TryLoadFromDiskCache(PendingRequest &pending_request, Response &response)
+{
+    // a stale copy from memory or from an earlier attempt is already revalidated
+    if (pending_request.cache_key.empty() || pending_request.stale_response)
+        return false;
+
+    auto cached_response = response_cache_->FindOnDisk(pending_request.cache_key, pending_request.url, ResponseCache::Clock::now(), std::time(nullptr));
+    if (!cached_response)
+        return false;
+
+    if (cached_response->fresh)
+    {
+        ezhttp::trace::Writef("EasyHttp", "TryLoadFromDiskCache hit this=%p control=%p", this, pending_request.request_control.get());
+        response = std::move(cached_response->response);
+        return true;
+    }
+
+    AddCacheValidators(pending_request, std::move(*cached_response));
+    return false;
+}
+
+void EasyHttp::ApplyResponseCache(const PendingRequest &pending_request, Response &response)
+{
+    if (pending_request.cache_key.empty() || response.error.code != cpr::ErrorCode::OK)
+        return;
+
+    const auto now = ResponseCache::Clock::now();
+    if (response.status_code == 304 && pending_request.stale_response)
+    {
+        response = response_cache_->Revalidate(pending_request.cache_key, *pending_request.stale_response, response, now, std::time(nullptr));
+        ezhttp::trace::Writef("EasyHttp", "ApplyResponseCache revalidated this=%p control=%p", this, pending_request.request_control.get());
+    }
+    else
+        response_cache_->Store(pending_request.cache_key, response, now, std::time(nullptr));
 }
 
 bool EasyHttp::TryPopCompletedRequest(CompletedRequest &completed_request)
@@ -279,6 +662,22 @@ void EasyHttp::ClearTrackedRequestsWithoutCallbacks()
 
 void EasyHttp::RunFrame()
 {
+    bool tokens_available = false;
+    {
+        std::lock_guard lock_guard(pending_requests_mutex_);
+        const auto now = RateLimiter::Clock::now();
+        if (rate_limit_retry_at_ && now >= *rate_limit_retry_at_)
+        {
+            rate_limit_retry_at_.reset();
+            RequeueDueRetriesLocked(now);
+            tokens_available = !pending_requests_.Empty();
+        }
+    }
+
+    // every request released by the limit gets a worker, RunNext() wakes the next one up to max_concurrency_
+    if (tokens_available)
+        executor_->Notify(this);
+
     for (int i = 0; i < kMaxTasksExecPerFrame; ++i)
     {
         CompletedRequest completed_request;
@@ -312,6 +711,9 @@ void EasyHttp::RunFrame()
 
 void EasyHttp::ForgetAllRequests()
 {
+    // a retry scheduled before this is dropped by ProcessRequest()
+    requests_forgotten_.store(true);
+
     std::lock_guard lock_guard(requests_mutex_);
     for (auto &request : requests_)
         request->forgotten.store(true);
@@ -322,14 +724,39 @@ void EasyHttp::CancelAllRequests()
     std::lock_guard lock_guard(requests_mutex_);
     for (auto &request : requests_)
         request->canceled.store(true);
+}
+
+void EasyHttp::DropPendingRequests()
+{
+    std::vector<PendingRequest> dropped_requests;
+    {
+        std::lock_guard lock_guard(pending_requests_mutex_);
+        dropped_requests = pending_requests_.TakeWaiting();
+        for (auto &backoff_kv : backoff_requests_)
+            dropped_requests.push_back(std::move(backoff_kv.second));
+
+        backoff_requests_.clear();
+        rate_limit_retry_at_.reset();
+    }
+
+    ezhttp::trace::Writef("EasyHttp", "DropPendingRequests this=%p dropped=%zu", this, dropped_requests.size());
+
+    for (auto &pending_request : dropped_requests)
+    {
+        pending_request.request_control->canceled.store(true);
+        const Response response = CreateErrorResponse(pending_request.url, cpr::ErrorCode::REQUEST_CANCELLED, "Request dropped before dispatch");
 
-    pending_requests_cv_.notify_all();
+        if (pending_request.flight)
+            CompleteFlight(pending_request, response);
+        else
+            CompleteRequest(pending_request.request_control, response, std::move(pending_request.on_complete));
+    }
 }
 
-void EasyHttp::TrackRequest(const std::shared_ptr<RequestControl>& request_control)
+void EasyHttp::TrackRequests(const std::vector<std::shared_ptr<RequestControl>>& request_controls)
 {
     std::lock_guard lock_guard(requests_mutex_);
-    requests_.emplace_back(request_control);
+    requests_.insert(requests_.end(), request_controls.begin(), request_controls.end());
 }
 
 void EasyHttp::FinishTrackedRequest(const std::shared_ptr<RequestControl>& request_control)
@@ -349,16 +776,30 @@ Response EasyHttp::CreateErrorResponse(const cpr::Url &url, cpr::ErrorCode code,
     return response;
 }
 
-void EasyHttp::SetSessionCommonOptions(cpr::Session &session, const std::shared_ptr<RequestControl> &request_control, const cpr::Url & /*url*/, const RequestOptions &options)
+void EasyHttp::SetSessionCommonOptions(cpr::Session &session, std::optional<SessionSettings> &session_settings, const std::shared_ptr<RequestControl> &request_control, const std::shared_ptr<CoalescedFlight> &flight, RequestMethod method, const cpr::Url &url, OriginId origin, const RequestOptions &options)
 {
+    // a reused handle keeps these from the previous request, so only the changed ones are set
+    SessionSettings desired_settings;
 #ifdef LINUX
-    cpr::SslOptions ssl_opt;
-    ssl_opt.ca_info = ca_cert_path_;
-    session.SetSslOptions(ssl_opt);
+    desired_settings.ca_info = ca_cert_store_->GetPath();
+    desired_settings.ca_cert_store = ca_cert_store_;
 #endif
+    desired_settings.tls_session_cache = tls_session_cache_;
+    if (options.timeout)
+        desired_settings.timeout_ms = static_cast<int32_t>(options.timeout->ms.count());
+
+    if (options.connect_timeout)
+        desired_settings.connect_timeout_ms = static_cast<int32_t>(options.connect_timeout->ms.count());
+
+    if (method != RequestMethod::FtpUpload && method != RequestMethod::FtpDownload)
+        desired_settings.SetAuth(options.auth);
+
+    SetConnectPolicy(desired_settings, url, origin);
+    ApplySessionSettings(session, session_settings, desired_settings);
 
+    // cpr keeps the callback in the session, which is created for every request
     session.SetProgressCallback(cpr::ProgressCallback(
-        [request_control](cpr::cpr_off_t download_total, cpr::cpr_off_t download_now, cpr::cpr_off_t upload_total, cpr::cpr_off_t upload_now, intptr_t /*userdata*/)
+        [request_control, flight](cpr::cpr_off_t download_total, cpr::cpr_off_t download_now, cpr::cpr_off_t upload_total, cpr::cpr_off_t upload_now, intptr_t /*userdata*/)
         {
             request_control->SetProgress(
                 static_cast<int32_t>(download_total),
@@ -366,53 +807,127 @@ void EasyHttp::SetSessionCommonOptions(cpr::Session &session, const std::shared_
                 static_cast<int32_t>(upload_total),
                 static_cast<int32_t>(upload_now));
 
+            if (flight)
+            {
+                flight->SetProgress(
+                    static_cast<int32_t>(download_total),
+                    static_cast<int32_t>(download_now),
+                    static_cast<int32_t>(upload_total),
+                    static_cast<int32_t>(upload_now));
+
+                if (flight->IsEveryRequestCanceled())
+                    request_control->canceled.store(true);
+            }
+
             return !request_control->canceled.load();
         }));
+}
 
-    if (options.timeout)
-        session.SetTimeout(*options.timeout);
+void EasyHttp::SetConnectPolicy(SessionSettings &settings, const cpr::Url &url, OriginId origin)
+{
+    std::optional<ConnectPolicy> policy = queue_connect_policies_ ? queue_connect_policies_->Find(std::string()) : std::nullopt;
 
-    if (options.connect_timeout)
-        session.SetConnectTimeout(*options.connect_timeout);
+    // the origin is scheme://host:port, resolve entries are keyed by host:port
+    std::string host_port;
+    if (host_connect_policies_ && !host_connect_policies_->Empty())
+    {
+        // an origin past the limit of the registry has no id to look up, its url is parsed again
+        std::string origin_str = session_cache_.GetOrigins().GetOrigin(origin);
+        if (origin == kUnpooledOrigin)
+        {
+            std::string host;
+            origin_str = UrlUtils::GetOriginByUrl(url.str(), host);
+        }
+        const size_t scheme_end = origin_str.find("://");
+        if (scheme_end != std::string::npos)
+            host_port = origin_str.substr(scheme_end + 3);
+
+        const size_t port_begin = host_port.rfind(':');
+        if (port_begin != std::string::npos)
+        {
+            std::optional<ConnectPolicy> host_policy = host_connect_policies_->Find(host_port.substr(0, port_begin));
+            if (host_policy)
+                policy = policy ? host_policy->WithFallback(*policy) : std::move(host_policy);
+        }
+    }
+
+    if (!policy)
+        return;
+
+    switch (policy->ip_version)
+    {
+    case IpVersion::Any:
+        settings.ip_resolve = CURL_IPRESOLVE_WHATEVER;
+        break;
+
+    case IpVersion::V4:
+        settings.ip_resolve = CURL_IPRESOLVE_V4;
+        break;
+
+    case IpVersion::V6:
+        settings.ip_resolve = CURL_IPRESOLVE_V6;
+        break;
+    }
+
+    if (policy->happy_eyeballs_timeout_ms >= 0)
+        settings.happy_eyeballs_timeout_ms = policy->happy_eyeballs_timeout_ms;
+
+    // an ip literal host is never resolved
+    if (!policy->resolve_addresses.empty() && !host_port.empty() && host_port[0] != '[')
+        settings.resolve = "+" + host_port + ":" + policy->resolve_addresses;
 }
 
-Response EasyHttp::SendRequest(const std::shared_ptr<RequestControl> &request_control, RequestMethod method, const cpr::Url &url, const RequestOptions &options)
+Response EasyHttp::SendRequest(const std::shared_ptr<RequestControl> &request_control, const std::shared_ptr<CoalescedFlight> &flight, RequestMethod method, const cpr::Url &url, OriginId origin, const RequestOptions &options)
 {
-    std::unique_ptr<cpr::Session> session = session_cache_.GetSession(url.str());
+    // the origin was interned when the request was sent
+    std::optional<SessionSettings> session_settings;
+    std::unique_ptr<cpr::Session> session = session_cache_.GetSessionForOrigin(url.str(), origin, &session_settings);
     if (!session)
         return CreateErrorResponse(url, cpr::ErrorCode::INVALID_URL_FORMAT, "Invalid URL");
 
     if (request_control->canceled.load())
         return CreateErrorResponse(url, cpr::ErrorCode::REQUEST_CANCELLED, "Request canceled before transfer");
 
-    SetSessionCommonOptions(*session, request_control, url, options);
+    SetSessionCommonOptions(*session, session_settings, request_control, flight, method, url, origin, options);
 
     Response response;
-    switch (method)
     {
-    case RequestMethod::HttpGet:
-    case RequestMethod::HttpPost:
-    case RequestMethod::HttpPut:
-    case RequestMethod::HttpPatch:
-    case RequestMethod::HttpDelete:
-        response = SendHttpRequest(*session, request_control, method, url, options);
-        break;
+        // counts the handshake if the transfer connects, ends before another request can get the handle
+        std::optional<TlsSessionCache::TransferScope> tls_scope;
+        if (tls_session_cache_)
+            tls_scope.emplace(*tls_session_cache_, session->GetCurlHolder()->handle);
 
-    case RequestMethod::FtpUpload:
-        response = FtpUpload(*session, request_control, url, options);
-        break;
+        switch (method)
+        {
+        case RequestMethod::HttpGet:
+        case RequestMethod::HttpPost:
+        case RequestMethod::HttpPut:
+        case RequestMethod::HttpPatch:
+        case RequestMethod::HttpDelete:
+            response = SendHttpRequest(*session, request_control, method, url, options);
+            break;
 
-    case RequestMethod::FtpDownload:
-        response = FtpDownload(*session, request_control, url, options);
-        break;
+        case RequestMethod::FtpUpload:
+            response = FtpUpload(*session, request_control, url, options);
+            session_settings.reset(); // ftp transfers set ssl options directly
+            break;
 
-    default:
-        response = CreateErrorResponse(url, cpr::ErrorCode::INTERNAL_ERROR, "Unsupported request method");
-        break;
+        case RequestMethod::FtpDownload:
+            response = FtpDownload(*session, request_control, url, options);
+            session_settings.reset();
+            break;
+
+        default:
+            response = CreateErrorResponse(url, cpr::ErrorCode::INTERNAL_ERROR, "Unsupported request method");
+            break;
+        }
     }
 
     if (ShouldReuseSession(request_control, response))
-        session_cache_.ReturnSession(*session);
+        session_cache_.ReturnSessionToOrigin(origin, session->GetCurlHolder(), std::move(session_settings));
+
+    if (options.response_decoder && response.error.code == cpr::ErrorCode::OK)
+        response.decoded_body = options.response_decoder(response);
 
     return response;
 }
@@ -436,7 +951,16 @@ Response EasyHttp::SendHttpRequest(cpr::Session &session, const std::shared_ptr<
     if (options.form_payload)
         session.SetPayload(*options.form_payload);
 
-    if (options.body)
+    if (options.body_factory)
+    {
+        // nothing is sent when the body can't be built
+        std::optional<std::string> body = options.body_factory();
+        if (!body)
+            return CreateErrorResponse(url, cpr::ErrorCode::INTERNAL_ERROR, "Failed to build the request body");
+
+        session.SetBody(cpr::Body(std::move(*body)));
+    }
+    else if (options.body)
         session.SetBody(*options.body);
 
     if (options.header)
@@ -460,9 +984,6 @@ Response EasyHttp::SendHttpRequest(cpr::Session &session, const std::shared_ptr<
         session.SetProxyAuth({{protocol, cpr::EncodedAuthentication{user, password}}});
     }
 
-    if (options.auth)
-        session.SetAuth(*options.auth);
-
     if (request_control->canceled.load())
         return CreateErrorResponse(url, cpr::ErrorCode::REQUEST_CANCELLED, "Request canceled before transfer");
 
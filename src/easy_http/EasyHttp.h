@@ -1,34 +1,84 @@
 #pragma once
-#include <condition_variable>
+#include <algorithm>
+#include <atomic>
 #include <deque>
+#include <map>
+#include <memory>
 #include <mutex>
-#include <thread>
+#include <optional>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "CaCertStore.h"
+#include "ConnectPolicy.h"
 #include "EasyHttpInterface.h"
 #include "EasyHttpOptionsBuilder.h"
+#include "HostRequestScheduler.h"
+#include "RateLimiter.h"
+#include "RequestExecutor.h"
+#include "ResponseCache.h"
 #include "session_cache/CprSessionCache.h"
 
 namespace ezhttp
 {
-    class EasyHttp : public EasyHttpInterface
+    class EasyHttp : public EasyHttpInterface, private RequestExecutor::Channel
     {
         static const int kMaxTasksExecPerFrame = 6;
-        static const int kMaxThreads = 10;
-        static const int kMaxSessionsPerHost = kMaxThreads;
+        static constexpr int kMaxConcurrency = 10;
+        static const int kMaxSessionsPerHost = kMaxConcurrency;
         static const int kMaxAgeConnSeconds = 118; // curl uses this value by default (https://everything.curl.dev/transfers/conn/reuse.html)
 
-        std::string ca_cert_path_;
+        std::shared_ptr<const CaCertStore> ca_cert_store_;
+        std::shared_ptr<TlsSessionCache> tls_session_cache_; // declared before session_cache_, so it outlives the handles
 
         CprSessionCache session_cache_;
 
+        struct CoalescedRequest
+        {
+            std::shared_ptr<RequestControl> request_control;
+            ResponseCallback on_complete;
+        };
+
+        // Identical GETs sent as one transfer. The transfer has its own control that is canceled
+        // only when all attached requests are canceled, every request gets a copy of the response
+        // with the same body
+        struct CoalescedFlight
+        {
+            std::string key;
+            std::mutex mutex;
+            std::vector<CoalescedRequest> requests;
+
+            bool IsEveryRequestCanceled()
+            {
+                std::lock_guard lock_guard(mutex);
+                return std::all_of(requests.begin(), requests.end(), [](const CoalescedRequest &request)
+                                   { return request.request_control->canceled.load(); });
+            }
+
+            void SetProgress(int32_t download_total, int32_t download_now, int32_t upload_total, int32_t upload_now)
+            {
+                std::lock_guard lock_guard(mutex);
+                for (auto &request : requests)
+                    request.request_control->SetProgress(download_total, download_now, upload_total, upload_now);
+            }
+        };
+
         struct PendingRequest
         {
             std::shared_ptr<RequestControl> request_control;
             RequestMethod method;
             cpr::Url url;
-            RequestOptions options;
+            std::string group; // scheduling group, the host or empty if requests are not grouped
+            std::string host;
+            OriginId origin; // interned when the request was sent, the key of the session pool
+            RequestOptionsSnapshot options; // replaced by a copy if the request changes it
             ResponseCallback on_complete;
+            int attempt = 1;
+            RateLimiter::Clock::time_point not_before{}; // a repeated request waits for its backoff in backoff_requests_
+            std::shared_ptr<CoalescedFlight> flight{}; // set for coalesced requests, on_complete is empty then
+            std::string cache_key; // set if the response is stored in response_cache_
+            std::optional<ResponseCache::CachedResponse> stale_response{}; // served again if the server answers 304
         };
 
         struct CompletedRequest
@@ -38,43 +88,111 @@ namespace ezhttp
             ResponseCallback on_complete;
         };
 
+        // Requests are executed by the threads of the shared executor, at most max_concurrency_ at a time.
+        // With group_by_host_ hosts take turns and each one has at most max_per_host requests in flight,
+        // otherwise every request is in one group, so requests keep their order within a priority
+        std::shared_ptr<RequestExecutor> executor_;
+        int max_concurrency_;
+
         std::mutex pending_requests_mutex_;
-        std::condition_variable pending_requests_cv_;
-        std::deque<PendingRequest> pending_requests_;
+        HostRequestScheduler<PendingRequest> pending_requests_;
+        bool group_by_host_; // accessed only by the game thread
+
+        // Requests wait in pending_requests_ until both the queue and the host have a token.
+        // The host limiter is shared by the whole module, the queue one by the EasyHttps of the queue
+        std::shared_ptr<RateLimiter> host_rate_limiter_;
+        std::shared_ptr<RateLimiter> queue_rate_limiter_;
+        std::optional<RateLimiter::Clock::time_point> rate_limit_retry_at_; // guarded by pending_requests_mutex_
+
+        // Retries waiting for their backoff, by not_before. They are kept out of pending_requests_, so they don't
+        // hold back the requests queued behind them, and are put back at the front when due.
+        // Guarded by pending_requests_mutex_
+        std::multimap<RateLimiter::Clock::time_point, PendingRequest> backoff_requests_;
+
+        // New connections follow the policy of the host, fields it leaves at the defaults come from the queue one.
+        // Shared the same way as the rate limiters
+        std::shared_ptr<ConnectPolicies> host_connect_policies_;
+        std::shared_ptr<ConnectPolicies> queue_connect_policies_;
+
+        // Shared by the whole module, fresh responses complete on the next RunFrame() without a worker
+        std::shared_ptr<ResponseCache> response_cache_;
+
+        // Transfers that identical requests can still attach to, guarded by pending_requests_mutex_
+        std::unordered_map<std::string, std::shared_ptr<CoalescedFlight>> flights_;
+        int running_requests_{0};
 
         std::mutex completed_requests_mutex_;
         std::deque<CompletedRequest> completed_requests_;
 
         mutable std::mutex requests_mutex_;
-        std::vector<std::thread> worker_threads_;
         std::vector<std::shared_ptr<RequestControl>> requests_;
-        bool stop_requested_{false};
+        bool stop_requested_{false}; // guarded by pending_requests_mutex_
+        std::atomic_bool requests_forgotten_{false}; // nobody waits for the results anymore, so failures are not retried
 
     public:
-        explicit EasyHttp(std::string ca_cert_path, int threads = kMaxThreads);
+        EasyHttp(std::shared_ptr<const CaCertStore> ca_cert_store, std::shared_ptr<TlsSessionCache> tls_session_cache, std::shared_ptr<OriginRegistry> origins, std::shared_ptr<SessionReaper> session_reaper,
+                 std::shared_ptr<RequestExecutor> executor, int max_concurrency = kMaxConcurrency, int max_per_host = 0,
+                 std::shared_ptr<RateLimiter> host_rate_limiter = nullptr, std::shared_ptr<RateLimiter> queue_rate_limiter = nullptr,
+                 std::shared_ptr<ResponseCache> response_cache = nullptr,
+                 std::shared_ptr<ConnectPolicies> host_connect_policies = nullptr, std::shared_ptr<ConnectPolicies> queue_connect_policies = nullptr);
         ~EasyHttp() override;
 
-        std::shared_ptr<RequestControl> SendRequest(RequestMethod method, const cpr::Url &url, const RequestOptions &options, const ResponseCallback &on_complete) override;
+        std::shared_ptr<RequestControl> SendRequest(RequestMethod method, const cpr::Url &url, RequestOptionsSnapshot options, const ResponseCallback &on_complete) override;
+        std::vector<std::shared_ptr<RequestControl>> SendRequests(std::vector<BatchRequest> requests) override;
         void RunFrame() override;
         int GetActiveRequestCount() override
         {
             std::lock_guard lock_guard(requests_mutex_);
             return static_cast<int>(requests_.size());
         }
+        size_t GetPendingRequestCount(RequestPriority priority) override
+        {
+            std::lock_guard lock_guard(pending_requests_mutex_);
+            size_t count = pending_requests_.Size(priority);
+            for (const auto &backoff_kv : backoff_requests_)
+                count += backoff_kv.second.options->priority == priority;
+
+            return count;
+        }
+        int GetRunningRequestCount() override
+        {
+            std::lock_guard lock_guard(pending_requests_mutex_);
+            return running_requests_;
+        }
+        void SetMaxRequestsPerHost(int max_per_host) override
+        {
+            group_by_host_ = true;
+
+            std::lock_guard lock_guard(pending_requests_mutex_);
+            pending_requests_.SetMaxPerHost(max_per_host);
+        }
         void DropCompletedRequestsWithoutCallbacks() override;
         void ForgetAllRequests() override;
         void CancelAllRequests() override;
+        void DropPendingRequests() override;
 
     private:
-        void WorkerLoop();
+        bool RunNext() override;
+        void ProcessRequest(PendingRequest &pending_request);
+        bool TryAcquireRateLimits(const PendingRequest &pending_request, RateLimiter::Clock::time_point now, std::optional<RateLimiter::Clock::time_point> &retry_at);
+        void ApplyServerRateLimit(const PendingRequest &pending_request, const Response &response);
+        bool TryScheduleRetry(PendingRequest &pending_request, const Response &response);
+        void RequeueDueRetriesLocked(RateLimiter::Clock::time_point now);
+        void AddCacheValidators(PendingRequest &pending_request, ResponseCache::CachedResponse cached_response);
+        bool TryLoadFromDiskCache(PendingRequest &pending_request, Response &response);
+        void ApplyResponseCache(const PendingRequest &pending_request, Response &response);
+        bool TryAttachToFlightLocked(const std::string &key, const std::shared_ptr<RequestControl> &request_control, const ResponseCallback &on_complete);
+        void CompleteFlight(PendingRequest &pending_request, const Response &response);
+        void CompleteRequest(const std::shared_ptr<RequestControl> &request_control, Response response, ResponseCallback on_complete);
         bool TryPopCompletedRequest(CompletedRequest &completed_request);
         void ClearTrackedRequestsWithoutCallbacks();
-        void TrackRequest(const std::shared_ptr<RequestControl>& request_control);
+        void TrackRequests(const std::vector<std::shared_ptr<RequestControl>>& request_controls);
         void FinishTrackedRequest(const std::shared_ptr<RequestControl>& request_control);
         bool ShouldReuseSession(const std::shared_ptr<RequestControl>& request_control, const Response& response) const;
         Response CreateErrorResponse(const cpr::Url &url, cpr::ErrorCode code, std::string message) const;
-        Response SendRequest(const std::shared_ptr<RequestControl> &request_control, RequestMethod method, const cpr::Url &url, const RequestOptions &options);
-        void SetSessionCommonOptions(cpr::Session &session, const std::shared_ptr<RequestControl> &request_control, const cpr::Url &url, const RequestOptions &options);
+        Response SendRequest(const std::shared_ptr<RequestControl> &request_control, const std::shared_ptr<CoalescedFlight> &flight, RequestMethod method, const cpr::Url &url, OriginId origin, const RequestOptions &options);
+        void SetSessionCommonOptions(cpr::Session &session, std::optional<SessionSettings> &session_settings, const std::shared_ptr<RequestControl> &request_control, const std::shared_ptr<CoalescedFlight> &flight, RequestMethod method, const cpr::Url &url, OriginId origin, const RequestOptions &options);
+        void SetConnectPolicy(SessionSettings &settings, const cpr::Url &url, OriginId origin);
         Response SendHttpRequest(cpr::Session &session, const std::shared_ptr<RequestControl> &request_control, RequestMethod method, const cpr::Url &url, const RequestOptions &options);
         Response FtpUpload(cpr::Session &session, const std::shared_ptr<RequestControl> &request_control, const cpr::Url &url, const RequestOptions &options);
         Response FtpDownload(cpr::Session &session, const std::shared_ptr<RequestControl> &request_control, const cpr::Url &url, const RequestOptions &options);
@@ -1,5 +1,8 @@
 #pragma once
 #include <functional>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include "Response.h"
 #include "RequestOptions.h"
@@ -13,12 +16,31 @@ namespace ezhttp
     public:
         using ResponseCallback = std::function<void(Response)>;
 
+        struct BatchRequest
+        {
+            RequestMethod method;
+            cpr::Url url;
+            RequestOptionsSnapshot options;
+            ResponseCallback on_complete;
+            std::string host{}; // both are parsed from the url if either is empty
+            std::string origin{};
+        };
+
     public:
         virtual ~EasyHttpInterface() = default;
 
-        virtual std::shared_ptr<RequestControl> SendRequest(RequestMethod method, const cpr::Url &url, const RequestOptions &options, const ResponseCallback& on_complete) = 0;
+        virtual std::shared_ptr<RequestControl> SendRequest(RequestMethod method, const cpr::Url &url, RequestOptionsSnapshot options, const ResponseCallback& on_complete) = 0;
+
+        // Enqueues the requests at once with one lock of the queue, they run in parallel up to the concurrency
+        // and host limits like requests sent one by one. Returns the controls in the order of the requests
+        virtual std::vector<std::shared_ptr<RequestControl>> SendRequests(std::vector<BatchRequest> requests) = 0;
         virtual void RunFrame() = 0;
         virtual int GetActiveRequestCount() = 0;
+        virtual size_t GetPendingRequestCount(RequestPriority priority) = 0;
+        virtual int GetRunningRequestCount() = 0;
+
+        // Groups waiting requests by host: hosts take turns and at most max_per_host requests to one host are executed at the same time
+        virtual void SetMaxRequestsPerHost(int max_per_host) = 0;
         virtual void DropCompletedRequestsWithoutCallbacks() = 0;
 
         // No callback functions will be called for all current requests
@@ -26,5 +48,9 @@ namespace ezhttp
 
         // All requests will be interrupted as soon as possible
         virtual void CancelAllRequests() = 0;
+
+        // Requests that are not started yet, including those waiting for rate limits or a retry backoff,
+        // are completed as canceled without a transfer. Running requests are not touched
+        virtual void DropPendingRequests() = 0;
     };
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include <memory>
 #include <optional>
 #include <utility>
 #include <string>
@@ -9,91 +10,198 @@
 
 namespace ezhttp
 {
+    // Options are shared with the requests sent with them and copied on the first change after that,
+    // so dispatching the same options many times doesn't copy them
     class EasyHttpOptionsBuilder
     {
-        RequestOptions options_;
+        std::shared_ptr<RequestOptions> options_ = std::make_shared<RequestOptions>();
+
+        // Set once options_ is handed out. use_count() isn't asked instead, a worker releasing a snapshot
+        // doesn't synchronize with the game thread, so a count of 1 doesn't prove the options are no longer read
+        mutable bool shared_ = false;
 
     public:
+        EasyHttpOptionsBuilder() = default;
+
+        EasyHttpOptionsBuilder(const EasyHttpOptionsBuilder& other) : options_(other.options_), shared_(true) {
+            other.shared_ = true;
+        }
+
+        EasyHttpOptionsBuilder& operator=(const EasyHttpOptionsBuilder& other) {
+            options_ = other.options_;
+            shared_ = true;
+            other.shared_ = true;
+            return *this;
+        }
+
+        EasyHttpOptionsBuilder(EasyHttpOptionsBuilder&&) = default;
+        EasyHttpOptionsBuilder& operator=(EasyHttpOptionsBuilder&&) = default;
+
         void SetUserAgent(const std::string& user_agent) {
-            options_.user_agent = cpr::UserAgent(user_agent);
+            RequestOptions& options = Mutable();
+            options.user_agent = cpr::UserAgent(user_agent);
         }
 
         void AddUrlParameter(const std::string& key, const std::string& value) {
-            if (!options_.url_parameters)
-                options_.url_parameters = cpr::Parameters{};
+            RequestOptions& options = Mutable();
+            if (!options.url_parameters)
+                options.url_parameters = cpr::Parameters{};
 
-            options_.url_parameters->Add({key, value});
+            options.url_parameters->Add({key, value});
         }
 
         void AddFormPayload(const std::string& key, const std::string& value) {
-            if (!options_.form_payload)
-                options_.form_payload = cpr::Payload{};
+            RequestOptions& options = Mutable();
+            if (!options.form_payload)
+                options.form_payload = cpr::Payload{};
 
-            options_.form_payload->Add({key, value});
+            options.form_payload->Add({key, value});
         }
 
         void SetBody(const std::string& body) {
-            options_.body = cpr::Body(body);
+            RequestOptions& options = Mutable();
+            options.body = cpr::Body(body);
+            options.body_factory = nullptr;
+        }
+
+        void SetBodyFactory(std::function<std::optional<std::string>()> body_factory) {
+            RequestOptions& options = Mutable();
+            options.body_factory = std::move(body_factory);
+            options.body.reset();
         }
 
         void AppendBody(const std::string& body) {
-            if (!options_.body)
+            RequestOptions& options = Mutable();
+            if (!options.body)
                 SetBody(body);
             else
-                *options_.body += body;
+                *options.body += body;
         }
 
         void SetHeader(const std::string& key, const std::string& value) {
-            if (!options_.header)
-                options_.header = cpr::Header{};
+            RequestOptions& options = Mutable();
+            if (!options.header)
+                options.header = cpr::Header{};
 
-            (*options_.header)[key] = value;
+            (*options.header)[key] = value;
         }
 
         void SetCookie(const std::string& key, const std::string& value) {
-            if (!options_.cookies)
-                options_.cookies = cpr::Cookies{};
+            RequestOptions& options = Mutable();
+            if (!options.cookies)
+                options.cookies = cpr::Cookies{};
 
-            auto it = std::find_if(options_.cookies->begin(), options_.cookies->end(), [&key](const auto& item) { return item.GetName() == key; });
-            if (it == options_.cookies->end())
+            auto it = std::find_if(options.cookies->begin(), options.cookies->end(), [&key](const auto& item) { return item.GetName() == key; });
+            if (it == options.cookies->end())
             {
-                options_.cookies->push_back(cpr::Cookie(key, value));
+                options.cookies->push_back(cpr::Cookie(key, value));
             }
             else
             {
-                size_t index = it - options_.cookies->begin();
-                (*options_.cookies)[index] = cpr::Cookie(key, value);
+                size_t index = it - options.cookies->begin();
+                (*options.cookies)[index] = cpr::Cookie(key, value);
             }
         }
 
         void SetTimeout(int32_t timeout_ms) {
-            options_.timeout = cpr::Timeout{timeout_ms};
+            RequestOptions& options = Mutable();
+            options.timeout = cpr::Timeout{timeout_ms};
         }
 
         void SetConnectTimeout(int32_t timeout_ms) {
-            options_.connect_timeout = cpr::ConnectTimeout{timeout_ms};
+            RequestOptions& options = Mutable();
+            options.connect_timeout = cpr::ConnectTimeout{timeout_ms};
         }
 
         void SetProxy(const std::string& proxy_url) {
-            options_.proxy_url = proxy_url;
+            RequestOptions& options = Mutable();
+            options.proxy_url = proxy_url;
         }
 
         void SetProxyAuth(const std::string& user, const std::string& password) {
-            options_.proxy_auth = {user, password};
+            RequestOptions& options = Mutable();
+            options.proxy_auth = {user, password};
         }
 
         void SetAuth(const std::string& user, const std::string& password) {
-            options_.auth = cpr::Authentication(user, password, cpr::AuthMode::BASIC);
+            RequestOptions& options = Mutable();
+            options.auth = cpr::Authentication(user, password, cpr::AuthMode::BASIC);
         }
 
         void SetSecure(bool secure) {
-            options_.require_secure = secure;
+            RequestOptions& options = Mutable();
+            options.require_secure = secure;
+        }
+
+        void SetPriority(RequestPriority priority) {
+            RequestOptions& options = Mutable();
+            options.priority = priority;
+        }
+
+        void SetRetry(int max_attempts, std::chrono::milliseconds backoff_base, std::chrono::milliseconds backoff_cap, double jitter) {
+            RequestOptions& options = Mutable();
+            if (!options.retry_policy)
+                options.retry_policy = RetryPolicy{};
+
+            options.retry_policy->max_attempts = max_attempts;
+            options.retry_policy->backoff_base = backoff_base;
+            options.retry_policy->backoff_cap = backoff_cap;
+            options.retry_policy->jitter = jitter;
+        }
+
+        void SetCoalesce(bool coalesce) {
+            RequestOptions& options = Mutable();
+            options.coalesce = coalesce;
+        }
+
+        void SetUseCache(bool use_cache) {
+            RequestOptions& options = Mutable();
+            options.use_cache = use_cache;
+        }
+
+        void AddRetryStatusCode(long status_code) {
+            RequestOptions& options = Mutable();
+            if (!options.retry_policy)
+                options.retry_policy = RetryPolicy{};
+
+            options.retry_policy->status_codes.push_back(status_code);
+        }
+
+        void AddRetryErrorCode(cpr::ErrorCode error_code) {
+            RequestOptions& options = Mutable();
+            if (!options.retry_policy)
+                options.retry_policy = RetryPolicy{};
+
+            options.retry_policy->error_codes.push_back(error_code);
         }
 
         void SetFilePath(const std::string& file_path) {
-            options_.file_path = file_path;
+            RequestOptions& options = Mutable();
+            options.file_path = file_path;
+        }
+
+        void SetResponseDecoder(std::function<std::shared_ptr<void>(const Response&)> response_decoder) {
+            RequestOptions& options = Mutable();
+            options.response_decoder = std::move(response_decoder);
+        }
+
+        [[nodiscard]] const RequestOptions& BuildOptions() const { return *options_; }
+
+        // Immutable options for a request, later changes of the builder don't affect it
+        [[nodiscard]] RequestOptionsSnapshot Snapshot() const {
+            shared_ = true;
+            return options_;
         }
 
-        [[nodiscard]] RequestOptions& BuildOptions() { return options_; }
+    private:
+        RequestOptions& Mutable() {
+            if (shared_)
+            {
+                options_ = std::make_shared<RequestOptions>(*options_);
+                shared_ = false;
+            }
+
+            return *options_;
+        }
     };
 }
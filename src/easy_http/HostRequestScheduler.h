@@ -0,0 +1,207 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "PriorityRequestQueue.h"
+
+namespace ezhttp
+{
+    // Waiting requests grouped by host. At most max_per_host requests of a host are in flight, hosts take turns,
+    // so a slow host can't occupy every worker. Hosts whose top request has a higher priority are served first,
+    // a host that was passed over starvation_limit times in a row gets the next pop.
+    template <class T>
+    class HostRequestScheduler
+    {
+    public:
+        static const int kDefaultStarvationLimit = PriorityRequestQueue<T>::kDefaultStarvationLimit;
+
+    private:
+        struct HostState
+        {
+            PriorityRequestQueue<T> requests;
+            int in_flight = 0;
+            int bypassed = 0;
+        };
+
+        std::unordered_map<std::string, HostState> hosts_;
+
+        // Hosts with waiting requests in round-robin order, the served host moves to the back
+        std::list<std::string> turn_order_;
+
+        int max_per_host_;
+        int starvation_limit_;
+        size_t size_ = 0;
+
+    public:
+        explicit HostRequestScheduler(int max_per_host, int starvation_limit = kDefaultStarvationLimit) : max_per_host_(std::max(1, max_per_host)),
+                                                                                                          starvation_limit_(starvation_limit)
+        {
+        }
+
+        void SetMaxPerHost(int max_per_host) { max_per_host_ = std::max(1, max_per_host); }
+        [[nodiscard]] int GetMaxPerHost() const { return max_per_host_; }
+
+        void Push(const std::string &host, RequestPriority priority, T item)
+        {
+            HostState &state = hosts_[host];
+            if (state.requests.Empty())
+                turn_order_.push_back(host);
+
+            state.requests.Push(priority, std::move(item));
+            ++size_;
+        }
+
+        // Puts a request back before the other requests of its host and priority, it keeps its place in the order
+        void PushFront(const std::string &host, RequestPriority priority, T item)
+        {
+            HostState &state = hosts_[host];
+            if (state.requests.Empty())
+                turn_order_.push_back(host);
+
+            state.requests.PushFront(priority, std::move(item));
+            ++size_;
+        }
+
+        // Returns false if nothing can be started: the scheduler is empty or every waiting host is at its limit.
+        // The popped request counts as in flight for its host until Finish() is called
+        bool TryPop(std::string &host, T &item)
+        {
+            return TryPop(host, item, [](const T &) { return true; });
+        }
+
+        // Same as above, but a host is skipped when try_start(next request of the host) returns false
+        template <class TryStart>
+        bool TryPop(std::string &host, T &item, TryStart try_start)
+        {
+            std::vector<const std::string *> declined_hosts;
+
+            while (true)
+            {
+                auto selected = SelectHost(declined_hosts);
+                if (selected == turn_order_.end())
+                    return false;
+
+                HostState &state = hosts_.at(*selected);
+                if (!try_start(state.requests.Peek()))
+                {
+                    declined_hosts.push_back(&*selected);
+                    continue;
+                }
+
+                for (const auto &waiting_host : turn_order_)
+                {
+                    HostState &waiting_state = hosts_.at(waiting_host);
+                    if (waiting_state.in_flight < max_per_host_)
+                        ++waiting_state.bypassed;
+                }
+
+                host = *selected;
+                turn_order_.erase(selected);
+
+                state.bypassed = 0;
+                ++state.in_flight;
+                item = state.requests.Pop();
+                --size_;
+
+                if (!state.requests.Empty())
+                    turn_order_.push_back(host);
+
+                return true;
+            }
+        }
+
+        void Finish(const std::string &host)
+        {
+            auto it = hosts_.find(host);
+            if (it == hosts_.end())
+                return;
+
+            --it->second.in_flight;
+            if (it->second.in_flight <= 0 && it->second.requests.Empty())
+                hosts_.erase(it);
+        }
+
+        // Moves the waiting requests out, in flight counters are kept until their Finish()
+        std::vector<T> TakeWaiting()
+        {
+            std::vector<T> items;
+            items.reserve(size_);
+            for (auto &host_kv : hosts_)
+            {
+                while (!host_kv.second.requests.Empty())
+                    items.push_back(host_kv.second.requests.Pop());
+            }
+
+            Clear();
+            return items;
+        }
+
+        // Drops waiting requests, in flight counters are kept until their Finish()
+        void Clear()
+        {
+            for (auto it = hosts_.begin(); it != hosts_.end();)
+            {
+                if (it->second.in_flight <= 0)
+                {
+                    it = hosts_.erase(it);
+                    continue;
+                }
+
+                it->second.requests.Clear();
+                it->second.bypassed = 0;
+                ++it;
+            }
+
+            turn_order_.clear();
+            size_ = 0;
+        }
+
+        [[nodiscard]] bool Empty() const { return size_ == 0; }
+        [[nodiscard]] size_t Size() const { return size_; }
+
+        [[nodiscard]] size_t Size(RequestPriority priority) const
+        {
+            size_t count = 0;
+            for (const auto &host_kv : hosts_)
+                count += host_kv.second.requests.Size(priority);
+
+            return count;
+        }
+
+        [[nodiscard]] size_t GetHostCount() const { return turn_order_.size(); }
+
+    private:
+        typename std::list<std::string>::iterator SelectHost(const std::vector<const std::string *> &declined_hosts)
+        {
+            auto selected = turn_order_.end();
+            auto best_priority = RequestPriority::Low;
+
+            for (auto it = turn_order_.begin(); it != turn_order_.end(); ++it)
+            {
+                const HostState &state = hosts_.at(*it);
+                if (state.in_flight >= max_per_host_)
+                    continue;
+
+                if (std::find(declined_hosts.begin(), declined_hosts.end(), &*it) != declined_hosts.end())
+                    continue;
+
+                if (state.bypassed >= starvation_limit_)
+                    return it;
+
+                const RequestPriority priority = state.requests.TopPriority();
+                if (selected == turn_order_.end() || priority > best_priority)
+                {
+                    selected = it;
+                    best_priority = priority;
+                }
+            }
+
+            return selected;
+        }
+    };
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <deque>
+#include <utility>
+
+#include "RequestPriority.h"
+
+namespace ezhttp
+{
+    // FIFO per priority level, higher levels are served first. A waiting level that was bypassed
+    // starvation_limit times in a row gets the next pop, so bulk low priority work still makes progress.
+    template <class T>
+    class PriorityRequestQueue
+    {
+    public:
+        static const int kDefaultStarvationLimit = 8;
+
+    private:
+        std::array<std::deque<T>, kRequestPriorityCount> levels_;
+        std::array<int, kRequestPriorityCount> bypassed_{};
+        int starvation_limit_;
+        size_t size_ = 0;
+
+    public:
+        explicit PriorityRequestQueue(int starvation_limit = kDefaultStarvationLimit) : starvation_limit_(starvation_limit)
+        {
+        }
+
+        void Push(RequestPriority priority, T item)
+        {
+            levels_[static_cast<int>(priority)].push_back(std::move(item));
+            ++size_;
+        }
+
+        // The item goes before the other items of its level, used for requests that are repeated
+        void PushFront(RequestPriority priority, T item)
+        {
+            levels_[static_cast<int>(priority)].push_front(std::move(item));
+            ++size_;
+        }
+
+        // Must not be called on an empty queue
+        T Pop()
+        {
+            const int level = SelectLevel();
+
+            T item = std::move(levels_[level].front());
+            levels_[level].pop_front();
+            --size_;
+
+            for (int i = 0; i < kRequestPriorityCount; ++i)
+            {
+                if (i == level || levels_[i].empty())
+                    bypassed_[i] = 0;
+                else
+                    ++bypassed_[i];
+            }
+
+            return item;
+        }
+
+        // The item Pop() would return, must not be called on an empty queue
+        [[nodiscard]] const T &Peek() const { return levels_[SelectLevel()].front(); }
+
+        void Clear()
+        {
+            for (auto &level : levels_)
+                level.clear();
+
+            bypassed_.fill(0);
+            size_ = 0;
+        }
+
+        [[nodiscard]] bool Empty() const { return size_ == 0; }
+        [[nodiscard]] size_t Size() const { return size_; }
+        [[nodiscard]] size_t Size(RequestPriority priority) const { return levels_[static_cast<int>(priority)].size(); }
+
+        // Highest level with waiting items, must not be called on an empty queue
+        [[nodiscard]] RequestPriority TopPriority() const { return static_cast<RequestPriority>(HighestLevel()); }
+
+    private:
+        int HighestLevel() const
+        {
+            int highest = kRequestPriorityCount - 1;
+            while (levels_[highest].empty())
+                --highest;
+
+            return highest;
+        }
+
+        int SelectLevel() const
+        {
+            const int highest = HighestLevel();
+
+            // the most important of the starving levels goes first
+            for (int i = highest - 1; i >= 0; --i)
+            {
+                if (!levels_[i].empty() && bypassed_[i] >= starvation_limit_)
+                    return i;
+            }
+
+            return highest;
+        }
+    };
+}
@@ -0,0 +1,139 @@
+#include "RateLimiter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include <curl/curl.h>
+
+using namespace ezhttp;
+
+namespace
+{
+    std::optional<double> ParseSeconds(const cpr::Header &header, const char *name)
+    {
+        auto it = header.find(name);
+        if (it == header.end() || it->second.empty())
+            return std::nullopt;
+
+        char *end = nullptr;
+        const double value = std::strtod(it->second.c_str(), &end);
+        if (end == it->second.c_str() || !std::isfinite(value) || value < 0.0)
+            return std::nullopt;
+
+        return value;
+    }
+}
+
+void RateLimiter::SetLimit(const std::string &key, double requests_per_second, int burst)
+{
+    std::lock_guard lock_guard(mutex_);
+
+    if (requests_per_second <= 0.0)
+    {
+        buckets_.erase(key);
+        return;
+    }
+
+    Bucket &bucket = buckets_[key];
+    bucket.requests_per_second = requests_per_second;
+    bucket.burst = std::max(1, burst);
+    bucket.tokens = bucket.burst;
+    bucket.updated = Clock::now();
+}
+
+bool RateLimiter::TryAcquire(const std::string &key, Clock::time_point now, Clock::time_point &retry_at)
+{
+    std::lock_guard lock_guard(mutex_);
+
+    auto blocked_it = blocked_until_.find(key);
+    if (blocked_it != blocked_until_.end())
+    {
+        if (now < blocked_it->second)
+        {
+            retry_at = blocked_it->second;
+            return false;
+        }
+
+        blocked_until_.erase(blocked_it);
+    }
+
+    auto bucket_it = buckets_.find(key);
+    if (bucket_it == buckets_.end())
+        return true;
+
+    Bucket &bucket = bucket_it->second;
+    if (now > bucket.updated)
+    {
+        const double elapsed = std::chrono::duration<double>(now - bucket.updated).count();
+        bucket.tokens = std::min(bucket.burst, bucket.tokens + elapsed * bucket.requests_per_second);
+        bucket.updated = now;
+    }
+
+    if (bucket.tokens >= 1.0)
+    {
+        bucket.tokens -= 1.0;
+        return true;
+    }
+
+    const double wait_seconds = (1.0 - bucket.tokens) / bucket.requests_per_second;
+    retry_at = now + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(wait_seconds));
+    return false;
+}
+
+void RateLimiter::Refund(const std::string &key)
+{
+    std::lock_guard lock_guard(mutex_);
+
+    auto bucket_it = buckets_.find(key);
+    if (bucket_it != buckets_.end())
+        bucket_it->second.tokens = std::min(bucket_it->second.burst, bucket_it->second.tokens + 1.0);
+}
+
+void RateLimiter::BlockUntil(const std::string &key, Clock::time_point until)
+{
+    std::lock_guard lock_guard(mutex_);
+
+    auto &blocked_until = blocked_until_[key];
+    blocked_until = std::max(blocked_until, until);
+}
+
+std::optional<std::chrono::milliseconds> RateLimiter::GetServerBlockDuration(long status_code, const cpr::Header &header, std::time_t now)
+{
+    std::optional<double> wait_seconds;
+
+    if (status_code == 429 || status_code == 503)
+    {
+        wait_seconds = ParseSeconds(header, "Retry-After");
+
+        auto it = header.find("Retry-After");
+        if (!wait_seconds && it != header.end())
+        {
+            // HTTP-date form
+            const std::time_t retry_time = curl_getdate(it->second.c_str(), nullptr);
+            if (retry_time != -1)
+                wait_seconds = static_cast<double>(std::max<std::time_t>(0, retry_time - now));
+        }
+    }
+
+    const std::optional<double> remaining = ParseSeconds(header, "X-RateLimit-Remaining");
+    if (!wait_seconds && remaining && *remaining < 1.0)
+    {
+        wait_seconds = ParseSeconds(header, "X-RateLimit-Reset-After");
+        if (!wait_seconds)
+        {
+            // values that look like a unix time are absolute, the rest are seconds from now
+            const std::optional<double> reset = ParseSeconds(header, "X-RateLimit-Reset");
+            if (reset && *reset > 1000000000.0)
+                wait_seconds = std::max(0.0, *reset - static_cast<double>(now));
+            else
+                wait_seconds = reset;
+        }
+    }
+
+    if (!wait_seconds)
+        return std::nullopt;
+
+    const double clamped_seconds = std::min(*wait_seconds, static_cast<double>(kMaxServerBlockSeconds));
+    return std::chrono::milliseconds(static_cast<long long>(clamped_seconds * 1000.0));
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <chrono>
+#include <ctime>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include <cpr/cpr.h>
+
+namespace ezhttp
+{
+    // Token buckets keyed by host (or by an empty key for a whole queue). A key without a configured limit is
+    // never throttled, but any key can be blocked for a while when the server asks to slow down.
+    // Thread-safe, a limiter may be shared by several EasyHttps.
+    class RateLimiter
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        // Servers asking to wait longer than this are not trusted, the block is shortened
+        static constexpr int kMaxServerBlockSeconds = 600;
+
+    private:
+        struct Bucket
+        {
+            double requests_per_second = 0.0;
+            double burst = 0.0;
+            double tokens = 0.0;
+            Clock::time_point updated{};
+        };
+
+        std::mutex mutex_;
+        std::unordered_map<std::string, Bucket> buckets_;
+        std::unordered_map<std::string, Clock::time_point> blocked_until_;
+
+    public:
+        // requests_per_second <= 0 removes the limit. The bucket starts full, so burst requests are sent at once
+        void SetLimit(const std::string &key, double requests_per_second, int burst);
+
+        // Takes a token for the key. If there is none, returns false and sets retry_at to the time one is available
+        bool TryAcquire(const std::string &key, Clock::time_point now, Clock::time_point &retry_at);
+
+        // Returns the token taken by TryAcquire() when the request is not started after all
+        void Refund(const std::string &key);
+
+        // No tokens are given for the key until the time point
+        void BlockUntil(const std::string &key, Clock::time_point until);
+
+        // Reads Retry-After on 429/503 responses and X-RateLimit-Remaining: 0 with X-RateLimit-Reset-After
+        // or X-RateLimit-Reset (delta seconds or unix time). Returns how long the host asks to wait
+        static std::optional<std::chrono::milliseconds> GetServerBlockDuration(long status_code, const cpr::Header &header, std::time_t now);
+    };
+}
@@ -0,0 +1,98 @@
+#include "RequestCoalescing.h"
+
+using namespace ezhttp;
+
+namespace
+{
+    // length-prefixed, so values can't be mixed up whatever they contain
+    void AppendField(std::string &key, const std::string &value)
+    {
+        key += std::to_string(value.length());
+        key += ':';
+        key += value;
+    }
+}
+
+std::optional<std::string> ezhttp::GetCoalescingKey(RequestMethod method, const cpr::Url &url, const RequestOptions &options)
+{
+    if (method != RequestMethod::HttpGet)
+        return std::nullopt;
+
+    if (options.body || options.body_factory || options.form_payload || options.auth || options.file_path || options.response_decoder)
+        return std::nullopt;
+
+    std::string key;
+    AppendField(key, url.str());
+
+    if (options.url_parameters)
+    {
+        for (const auto &parameter : options.url_parameters->containerList_)
+        {
+            key += 'p';
+            AppendField(key, parameter.key);
+            AppendField(key, parameter.value);
+        }
+    }
+
+    if (options.header)
+    {
+        for (const auto &header_kv : *options.header)
+        {
+            key += 'h';
+            AppendField(key, header_kv.first);
+            AppendField(key, header_kv.second);
+        }
+    }
+
+    if (options.cookies)
+    {
+        for (const auto &cookie : *options.cookies)
+        {
+            key += 'c';
+            AppendField(key, cookie.GetName());
+            AppendField(key, cookie.GetValue());
+        }
+    }
+
+    if (options.user_agent)
+    {
+        key += 'u';
+        AppendField(key, options.user_agent->str());
+    }
+
+    if (options.proxy_url)
+    {
+        key += 'x';
+        AppendField(key, *options.proxy_url);
+    }
+
+    if (options.proxy_auth)
+    {
+        key += 'a';
+        AppendField(key, options.proxy_auth->first);
+        AppendField(key, options.proxy_auth->second);
+    }
+
+    if (options.timeout)
+    {
+        key += 't';
+        AppendField(key, std::to_string(options.timeout->ms.count()));
+    }
+
+    if (options.connect_timeout)
+    {
+        key += 'n';
+        AppendField(key, std::to_string(options.connect_timeout->ms.count()));
+    }
+
+    if (options.retry_policy)
+    {
+        key += 'r';
+        AppendField(key, std::to_string(options.retry_policy->max_attempts));
+    }
+
+    if (options.require_secure)
+        key += 's';
+
+    return key;
+}
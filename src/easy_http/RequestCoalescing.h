@@ -0,0 +1,16 @@
+#pragma once
+#include <optional>
+#include <string>
+
+#include <cpr/cpr.h>
+
+#include "RequestMethod.h"
+#include "RequestOptions.h"
+
+namespace ezhttp
+{
+    // Returns the key shared by requests that produce the same response and can be sent as one transfer,
+    // or nullopt if the request can't be coalesced: only GET requests without a body, authentication,
+    // file or response decoder are. Everything that is sent to the server is a part of the key
+    std::optional<std::string> GetCoalescingKey(RequestMethod method, const cpr::Url &url, const RequestOptions &options);
+}
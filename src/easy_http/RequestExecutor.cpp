@@ -0,0 +1,157 @@
+#include "RequestExecutor.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "utils/TraceLog.h"
+
+using namespace ezhttp;
+
+RequestExecutor::RequestExecutor(int max_threads, int min_threads) : max_threads_(std::max(1, max_threads)),
+                                                                     min_threads_(std::clamp(min_threads, 0, max_threads_))
+{
+    {
+        std::lock_guard lock_guard(mutex_);
+        worker_threads_.reserve(max_threads_);
+
+        for (int i = 0; i < min_threads_; ++i)
+            StartWorkerLocked();
+    }
+
+    ezhttp::trace::Writef("RequestExecutor", "ctor this=%p min_workers=%d max_workers=%d", this, min_threads_, max_threads_);
+}
+
+RequestExecutor::~RequestExecutor()
+{
+    std::vector<std::thread> worker_threads;
+    {
+        std::lock_guard lock_guard(mutex_);
+        stop_requested_ = true;
+        ready_channels_.clear();
+        worker_threads.swap(worker_threads_);
+    }
+
+    ready_cv_.notify_all();
+
+    for (auto &worker_thread : worker_threads)
+    {
+        if (worker_thread.joinable())
+            worker_thread.join();
+    }
+
+    ezhttp::trace::Writef("RequestExecutor", "dtor this=%p", this);
+}
+
+void RequestExecutor::Notify(Channel *channel)
+{
+    {
+        std::lock_guard lock_guard(mutex_);
+        if (stop_requested_)
+            return;
+
+        ready_channels_.push_back(channel);
+
+        JoinRetiredWorkersLocked();
+        if (static_cast<int>(ready_channels_.size()) > idle_workers_ && worker_count_ < max_threads_)
+            StartWorkerLocked();
+    }
+
+    ready_cv_.notify_one();
+}
+
+void RequestExecutor::RemoveChannel(Channel *channel)
+{
+    std::unique_lock lock_guard(mutex_);
+    channel_idle_cv_.wait(lock_guard, [this, channel]()
+                          { return running_channels_.find(channel) == running_channels_.end(); });
+
+    ready_channels_.erase(std::remove(ready_channels_.begin(), ready_channels_.end(), channel), ready_channels_.end());
+}
+
+void RequestExecutor::SetMinThreads(int min_threads)
+{
+    {
+        std::lock_guard lock_guard(mutex_);
+        min_threads_ = std::clamp(min_threads, 0, max_threads_);
+
+        while (worker_count_ < min_threads_)
+            StartWorkerLocked();
+    }
+
+    ezhttp::trace::Writef("RequestExecutor", "SetMinThreads this=%p min_workers=%d", this, min_threads_);
+}
+
+void RequestExecutor::RunFrame()
+{
+    std::lock_guard lock_guard(mutex_);
+    JoinRetiredWorkersLocked();
+}
+
+void RequestExecutor::WorkerLoop()
+{
+    while (true)
+    {
+        Channel *channel;
+
+        {
+            std::unique_lock lock_guard(mutex_);
+
+            ++idle_workers_;
+            const bool woken = ready_cv_.wait_for(lock_guard, std::chrono::seconds(kIdleWorkerTimeoutSeconds), [this]()
+                                                  { return stop_requested_ || !ready_channels_.empty(); });
+            --idle_workers_;
+
+            if (stop_requested_)
+                return;
+
+            if (!woken && worker_count_ > min_threads_)
+            {
+                --worker_count_;
+                retired_worker_ids_.push_back(std::this_thread::get_id());
+                ezhttp::trace::Writef("RequestExecutor", "WorkerLoop retire idle worker this=%p workers=%d", this, worker_count_);
+                return;
+            }
+
+            if (!woken)
+                continue;
+
+            channel = ready_channels_.front();
+            ready_channels_.pop_front();
+            ++running_channels_[channel];
+        }
+
+        channel->RunNext();
+
+        {
+            std::lock_guard lock_guard(mutex_);
+            auto it = running_channels_.find(channel);
+            if (--it->second == 0)
+                running_channels_.erase(it);
+        }
+
+        channel_idle_cv_.notify_all();
+    }
+}
+
+void RequestExecutor::StartWorkerLocked()
+{
+    worker_threads_.emplace_back(&RequestExecutor::WorkerLoop, this);
+    ++worker_count_;
+}
+
+void RequestExecutor::JoinRetiredWorkersLocked()
+{
+    for (const auto &worker_id : retired_worker_ids_)
+    {
+        auto it = std::find_if(worker_threads_.begin(), worker_threads_.end(), [&worker_id](const std::thread &worker_thread)
+                               { return worker_thread.get_id() == worker_id; });
+        if (it == worker_threads_.end())
+            continue;
+
+        // the thread has already released the lock and is about to exit
+        it->join();
+        worker_threads_.erase(it);
+    }
+
+    retired_worker_ids_.clear();
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace ezhttp
+{
+    // Worker threads shared by every EasyHttp of the module. EasyHttps are channels: they keep their own
+    // pending requests and concurrency cap and hand out one request at a time to whichever worker is free.
+    class RequestExecutor
+    {
+    public:
+        class Channel
+        {
+        public:
+            virtual ~Channel() = default;
+
+            // Executes one pending request on the calling worker thread.
+            // Returns false if the channel has nothing to run right now (empty or at its concurrency cap)
+            virtual bool RunNext() = 0;
+        };
+
+        static constexpr int kIdleWorkerTimeoutSeconds = 30;
+
+    private:
+        std::mutex mutex_;
+        std::condition_variable ready_cv_;
+        std::condition_variable channel_idle_cv_;
+
+        // One entry per Notify(), a channel may be listed several times
+        std::deque<Channel *> ready_channels_;
+        std::unordered_map<Channel *, int> running_channels_;
+
+        // Workers are started while ready channels outnumber idle workers, up to max_threads_,
+        // and retire after being idle for kIdleWorkerTimeoutSeconds while there are more than min_threads_
+        int max_threads_;
+        int min_threads_;
+        int worker_count_{0};
+        int idle_workers_{0};
+        std::vector<std::thread> worker_threads_;
+        std::vector<std::thread::id> retired_worker_ids_;
+        bool stop_requested_{false};
+
+    public:
+        RequestExecutor(int max_threads, int min_threads);
+        ~RequestExecutor();
+
+        RequestExecutor(const RequestExecutor &) = delete;
+        RequestExecutor &operator=(const RequestExecutor &) = delete;
+
+        // The channel got a request to run
+        void Notify(Channel *channel);
+
+        // Forgets the channel, waits for the workers that are running its requests
+        void RemoveChannel(Channel *channel);
+
+        void SetMinThreads(int min_threads);
+
+        // Joins retired workers, so their stacks are released
+        void RunFrame();
+
+        int GetWorkerCount()
+        {
+            std::lock_guard lock_guard(mutex_);
+            return worker_count_;
+        }
+
+        int GetMaxThreads() const { return max_threads_; }
+
+    private:
+        void WorkerLoop();
+        void StartWorkerLocked();
+        void JoinRetiredWorkersLocked();
+    };
+}
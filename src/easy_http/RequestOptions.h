@@ -1,9 +1,15 @@
 #pragma once
 #include <utility>
 #include <optional>
+#include <functional>
+#include <memory>
 
 #include <cpr/cpr.h>
 
+#include "Response.h"
+#include "RequestPriority.h"
+#include "RetryPolicy.h"
+
 namespace ezhttp
 {
     struct RequestOptions
@@ -20,6 +26,17 @@ namespace ezhttp
         std::optional<std::pair<std::string, std::string>> proxy_auth;
         std::optional<cpr::Authentication> auth;
         bool require_secure = false;
+        RequestPriority priority = RequestPriority::Normal;
         std::optional<std::string> file_path; // for ftp and multipart/form-data in future
+        std::optional<RetryPolicy> retry_policy;
+        bool coalesce = false; // identical GETs sent while one is waiting or in flight share its transfer
+        bool use_cache = false; // GETs are served by the module response cache when it has a fresh copy
+
+        // Both are called on the worker thread, so they must not touch game thread state
+        std::function<std::optional<std::string>()> body_factory; // builds the body right before the transfer, overrides body. std::nullopt fails the request
+        std::function<std::shared_ptr<void>(const Response&)> response_decoder; // result is stored in Response::decoded_body
     };
+
+    // Options of a sent request, shared by everything that sends the same options and never changed
+    using RequestOptionsSnapshot = std::shared_ptr<const RequestOptions>;
 }
@@ -0,0 +1,13 @@
+#pragma once
+
+namespace ezhttp
+{
+    enum class RequestPriority
+    {
+        Low,
+        Normal,
+        High,
+    };
+
+    constexpr int kRequestPriorityCount = 3;
+}
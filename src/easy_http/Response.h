@@ -1,4 +1,7 @@
 #pragma once
+#include <memory>
+#include <string>
+
 #include <cpr/cpr.h>
 
 namespace ezhttp
@@ -6,7 +9,6 @@ namespace ezhttp
     struct Response
     {
         long status_code{};
-        std::string text{};
         cpr::Header header{};
         cpr::Url url{};
         double elapsed{};
@@ -18,24 +20,42 @@ namespace ezhttp
         cpr::cpr_off_t uploaded_bytes{};
         cpr::cpr_off_t downloaded_bytes{};
         long redirect_count{};
+        int attempts{1}; // more than one if the request was repeated by RequestOptions::retry_policy
+        bool from_cache{}; // served by ResponseCache, either fresh or revalidated with a 304
+        std::shared_ptr<void> decoded_body{}; // filled on the worker thread by RequestOptions::response_decoder
 
         explicit Response() = default;
 
-        explicit Response(const cpr::Response& cpr_response)
+        explicit Response(cpr::Response cpr_response)
         {
             status_code = cpr_response.status_code;
-            text = cpr_response.text;
-            header = cpr_response.header;
-            url = cpr_response.url;
+            SetText(std::move(cpr_response.text));
+            header = std::move(cpr_response.header);
+            url = std::move(cpr_response.url);
             elapsed = cpr_response.elapsed;
-            cookies = cpr_response.cookies;
-            error = cpr_response.error;
-            raw_header = cpr_response.raw_header;
-            status_line = cpr_response.status_line;
-            reason = cpr_response.reason;
+            cookies = std::move(cpr_response.cookies);
+            error = std::move(cpr_response.error);
+            raw_header = std::move(cpr_response.raw_header);
+            status_line = std::move(cpr_response.status_line);
+            reason = std::move(cpr_response.reason);
             uploaded_bytes = cpr_response.uploaded_bytes;
             downloaded_bytes = cpr_response.downloaded_bytes;
             redirect_count = cpr_response.redirect_count;
         }
+
+        // The body is shared by copies of the response, e.g. by requests coalesced into one transfer
+        [[nodiscard]] const std::string& text() const
+        {
+            static const std::string empty_text;
+            return shared_text_ ? *shared_text_ : empty_text;
+        }
+
+        void SetText(std::string text)
+        {
+            shared_text_ = std::make_shared<const std::string>(std::move(text));
+        }
+
+    private:
+        std::shared_ptr<const std::string> shared_text_{};
     };
 }
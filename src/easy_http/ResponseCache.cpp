@@ -0,0 +1,290 @@
+#include "ResponseCache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+#include <curl/curl.h>
+
+using namespace ezhttp;
+
+namespace
+{
+    std::string Trim(const std::string &value)
+    {
+        const auto begin = value.find_first_not_of(" \t");
+        if (begin == std::string::npos)
+            return std::string();
+
+        const auto end = value.find_last_not_of(" \t");
+        return value.substr(begin, end - begin + 1);
+    }
+
+    std::string ToLower(std::string value)
+    {
+        std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c)
+                       { return static_cast<char>(std::tolower(c)); });
+        return value;
+    }
+
+    std::optional<long long> ParseDeltaSeconds(const std::string &value)
+    {
+        const std::string trimmed = Trim(value);
+        if (trimmed.empty() || !std::isdigit(static_cast<unsigned char>(trimmed.front())))
+            return std::nullopt;
+
+        return std::strtoll(trimmed.c_str(), nullptr, 10);
+    }
+
+    std::optional<std::time_t> ParseHttpDate(const cpr::Header &header, const char *name)
+    {
+        auto it = header.find(name);
+        if (it == header.end())
+            return std::nullopt;
+
+        const std::time_t time = curl_getdate(it->second.c_str(), nullptr);
+        if (time == -1)
+            return std::nullopt;
+
+        return time;
+    }
+
+    size_t GetEntrySize(const std::string &key, const Response &response)
+    {
+        size_t size = key.size() + response.text().size() + response.raw_header.size() + response.url.str().size();
+        for (const auto &header_kv : response.header)
+            size += header_kv.first.size() + header_kv.second.size();
+
+        return size;
+    }
+}
+
+void ResponseCache::SetMaxBytes(size_t max_bytes)
+{
+    std::lock_guard lock_guard(mutex_);
+    max_bytes_ = max_bytes;
+    EvictLocked();
+}
+
+void ResponseCache::SetDiskCache(std::shared_ptr<DiskResponseCache> disk_cache)
+{
+    std::lock_guard lock_guard(mutex_);
+    disk_cache_ = std::move(disk_cache);
+}
+
+std::optional<ResponseCache::CachedResponse> ResponseCache::Find(const std::string &key, Clock::time_point now)
+{
+    std::lock_guard lock_guard(mutex_);
+
+    auto it = entries_by_key_.find(key);
+    if (it == entries_by_key_.end())
+        return std::nullopt;
+
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return MakeCachedResponse(*it->second, now);
+}
+
+std::optional<ResponseCache::CachedResponse> ResponseCache::FindOnDisk(const std::string &key, const cpr::Url &url, Clock::time_point now, std::time_t date_now)
+{
+    std::shared_ptr<DiskResponseCache> disk_cache;
+    {
+        std::lock_guard lock_guard(mutex_);
+        disk_cache = disk_cache_;
+    }
+
+    if (!disk_cache)
+        return std::nullopt;
+
+    std::time_t expires_at;
+    std::optional<Response> response = disk_cache->Load(key, url, expires_at);
+    if (!response)
+        return std::nullopt;
+
+    // the unix time is turned into the steady clock, which doesn't survive restarts
+    const auto entry_expires_at = now + std::chrono::seconds(expires_at - date_now);
+
+    std::lock_guard lock_guard(mutex_);
+    InsertLocked(key, *response, entry_expires_at);
+
+    Entry entry{key, std::move(*response), entry_expires_at, 0};
+    return MakeCachedResponse(entry, now);
+}
+
+void ResponseCache::Store(const std::string &key, const Response &response, Clock::time_point now, std::time_t date_now)
+{
+    if (response.status_code != 200 || response.error.code != cpr::ErrorCode::OK)
+        return;
+
+    const auto lifetime = GetFreshnessLifetime(response.header, date_now);
+    const bool has_validator = response.header.count("ETag") || response.header.count("Last-Modified");
+    const bool storable = lifetime && (lifetime->count() > 0 || has_validator);
+
+    std::shared_ptr<DiskResponseCache> disk_cache;
+    {
+        std::lock_guard lock_guard(mutex_);
+        disk_cache = disk_cache_;
+
+        auto it = entries_by_key_.find(key);
+        if (it != entries_by_key_.end())
+            EraseLocked(it->second);
+
+        if (storable)
+            InsertLocked(key, response, now + *lifetime);
+    }
+
+    // the disk layer has its own limit, so it may keep responses that don't fit in memory
+    if (disk_cache && storable)
+        disk_cache->Store(key, response, date_now + lifetime->count());
+    else if (disk_cache)
+        disk_cache->Remove(key);
+}
+
+Response ResponseCache::Revalidate(const std::string &key, const CachedResponse &cached, const Response &not_modified, Clock::time_point now, std::time_t date_now)
+{
+    Response response = cached.response;
+    response.url = not_modified.url;
+    response.elapsed = not_modified.elapsed;
+    response.cookies = not_modified.cookies;
+    response.redirect_count = not_modified.redirect_count;
+    response.uploaded_bytes = not_modified.uploaded_bytes;
+    response.downloaded_bytes = not_modified.downloaded_bytes;
+
+    // the 304 carries the up-to-date metadata, the body is described by the cached headers
+    for (const auto &header_kv : not_modified.header)
+    {
+        if (header_kv.first == "Content-Length" || header_kv.first == "Content-Encoding" || header_kv.first == "Transfer-Encoding")
+            continue;
+
+        response.header[header_kv.first] = header_kv.second;
+    }
+
+    response.from_cache = false;
+    Store(key, response, now, date_now);
+
+    response.from_cache = true;
+    return response;
+}
+
+void ResponseCache::Clear()
+{
+    std::lock_guard lock_guard(mutex_);
+    entries_.clear();
+    entries_by_key_.clear();
+    size_ = 0;
+}
+
+size_t ResponseCache::GetSize() const
+{
+    std::lock_guard lock_guard(mutex_);
+    return size_;
+}
+
+size_t ResponseCache::GetCount() const
+{
+    std::lock_guard lock_guard(mutex_);
+    return entries_.size();
+}
+
+std::optional<std::chrono::seconds> ResponseCache::GetFreshnessLifetime(const cpr::Header &header, std::time_t date_now)
+{
+    auto vary_it = header.find("Vary");
+    if (vary_it != header.end() && Trim(vary_it->second) == "*")
+        return std::nullopt;
+
+    std::optional<long long> max_age;
+    bool no_cache = false;
+
+    auto cache_control_it = header.find("Cache-Control");
+    if (cache_control_it != header.end())
+    {
+        size_t begin = 0;
+        while (begin <= cache_control_it->second.size())
+        {
+            size_t end = cache_control_it->second.find(',', begin);
+            if (end == std::string::npos)
+                end = cache_control_it->second.size();
+
+            const std::string directive = ToLower(Trim(cache_control_it->second.substr(begin, end - begin)));
+            begin = end + 1;
+
+            if (directive == "no-store")
+                return std::nullopt;
+
+            if (directive == "no-cache")
+                no_cache = true;
+            else if (directive.compare(0, 8, "max-age=") == 0)
+                max_age = ParseDeltaSeconds(directive.substr(8));
+        }
+    }
+    else
+    {
+        auto pragma_it = header.find("Pragma");
+        no_cache = pragma_it != header.end() && ToLower(Trim(pragma_it->second)) == "no-cache";
+    }
+
+    if (no_cache)
+        return std::chrono::seconds(0);
+
+    long long lifetime = 0;
+    if (max_age)
+        lifetime = *max_age;
+    else if (const auto expires = ParseHttpDate(header, "Expires"))
+    {
+        // the server clock may differ from ours, so the lifetime is measured from its Date
+        const std::time_t date = ParseHttpDate(header, "Date").value_or(date_now);
+        lifetime = static_cast<long long>(*expires - date);
+    }
+
+    auto age_it = header.find("Age");
+    if (age_it != header.end())
+        lifetime -= ParseDeltaSeconds(age_it->second).value_or(0);
+
+    return std::chrono::seconds(std::max(0LL, lifetime));
+}
+
+void ResponseCache::InsertLocked(const std::string &key, const Response &response, Clock::time_point expires_at)
+{
+    auto it = entries_by_key_.find(key);
+    if (it != entries_by_key_.end())
+        EraseLocked(it->second);
+
+    const size_t size = GetEntrySize(key, response);
+    if (size > max_bytes_)
+        return;
+
+    entries_.push_front(Entry{key, response, expires_at, size});
+    entries_.front().response.from_cache = false;
+    entries_by_key_[key] = entries_.begin();
+    size_ += size;
+
+    EvictLocked();
+}
+
+void ResponseCache::EraseLocked(std::list<Entry>::iterator it)
+{
+    size_ -= it->size;
+    entries_by_key_.erase(it->key);
+    entries_.erase(it);
+}
+
+void ResponseCache::EvictLocked()
+{
+    while (size_ > max_bytes_ && !entries_.empty())
+        EraseLocked(std::prev(entries_.end()));
+}
+
+ResponseCache::CachedResponse ResponseCache::MakeCachedResponse(const Entry &entry, Clock::time_point now)
+{
+    CachedResponse cached{entry.response, now < entry.expires_at, {}};
+    cached.response.from_cache = true;
+
+    auto etag_it = entry.response.header.find("ETag");
+    if (etag_it != entry.response.header.end())
+        cached.validators["If-None-Match"] = etag_it->second;
+
+    auto last_modified_it = entry.response.header.find("Last-Modified");
+    if (last_modified_it != entry.response.header.end())
+        cached.validators["If-Modified-Since"] = last_modified_it->second;
+
+    return cached;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <chrono>
+#include <ctime>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include <cpr/cpr.h>
+
+#include "DiskResponseCache.h"
+#include "Response.h"
+
+namespace ezhttp
+{
+    // In-memory LRU cache of GET responses bounded by the total size of the stored responses.
+    // Fresh responses are served without a request, stale ones with a validator (ETag or Last-Modified)
+    // are revalidated with a conditional request and served again on 304 Not Modified.
+    // With a DiskResponseCache stored responses are written through to disk, and a response missing in memory
+    // is looked up there by the worker thread before the request is sent.
+    // Thread-safe, the cache is shared by all EasyHttps of the module
+    class ResponseCache
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        struct CachedResponse
+        {
+            Response response;
+            bool fresh = false;
+            cpr::Header validators; // If-None-Match and If-Modified-Since for a conditional request
+        };
+
+    private:
+        struct Entry
+        {
+            std::string key;
+            Response response;
+            Clock::time_point expires_at{};
+            size_t size = 0;
+        };
+
+        mutable std::mutex mutex_;
+        size_t max_bytes_;
+        size_t size_ = 0;
+        std::list<Entry> entries_; // the most recently used first
+        std::unordered_map<std::string, std::list<Entry>::iterator> entries_by_key_;
+        std::shared_ptr<DiskResponseCache> disk_cache_;
+
+    public:
+        explicit ResponseCache(size_t max_bytes) : max_bytes_(max_bytes) {}
+
+        // 0 disables the cache, entries that don't fit anymore are evicted
+        void SetMaxBytes(size_t max_bytes);
+
+        // Replaces the disk layer, nullptr turns it off
+        void SetDiskCache(std::shared_ptr<DiskResponseCache> disk_cache);
+
+        // Looks up memory only, so it is cheap enough for the game thread
+        [[nodiscard]] std::optional<CachedResponse> Find(const std::string &key, Clock::time_point now);
+
+        // Looks up the disk layer and keeps the response in memory, must be called from a worker thread.
+        // The disk layer doesn't store urls, the response gets the url of the request
+        [[nodiscard]] std::optional<CachedResponse> FindOnDisk(const std::string &key, const cpr::Url &url, Clock::time_point now, std::time_t date_now);
+
+        // Stores a 200 response unless the server forbids it. Responses that are never fresh are stored
+        // only if they can be revalidated
+        void Store(const std::string &key, const Response &response, Clock::time_point now, std::time_t date_now);
+
+        // Builds the response for a 304 from the cached one and updates the stored headers and freshness
+        Response Revalidate(const std::string &key, const CachedResponse &cached, const Response &not_modified, Clock::time_point now, std::time_t date_now);
+
+        void Clear();
+        [[nodiscard]] size_t GetSize() const;
+        [[nodiscard]] size_t GetCount() const;
+
+        // Reads Cache-Control (no-store, no-cache, max-age), Age, Expires and Date.
+        // Returns nullopt if the response must not be stored, zero if it must be revalidated before use
+        static std::optional<std::chrono::seconds> GetFreshnessLifetime(const cpr::Header &header, std::time_t date_now);
+
+    private:
+        void InsertLocked(const std::string &key, const Response &response, Clock::time_point expires_at);
+        void EraseLocked(std::list<Entry>::iterator it);
+        static CachedResponse MakeCachedResponse(const Entry &entry, Clock::time_point now);
+        void EvictLocked();
+    };
+}
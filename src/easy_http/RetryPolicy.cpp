@@ -0,0 +1,56 @@
+#include "RetryPolicy.h"
+
+#include <algorithm>
+
+#include "Response.h"
+
+using namespace ezhttp;
+
+namespace
+{
+    const long kDefaultRetryStatusCodes[] = {408, 429, 500, 502, 503, 504};
+
+    const cpr::ErrorCode kDefaultRetryErrorCodes[] = {
+        cpr::ErrorCode::CONNECTION_FAILURE,
+        cpr::ErrorCode::EMPTY_RESPONSE,
+        cpr::ErrorCode::HOST_RESOLUTION_FAILURE,
+        cpr::ErrorCode::NETWORK_RECEIVE_ERROR,
+        cpr::ErrorCode::NETWORK_SEND_FAILURE,
+        cpr::ErrorCode::OPERATION_TIMEDOUT,
+    };
+
+    template <class TContainer, class TValue>
+    bool Contains(const TContainer &container, const TValue &value)
+    {
+        return std::find(std::begin(container), std::end(container), value) != std::end(container);
+    }
+}
+
+bool ezhttp::IsRetryableResponse(const RetryPolicy &policy, const Response &response)
+{
+    if (response.error.code != cpr::ErrorCode::OK)
+    {
+        return policy.error_codes.empty()
+                   ? Contains(kDefaultRetryErrorCodes, response.error.code)
+                   : Contains(policy.error_codes, response.error.code);
+    }
+
+    return policy.status_codes.empty()
+               ? Contains(kDefaultRetryStatusCodes, response.status_code)
+               : Contains(policy.status_codes, response.status_code);
+}
+
+std::chrono::milliseconds ezhttp::GetRetryDelay(const RetryPolicy &policy, int failed_attempts, double random01)
+{
+    // base * 2^(failed_attempts - 1), computed in double to not overflow on big attempt counts
+    double delay = static_cast<double>(policy.backoff_base.count());
+    for (int i = 1; i < failed_attempts && delay < policy.backoff_cap.count(); ++i)
+        delay *= 2.0;
+
+    delay = std::min(delay, static_cast<double>(policy.backoff_cap.count()));
+
+    const double jitter = std::clamp(policy.jitter, 0.0, 1.0);
+    delay *= 1.0 - jitter * std::clamp(random01, 0.0, 1.0);
+
+    return std::chrono::milliseconds(static_cast<long long>(delay));
+}
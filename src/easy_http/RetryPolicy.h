@@ -0,0 +1,30 @@
+#pragma once
+#include <chrono>
+#include <vector>
+
+#include <cpr/cpr.h>
+
+namespace ezhttp
+{
+    struct Response;
+
+    // A failed attempt is repeated on the worker side with exponential backoff, the callback gets only the last response
+    struct RetryPolicy
+    {
+        static constexpr int kMaxAttempts = 10;
+
+        int max_attempts = 1; // including the first one
+        std::chrono::milliseconds backoff_base{500};
+        std::chrono::milliseconds backoff_cap{30000};
+        double jitter = 0.5; // share of the delay that is randomized, 0.0-1.0
+
+        // Empty lists mean the defaults: 408, 429, 500, 502, 503, 504 and connection, timeout and transfer errors
+        std::vector<long> status_codes;
+        std::vector<cpr::ErrorCode> error_codes;
+    };
+
+    bool IsRetryableResponse(const RetryPolicy &policy, const Response &response);
+
+    // Delay before the attempt that follows failed_attempts, random01 is a random value in [0, 1)
+    std::chrono::milliseconds GetRetryDelay(const RetryPolicy &policy, int failed_attempts, double random01);
+}
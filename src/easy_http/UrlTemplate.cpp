@@ -0,0 +1,169 @@
+#include "UrlTemplate.h"
+
+#include <cctype>
+
+#include "UrlUtils.h"
+
+using namespace ezhttp;
+
+namespace
+{
+    bool IsPlaceholderChar(char c)
+    {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+    }
+
+    // Position right after the authority, i.e. the start of the path, query or fragment
+    size_t FindAuthorityEnd(const std::string &pattern)
+    {
+        size_t start = pattern.find("://");
+        start = start == std::string::npos ? 0 : start + 3;
+
+        const size_t end = pattern.find_first_of("/?#", start);
+        return end == std::string::npos ? pattern.size() : end;
+    }
+}
+
+std::optional<UrlTemplate> UrlTemplate::Parse(const std::string &pattern, std::string &error)
+{
+    UrlTemplate url_template;
+    std::string literal;
+    size_t first_placeholder = std::string::npos;
+
+    for (size_t pos = 0; pos < pattern.size();)
+    {
+        const char c = pattern[pos];
+        if (c == '}')
+        {
+            error = "unexpected '}' at position " + std::to_string(pos);
+            return std::nullopt;
+        }
+
+        if (c != '{')
+        {
+            literal += c;
+            ++pos;
+            continue;
+        }
+
+        const size_t close = pattern.find('}', pos);
+        if (close == std::string::npos)
+        {
+            error = "unclosed '{' at position " + std::to_string(pos);
+            return std::nullopt;
+        }
+
+        std::string name = pattern.substr(pos + 1, close - pos - 1);
+        bool valid_name = !name.empty();
+        for (char name_char : name)
+            valid_name = valid_name && IsPlaceholderChar(name_char);
+
+        if (!valid_name)
+        {
+            error = "invalid placeholder name \"" + name + "\"";
+            return std::nullopt;
+        }
+
+        if (!literal.empty())
+        {
+            url_template.literal_size_ += literal.size();
+            url_template.segments_.push_back(Segment{std::move(literal), false});
+            literal.clear();
+        }
+
+        if (first_placeholder == std::string::npos)
+            first_placeholder = pos;
+
+        url_template.segments_.push_back(Segment{std::move(name), true});
+        pos = close + 1;
+    }
+
+    if (!literal.empty())
+    {
+        url_template.literal_size_ += literal.size();
+        url_template.segments_.push_back(Segment{std::move(literal), false});
+    }
+
+    const size_t authority_end = FindAuthorityEnd(pattern);
+    if (first_placeholder == std::string::npos || first_placeholder >= authority_end)
+    {
+        url_template.origin_ = UrlUtils::GetOriginByUrl(pattern.substr(0, authority_end), url_template.host_);
+        if (url_template.host_.empty())
+        {
+            error = "no host in \"" + pattern + "\"";
+            return std::nullopt;
+        }
+    }
+
+    return url_template;
+}
+
+std::optional<std::string> UrlTemplate::Expand(const Values &values, std::string &error) const
+{
+    for (const auto &value_kv : values)
+    {
+        if (!HasPlaceholder(value_kv.first))
+        {
+            error = "no placeholder {" + value_kv.first + "}";
+            return std::nullopt;
+        }
+    }
+
+    std::string url;
+    url.reserve(literal_size_ + values.size() * 16);
+
+    for (const auto &segment : segments_)
+    {
+        if (!segment.placeholder)
+        {
+            url += segment.text;
+            continue;
+        }
+
+        auto it = values.find(segment.text);
+        if (it == values.end())
+        {
+            error = "no value for placeholder {" + segment.text + "}";
+            return std::nullopt;
+        }
+
+        url += EncodeValue(it->second);
+    }
+
+    return url;
+}
+
+bool UrlTemplate::HasPlaceholder(const std::string &name) const
+{
+    for (const auto &segment : segments_)
+    {
+        if (segment.placeholder && segment.text == name)
+            return true;
+    }
+
+    return false;
+}
+
+std::string UrlTemplate::EncodeValue(const std::string &value)
+{
+    static const char kHexDigits[] = "0123456789ABCDEF";
+
+    std::string encoded;
+    encoded.reserve(value.size());
+
+    for (unsigned char c : value)
+    {
+        // unreserved characters of RFC 3986
+        if (std::isalnum(c) || c == '-' || c == '.' || c == '_' || c == '~')
+        {
+            encoded += static_cast<char>(c);
+            continue;
+        }
+
+        encoded += '%';
+        encoded += kHexDigits[c >> 4];
+        encoded += kHexDigits[c & 0x0F];
+    }
+
+    return encoded;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ezhttp
+{
+    // URL with {name} placeholders parsed once and filled for every request, e.g. https://example.com/players/{steamid}.
+    // The host and the origin are looked up at parse time unless a placeholder is a part of them
+    class UrlTemplate
+    {
+    public:
+        using Values = std::unordered_map<std::string, std::string>;
+
+    private:
+        struct Segment
+        {
+            std::string text; // the placeholder name for placeholders
+            bool placeholder = false;
+        };
+
+        std::vector<Segment> segments_;
+        size_t literal_size_ = 0;
+        std::string host_;
+        std::string origin_;
+
+    public:
+        // Placeholder names consist of letters, digits and underscores. Returns nullopt and sets error for a malformed pattern
+        static std::optional<UrlTemplate> Parse(const std::string &pattern, std::string &error);
+
+        // Values are percent-encoded. Every placeholder must have a value and every value a placeholder,
+        // otherwise returns nullopt and sets error
+        [[nodiscard]] std::optional<std::string> Expand(const Values &values, std::string &error) const;
+
+        // Both are empty if the host depends on the values
+        [[nodiscard]] const std::string &GetHost() const { return host_; }
+        [[nodiscard]] const std::string &GetOrigin() const { return origin_; }
+        [[nodiscard]] bool HasPlaceholder(const std::string &name) const;
+
+        static std::string EncodeValue(const std::string &value);
+    };
+}
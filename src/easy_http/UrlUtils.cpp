@@ -11,15 +11,50 @@ namespace ezhttp
         CURLUcode rc;
         char* host = nullptr;
 
-        rc = curl_url_set(curl_url_, CURLUPART_URL, url.c_str(), 0);
-        if (rc != CURLUE_OK)
+        if (!SetUrl(url))
             return "";
 
         rc = curl_url_get(curl_url_, CURLUPART_HOST, &host, 0);
         if (rc != CURLUE_OK)
             return "";
 
-        return { host };
+        std::string result(host);
+        curl_free(host);
+        return result;
+    }
+
+    std::string UrlUtils::GetOriginByUrl(const std::string& url, std::string& host)
+    {
+        InitializeIfNeeded();
+        host.clear();
+
+        if (!SetUrl(url))
+            return "";
+
+        char* scheme = nullptr;
+        char* host_part = nullptr;
+        char* port = nullptr;
+        std::string result;
+
+        if (curl_url_get(curl_url_, CURLUPART_SCHEME, &scheme, 0) == CURLUE_OK &&
+            curl_url_get(curl_url_, CURLUPART_HOST, &host_part, 0) == CURLUE_OK &&
+            curl_url_get(curl_url_, CURLUPART_PORT, &port, CURLU_DEFAULT_PORT) == CURLUE_OK)
+        {
+            host = host_part;
+            result.append(scheme).append("://").append(host_part).append(":").append(port);
+        }
+
+        curl_free(scheme);
+        curl_free(host_part);
+        curl_free(port);
+        return result;
+    }
+
+    bool UrlUtils::SetUrl(const std::string& url)
+    {
+        // the handle is reused, and a url without a scheme would be resolved relative to the previous one
+        curl_url_set(curl_url_, CURLUPART_URL, nullptr, 0);
+        return curl_url_set(curl_url_, CURLUPART_URL, url.c_str(), 0) == CURLUE_OK;
     }
 
     void UrlUtils::InitializeIfNeeded()
@@ -13,7 +13,12 @@ namespace ezhttp
         // Returns the host part of the url. If host cannot be obtained, returns an empty string.
         static std::string GetHostByUrl(const std::string& url);
 
+        // Returns scheme://host:port with the default port of the scheme if the url has none, and sets host.
+        // Both are empty if the url cannot be parsed
+        static std::string GetOriginByUrl(const std::string& url, std::string& host);
+
     private:
         static void InitializeIfNeeded();
+        static bool SetUrl(const std::string& url);
     };
 }
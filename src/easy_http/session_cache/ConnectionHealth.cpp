@@ -0,0 +1,40 @@
+#include "ConnectionHealth.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <sys/socket.h>
+#endif
+
+namespace ezhttp
+{
+    ConnectionState ProbeConnection(CURL *curl)
+    {
+        if (!curl)
+            return ConnectionState::None;
+
+        curl_socket_t socket = CURL_SOCKET_BAD;
+        if (curl_easy_getinfo(curl, CURLINFO_ACTIVESOCKET, &socket) != CURLE_OK || socket == CURL_SOCKET_BAD)
+            return ConnectionState::None;
+
+        // curl keeps its sockets non-blocking, so this returns at once
+        char byte;
+        const auto received = recv(socket, &byte, 1, MSG_PEEK);
+        if (received > 0)
+            return ConnectionState::Alive;
+
+        if (received == 0)
+            return ConnectionState::Closed;
+
+#ifdef _WIN32
+        return WSAGetLastError() == WSAEWOULDBLOCK ? ConnectionState::Alive : ConnectionState::Closed;
+#else
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? ConnectionState::Alive : ConnectionState::Closed;
+#endif
+    }
+
+    void KeepConnectionAlive(CURL *curl)
+    {
+        if (curl)
+            curl_easy_upkeep(curl);
+    }
+}
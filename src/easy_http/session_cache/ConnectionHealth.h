@@ -0,0 +1,18 @@
+#pragma once
+#include <curl/curl.h>
+
+namespace ezhttp
+{
+    enum class ConnectionState
+    {
+        None,   // the handle has no connection to check, curl connects on the next transfer
+        Alive,  // open, or has data curl will deal with itself, e.g. a TLS session ticket
+        Closed, // closed or reset by the server, reusing it would only make curl reconnect
+    };
+
+    // Peeks at the socket of the last connection of an idle handle without blocking and without consuming data
+    ConnectionState ProbeConnection(CURL *curl);
+
+    // Lets curl do its connection upkeep, e.g. an HTTP/2 PING once CURLOPT_UPKEEP_INTERVAL_MS has passed
+    void KeepConnectionAlive(CURL *curl);
+}
@@ -1,53 +1,107 @@
 #include "CprSessionCache.h"
 
+#include <algorithm>
+#include <iterator>
 #include <utility>
 
-#include "../UrlUtils.h"
-
 using namespace std::chrono_literals;
 
 namespace ezhttp
 {
-    CprSessionCache::CprSessionCache(std::shared_ptr<CprSessionFactoryInterface> session_factory, std::shared_ptr<DateTimeServiceInterface> date_time_service, std::chrono::seconds maxage_conn, uint32_t max_sessions_per_host) :
+    CprSessionCache::CprSessionCache(std::shared_ptr<CprSessionFactoryInterface> session_factory, std::shared_ptr<DateTimeServiceInterface> date_time_service, std::chrono::seconds maxage_conn, uint32_t max_sessions_per_host,
+                                     uint32_t max_pooled_sessions, std::shared_ptr<OriginRegistry> origins, std::shared_ptr<SessionReaper> reaper) :
         session_factory_(std::move(session_factory)),
         date_time_service_(std::move(date_time_service)),
         maxage_conn_(maxage_conn),
-        max_sessions_per_host_(max_sessions_per_host)
+        max_sessions_per_host_(max_sessions_per_host),
+        max_pooled_sessions_(max_pooled_sessions),
+        origins_(origins ? std::move(origins) : std::make_shared<OriginRegistry>()),
+        reaper_(std::move(reaper))
     {
+        if (reaper_)
+            reaper_->Register(this);
     }
 
-    std::unique_ptr<cpr::Session> CprSessionCache::GetSession(const std::string& url)
+    CprSessionCache::~CprSessionCache()
     {
-        std::lock_guard lock(mutex_);
+        if (reaper_)
+        {
+            reaper_->Unregister(this);
+            reaper_->RemovePooled(pooled_count_.load());
+        }
+    }
 
+    std::unique_ptr<cpr::Session> CprSessionCache::GetSession(const std::string& url)
+    {
         if (max_sessions_per_host_ == 0)
-            return CreateSession(url);
+            return GetSessionForOrigin(url, 0);
 
-        std::string host = UrlUtils::GetHostByUrl(url);
-        auto current_time = date_time_service_->GetNow();
+        // parsed before the lock is taken
+        return GetSessionForOrigin(url, origins_->InternUrl(url));
+    }
 
-        if (host.empty())
-            return nullptr;
+    std::unique_ptr<cpr::Session> CprSessionCache::GetSessionForOrigin(const std::string& url, OriginId origin, std::optional<SessionSettings>* settings)
+    {
+        // a new handle has nothing applied
+        if (settings)
+            *settings = SessionSettings{};
 
-        auto curl_cache_it = cache_.find(host);
-        if (curl_cache_it == cache_.end())
+        if (max_sessions_per_host_ == 0 || origin == kUnpooledOrigin)
             return CreateSession(url);
 
-        auto& cache_items = curl_cache_it->second;
+        if (origin == 0)
+            return nullptr;
 
-        if (cache_items.empty())
-            return CreateSession(url);
+        auto current_time = date_time_service_->GetNow();
+        std::shared_ptr<cpr::CurlHolder> curl_holder;
+        std::vector<CurlHolderCacheItem> closed; // released after the lock
+        Shard& shard = GetShard(origin);
 
-        // The newest session is stored at the end of the vector, if it is expired, all previous sessions are also expired
-        if (IsSessionCacheExpired(cache_items.back(), current_time))
+        while (!curl_holder)
         {
-            cache_items.clear();
-            return CreateSession(url);
-        }
+            std::optional<CurlHolderCacheItem> cache_item;
+            {
+                std::lock_guard lock(shard.mutex);
 
-        auto curl_holder = cache_items.back().get_curl_holder();
-        cache_items.pop_back();
+                auto curl_cache_it = shard.cache.find(origin);
+                if (curl_cache_it != shard.cache.end() && !curl_cache_it->second.get_cache().empty())
+                {
+                    curl_cache_it->second.set_last_access(current_time);
+                    auto& cache_items = curl_cache_it->second.get_cache();
+
+                    // The newest session is stored at the end of the vector, if it is expired, all previous sessions are also expired
+                    if (IsSessionCacheExpired(cache_items.back(), current_time))
+                    {
+                        RemovePooled(cache_items.size());
+                        std::move(cache_items.begin(), cache_items.end(), std::back_inserter(closed));
+                        cache_items.clear();
+                    }
+                    else
+                    {
+                        cache_item = std::move(cache_items.back());
+                        cache_items.pop_back();
+                        RemovePooled(1);
+                    }
+                }
+            }
+
+            if (!cache_item)
+                break;
+
+            // probed after the lock, so other workers of the shard don't wait for the syscall. A handle whose
+            // connection the server has closed would only reconnect, it is dropped and the next one is tried
+            if (IsConnectionClosed(*cache_item))
+            {
+                closed.push_back(std::move(*cache_item));
+                continue;
+            }
+
+            curl_holder = cache_item->get_curl_holder();
+            if (settings)
+                *settings = cache_item->get_settings();
+        }
 
+        // the session is created outside of the lock
         return CreateSession(url, curl_holder);
     }
 
@@ -58,29 +112,137 @@ namespace ezhttp
 
     void CprSessionCache::ReturnSession(const std::string& url, std::shared_ptr<cpr::CurlHolder> curl_holder)
     {
-        std::lock_guard lock(mutex_);
+        if (max_sessions_per_host_ == 0)
+            return;
+
+        ReturnSessionToOrigin(origins_->InternUrl(url), std::move(curl_holder));
+    }
 
+    void CprSessionCache::ReturnSessionToOrigin(OriginId origin, std::shared_ptr<cpr::CurlHolder> curl_holder, std::optional<SessionSettings> settings)
+    {
         if (max_sessions_per_host_ == 0)
             return;
 
-        std::string host = UrlUtils::GetHostByUrl(url);
+        if (origin == 0 || origin == kUnpooledOrigin)
+            return;
+
         auto current_time = date_time_service_->GetNow();
 
-        if (host.empty())
-            return;
+        {
+            Shard& shard = GetShard(origin);
+            std::lock_guard lock(shard.mutex);
+
+            auto curl_cache_it = shard.cache.try_emplace(origin, current_time).first;
+            curl_cache_it->second.set_last_access(current_time);
+            auto& cache_items = curl_cache_it->second.get_cache();
+
+            const size_t size_before = cache_items.size();
+            FreeSpaceForSession(cache_items, current_time);
+            cache_items.emplace_back(std::move(curl_holder), current_time, std::move(settings));
 
-        auto curl_cache_it = cache_.find(host);
-        if (curl_cache_it == cache_.end())
+            AddPooled(cache_items.size());
+            RemovePooled(size_before);
+        }
+
+        // the caps are checked without the lock, they take the locks of the other shards
+        if (max_pooled_sessions_ > 0 && pooled_count_.load() > max_pooled_sessions_)
+            EvictLeastRecentlyUsed();
+
+        if (reaper_)
+            reaper_->EnforcePooledLimit();
+    }
+
+    size_t CprSessionCache::EvictIdle()
+    {
+        const auto current_time = date_time_service_->GetNow();
+        size_t evicted_count = 0;
+
+        for (auto& shard : shards_)
         {
-            cache_.emplace(host, std::vector{ CurlHolderCacheItem(curl_holder, current_time) });
-            return;
+            std::vector<CurlHolderCacheItem> evicted; // closed after the lock is released
+            std::vector<std::pair<OriginId, CurlHolderCacheItem>> checked; // out of the pool while they are probed
+            {
+                std::lock_guard lock(shard.mutex);
+                for (auto& [origin, host_cache_item] : shard.cache)
+                {
+                    auto& cache_items = host_cache_item.get_cache();
+                    auto first_non_expired_it = FindFirstNonExpired(cache_items, current_time);
+                    std::move(cache_items.begin(), first_non_expired_it, std::back_inserter(evicted));
+                    cache_items.erase(cache_items.begin(), first_non_expired_it);
+
+                    for (auto& cache_item : cache_items)
+                        checked.emplace_back(origin, std::move(cache_item));
+
+                    cache_items.clear();
+                }
+            }
+
+            // connections closed by the server are recycled here rather than on the request path, the live ones
+            // get their upkeep. Both are done without the lock, workers just don't find these handles meanwhile
+            std::vector<std::pair<OriginId, CurlHolderCacheItem>> alive;
+            for (auto& [origin, cache_item] : checked)
+            {
+                if (IsConnectionClosed(cache_item))
+                {
+                    evicted.push_back(std::move(cache_item));
+                }
+                else
+                {
+                    KeepConnectionAlive(cache_item.get_curl_holder()->handle);
+                    alive.emplace_back(origin, std::move(cache_item));
+                }
+            }
+
+            {
+                std::lock_guard lock(shard.mutex);
+                for (auto& [origin, cache_item] : alive)
+                {
+                    // handles returned meanwhile are newer, the pool stays ordered by the last use
+                    auto& cache_items = shard.cache.try_emplace(origin, current_time).first->second.get_cache();
+                    auto position = std::upper_bound(cache_items.begin(), cache_items.end(), cache_item.get_last_use(),
+                                                     [](std::chrono::system_clock::time_point last_use, const CurlHolderCacheItem& other)
+                                                     {
+                                                         return last_use < other.get_last_use();
+                                                     });
+                    cache_items.insert(position, std::move(cache_item));
+                }
+
+                for (auto it = shard.cache.begin(); it != shard.cache.end();)
+                {
+                    // the pool may have filled up while its handles were probed
+                    auto& cache_items = it->second.get_cache();
+                    if (cache_items.size() > max_sessions_per_host_)
+                    {
+                        const auto excess_end = cache_items.begin() + (cache_items.size() - max_sessions_per_host_);
+                        std::move(cache_items.begin(), excess_end, std::back_inserter(evicted));
+                        cache_items.erase(cache_items.begin(), excess_end);
+                    }
+
+                    // a host without handles that hasn't been used for a while is unlikely to be used again
+                    if (cache_items.empty() && it->second.get_last_access() + maxage_conn_ <= current_time)
+                        it = shard.cache.erase(it);
+                    else
+                        ++it;
+                }
+            }
+
+            RemovePooled(evicted.size());
+            evicted_count += evicted.size();
         }
 
-        auto& cache_items = curl_cache_it->second;
+        return evicted_count;
+    }
 
-        FreeSpaceForSession(cache_items, current_time);
+    size_t CprSessionCache::GetHostCount()
+    {
+        size_t count = 0;
+        for (auto& shard : shards_)
+        {
+            std::lock_guard lock(shard.mutex);
+            count += shard.cache.size();
+        }
 
-        cache_items.emplace_back(curl_holder, current_time);
+        return count;
     }
 
     std::unique_ptr<cpr::Session> CprSessionCache::CreateSession(const std::string& url, std::shared_ptr<cpr::CurlHolder> curl_holder)
@@ -96,11 +258,7 @@ namespace ezhttp
         if (cache_items.size() < max_sessions_per_host_)
             return;
 
-        auto first_non_expired_it = std::lower_bound(cache_items.begin(), cache_items.end(), current_time,
-                                                     [this](const CurlHolderCacheItem& cache_item, std::chrono::system_clock::time_point time)
-                                                     {
-                                                         return IsSessionCacheExpired(cache_item, time);
-                                                     });
+        auto first_non_expired_it = FindFirstNonExpired(cache_items, current_time);
 
         if (first_non_expired_it != cache_items.begin())
         {
@@ -113,6 +271,79 @@ namespace ezhttp
         }
     }
 
+    std::optional<CprSessionCache::LeastRecentlyUsed> CprSessionCache::FindLeastRecentlyUsed()
+    {
+        // the oldest handle of a host is at the front of its vector
+        std::optional<LeastRecentlyUsed> oldest;
+
+        for (auto& shard : shards_)
+        {
+            std::lock_guard lock(shard.mutex);
+            for (auto& [origin, host_cache_item] : shard.cache)
+            {
+                const auto& cache_items = host_cache_item.get_cache();
+                if (!cache_items.empty() && (!oldest || cache_items.front().get_last_use() < oldest->last_use))
+                    oldest = LeastRecentlyUsed{origin, cache_items.front().get_last_use()};
+            }
+        }
+
+        return oldest;
+    }
+
+    void CprSessionCache::EvictOldestOfOrigin(OriginId origin)
+    {
+        std::shared_ptr<cpr::CurlHolder> evicted; // closed after the lock is released
+        {
+            Shard& shard = GetShard(origin);
+            std::lock_guard lock(shard.mutex);
+
+            // another thread may have taken the handle meanwhile
+            auto curl_cache_it = shard.cache.find(origin);
+            if (curl_cache_it == shard.cache.end() || curl_cache_it->second.get_cache().empty())
+                return;
+
+            auto& cache_items = curl_cache_it->second.get_cache();
+            evicted = cache_items.front().get_curl_holder();
+            cache_items.erase(cache_items.begin());
+            RemovePooled(1);
+        }
+    }
+
+    void CprSessionCache::EvictLeastRecentlyUsed()
+    {
+        if (auto oldest = FindLeastRecentlyUsed())
+            EvictOldestOfOrigin(oldest->origin);
+    }
+
+    void CprSessionCache::AddPooled(size_t count)
+    {
+        pooled_count_ += count;
+        if (reaper_)
+            reaper_->AddPooled(count);
+    }
+
+    void CprSessionCache::RemovePooled(size_t count)
+    {
+        pooled_count_ -= count;
+        if (reaper_)
+            reaper_->RemovePooled(count);
+    }
+
+    std::vector<CurlHolderCacheItem>::iterator CprSessionCache::FindFirstNonExpired(std::vector<CurlHolderCacheItem>& cache_items, std::chrono::system_clock::time_point current_time)
+    {
+        // items are ordered by the last use
+        return std::lower_bound(cache_items.begin(), cache_items.end(), current_time,
+                                [this](const CurlHolderCacheItem& cache_item, std::chrono::system_clock::time_point time)
+                                {
+                                    return IsSessionCacheExpired(cache_item, time);
+                                });
+    }
+
+    bool CprSessionCache::IsConnectionClosed(const CurlHolderCacheItem& cache_item)
+    {
+        return ProbeConnection(cache_item.get_curl_holder()->handle) == ConnectionState::Closed;
+    }
+
     bool CprSessionCache::IsSessionCacheExpired(const CurlHolderCacheItem& cache_item, std::chrono::system_clock::time_point current_time)
     {
         return cache_item.get_last_use() + maxage_conn_ <= current_time;
@@ -1,15 +1,23 @@
 #pragma once
+#include <array>
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <chrono>
+#include <optional>
 
 #include <cpr/session.h>
 
 #include "../session_factory/CprSessionFactoryInterface.h"
 #include "../datetime_service/DateTimeServiceInterface.h"
 
+#include "ConnectionHealth.h"
 #include "CurlHolderCacheItem.h"
 #include "HostCacheItem.h"
+#include "OriginRegistry.h"
+#include "SessionReaper.h"
+#include "SessionSettings.h"
 
 namespace ezhttp
 {
@@ -19,21 +27,75 @@ namespace ezhttp
         std::shared_ptr<DateTimeServiceInterface> date_time_service_;
         std::chrono::seconds maxage_conn_;
         uint32_t max_sessions_per_host_;
+        uint32_t max_pooled_sessions_; // across all hosts, 0 means no limit, the reaper has its own cap across caches
+        std::shared_ptr<OriginRegistry> origins_;
+        std::shared_ptr<SessionReaper> reaper_;
+        std::atomic<size_t> pooled_count_{0};
 
-        std::unordered_map<std::string, std::vector<CurlHolderCacheItem>> cache_{};
+        static constexpr size_t kShardCount = 16;
 
-        std::mutex mutex_;
+        // Pools are split into shards by origin, each with its own lock, so workers requesting different hosts
+        // don't wait for each other. Origin ids are sequential, so consecutive origins land in different shards
+        struct alignas(64) Shard
+        {
+            std::mutex mutex;
+            // keyed by origin, so http and https to the same host have separate pools
+            std::unordered_map<OriginId, HostCacheItem> cache{};
+        };
+
+        std::array<Shard, kShardCount> shards_;
 
     public:
-        CprSessionCache(std::shared_ptr<CprSessionFactoryInterface> session_factory, std::shared_ptr<DateTimeServiceInterface> date_time_service, std::chrono::seconds maxage_conn, uint32_t max_sessions_per_host);
+        // Creates its own registry if origins is null. With a reaper idle handles are evicted in the background,
+        // otherwise only when their host is used again
+        CprSessionCache(std::shared_ptr<CprSessionFactoryInterface> session_factory, std::shared_ptr<DateTimeServiceInterface> date_time_service, std::chrono::seconds maxage_conn, uint32_t max_sessions_per_host,
+                        uint32_t max_pooled_sessions = 0, std::shared_ptr<OriginRegistry> origins = nullptr, std::shared_ptr<SessionReaper> reaper = nullptr);
+        ~CprSessionCache();
+
+        CprSessionCache(const CprSessionCache& other) = delete;
+        CprSessionCache& operator=(const CprSessionCache& other) = delete;
 
         std::unique_ptr<cpr::Session> GetSession(const std::string& url);
         void ReturnSession(cpr::Session& session);
         void ReturnSession(const std::string& url, std::shared_ptr<cpr::CurlHolder> curl_holder);
 
+        // Same as above for callers that have interned the origin of the url in the registry of the cache,
+        // so the url isn't parsed again and nothing but the pool lookup is done under the lock.
+        // settings receives the options applied to the handle: the defaults for a new one, nullopt if unknown,
+        // and the caller returns the handle with the options it has applied since
+        std::unique_ptr<cpr::Session> GetSessionForOrigin(const std::string& url, OriginId origin, std::optional<SessionSettings>* settings = nullptr);
+        void ReturnSessionToOrigin(OriginId origin, std::shared_ptr<cpr::CurlHolder> curl_holder, std::optional<SessionSettings> settings = std::nullopt);
+
+        [[nodiscard]] OriginRegistry& GetOrigins() { return *origins_; }
+
+        // Closes the handles unused for maxage_conn_ or whose connection the server has closed, and forgets
+        // the hosts left without handles. The other handles get curl's upkeep. Returns the number of closed handles
+        size_t EvictIdle();
+
+        [[nodiscard]] size_t GetPooledCount() const { return pooled_count_.load(); }
+        [[nodiscard]] size_t GetHostCount();
+
+        struct LeastRecentlyUsed
+        {
+            OriginId origin;
+            std::chrono::system_clock::time_point last_use;
+        };
+
+        // The origin whose oldest idle handle was used the longest ago, nullopt if there are no idle handles
+        std::optional<LeastRecentlyUsed> FindLeastRecentlyUsed();
+
+        // Closes the oldest idle handle of the origin, unless another thread has taken it meanwhile
+        void EvictOldestOfOrigin(OriginId origin);
+
     private:
+        Shard& GetShard(OriginId origin) { return shards_[origin % kShardCount]; }
         std::unique_ptr<cpr::Session> CreateSession(const std::string& url, std::shared_ptr<cpr::CurlHolder> curl_holder = nullptr);
         void FreeSpaceForSession(std::vector<CurlHolderCacheItem>& cache_items, std::chrono::system_clock::time_point current_time);
+        void EvictLeastRecentlyUsed();
+        void AddPooled(size_t count);
+        void RemovePooled(size_t count);
+        std::vector<CurlHolderCacheItem>::iterator FindFirstNonExpired(std::vector<CurlHolderCacheItem>& cache_items, std::chrono::system_clock::time_point current_time);
+        static bool IsConnectionClosed(const CurlHolderCacheItem& cache_item);
         bool IsSessionCacheExpired(const CurlHolderCacheItem& cache_item, std::chrono::system_clock::time_point current_time);
     };
 }
@@ -4,9 +4,10 @@
 
 namespace ezhttp
 {
-    CurlHolderCacheItem::CurlHolderCacheItem(std::shared_ptr<cpr::CurlHolder> curl_holder, std::chrono::system_clock::time_point last_use) :
+    CurlHolderCacheItem::CurlHolderCacheItem(std::shared_ptr<cpr::CurlHolder> curl_holder, std::chrono::system_clock::time_point last_use, std::optional<SessionSettings> settings) :
         curl_holder_(std::move(curl_holder)),
-        last_use_(last_use)
+        last_use_(last_use),
+        settings_(std::move(settings))
     {
     }
 
@@ -19,4 +20,9 @@ namespace ezhttp
     {
         return last_use_;
     }
-}
\ No newline at end of file
+
+    const std::optional<SessionSettings>& CurlHolderCacheItem::get_settings() const
+    {
+        return settings_;
+    }
+}
@@ -1,20 +1,25 @@
 #pragma once
 #include <chrono>
 #include <memory>
+#include <optional>
 
 #include <cpr/session.h>
 
+#include "SessionSettings.h"
+
 namespace ezhttp
 {
     class CurlHolderCacheItem
     {
         std::shared_ptr<cpr::CurlHolder> curl_holder_;
         std::chrono::system_clock::time_point last_use_;
+        std::optional<SessionSettings> settings_;
 
     public:
-        CurlHolderCacheItem(std::shared_ptr<cpr::CurlHolder> curl_holder, std::chrono::system_clock::time_point last_use);
+        CurlHolderCacheItem(std::shared_ptr<cpr::CurlHolder> curl_holder, std::chrono::system_clock::time_point last_use, std::optional<SessionSettings> settings = std::nullopt);
 
         std::shared_ptr<cpr::CurlHolder> get_curl_holder() const;
         std::chrono::system_clock::time_point get_last_use() const;
+        const std::optional<SessionSettings>& get_settings() const;
     };
 }
\ No newline at end of file
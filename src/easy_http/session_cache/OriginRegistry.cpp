@@ -0,0 +1,59 @@
+#include "OriginRegistry.h"
+
+#include <mutex>
+
+#include "../UrlUtils.h"
+
+namespace ezhttp
+{
+    OriginRegistry::OriginRegistry(size_t max_origins) : max_origins_(max_origins)
+    {
+    }
+
+    OriginId OriginRegistry::Intern(const std::string& origin)
+    {
+        if (origin.empty())
+            return 0;
+
+        {
+            std::shared_lock lock(mutex_);
+            auto it = ids_.find(origin);
+            if (it != ids_.end())
+                return it->second;
+        }
+
+        std::unique_lock lock(mutex_);
+        if (max_origins_ > 0 && ids_.size() >= max_origins_)
+        {
+            auto it = ids_.find(origin);
+            return it != ids_.end() ? it->second : kUnpooledOrigin;
+        }
+
+        auto [it, inserted] = ids_.emplace(origin, static_cast<OriginId>(ids_.size() + 1));
+        if (inserted)
+            origins_.push_back(origin);
+
+        return it->second;
+    }
+
+    OriginId OriginRegistry::InternUrl(const std::string& url)
+    {
+        std::string host;
+        return Intern(UrlUtils::GetOriginByUrl(url, host));
+    }
+
+    std::string OriginRegistry::GetOrigin(OriginId id) const
+    {
+        std::shared_lock lock(mutex_);
+        if (id == 0 || id > origins_.size())
+            return std::string();
+
+        return origins_[id - 1];
+    }
+
+    size_t OriginRegistry::GetCount() const
+    {
+        std::shared_lock lock(mutex_);
+        return ids_.size();
+    }
+}
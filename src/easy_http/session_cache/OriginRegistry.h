@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ezhttp
+{
+    // Small id of an origin (scheme://host:port), so connection pools are looked up by an integer instead
+    // of parsing and hashing the url under their lock. 0 is not a valid origin
+    using OriginId = uint32_t;
+
+    // Given to every origin past the limit of the registry. Its sessions are not pooled
+    constexpr OriginId kUnpooledOrigin = std::numeric_limits<OriginId>::max();
+
+    // Origins interned once at dispatch. Ids are never released, since a pending request or a pooled handle
+    // may still hold one, and urls come from plugins, so the count is capped: past max_origins every new
+    // origin gets kUnpooledOrigin. Thread-safe, shared by all EasyHttps of the module, so an id parsed by
+    // one queue is valid for all
+    class OriginRegistry
+    {
+        const size_t max_origins_;
+
+        mutable std::shared_mutex mutex_;
+        std::unordered_map<std::string, OriginId> ids_;
+        std::vector<std::string> origins_; // indexed by id - 1
+
+    public:
+        // 0 = no limit
+        explicit OriginRegistry(size_t max_origins = 0);
+
+        // Returns 0 for an empty origin, kUnpooledOrigin for a new one when the registry is full
+        OriginId Intern(const std::string &origin);
+
+        // Parses the url, returns 0 if it has no host
+        OriginId InternUrl(const std::string &url);
+
+        // Returns an empty string for an unknown id and for kUnpooledOrigin
+        [[nodiscard]] std::string GetOrigin(OriginId id) const;
+
+        [[nodiscard]] size_t GetCount() const;
+    };
+}
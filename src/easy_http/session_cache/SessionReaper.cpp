@@ -0,0 +1,153 @@
+#include "SessionReaper.h"
+
+#include <algorithm>
+
+#include "CprSessionCache.h"
+#include "utils/TraceLog.h"
+
+namespace ezhttp
+{
+    SessionReaper::SessionReaper(std::chrono::milliseconds interval, size_t max_pooled_sessions) : interval_(interval),
+                                                                                                    max_pooled_sessions_(max_pooled_sessions)
+    {
+        thread_ = std::thread(&SessionReaper::ThreadLoop, this);
+    }
+
+    SessionReaper::~SessionReaper()
+    {
+        {
+            std::lock_guard lock(mutex_);
+            stop_requested_ = true;
+        }
+
+        stop_cv_.notify_all();
+        thread_.join();
+    }
+
+    void SessionReaper::Register(CprSessionCache* cache)
+    {
+        std::lock_guard lock(mutex_);
+        caches_.push_back(RegisteredCache{cache});
+    }
+
+    void SessionReaper::Unregister(CprSessionCache* cache)
+    {
+        std::unique_lock lock(mutex_);
+        auto it = FindLocked(cache);
+        if (it == caches_.end())
+            return;
+
+        // new sweeps skip the cache, the running ones finish with it before it is destroyed
+        it->unregistering = true;
+        cache_idle_cv_.wait(lock, [this, cache]() { return FindLocked(cache)->users == 0; });
+        caches_.erase(FindLocked(cache));
+    }
+
+    size_t SessionReaper::ReapNow()
+    {
+        return Reap();
+    }
+
+    void SessionReaper::EnforcePooledLimit()
+    {
+        while (max_pooled_sessions_ > 0 && pooled_count_.load() > max_pooled_sessions_)
+        {
+            CprSessionCache* oldest_cache = nullptr;
+            std::optional<CprSessionCache::LeastRecentlyUsed> oldest;
+            for (CprSessionCache* cache : GetCaches())
+            {
+                if (!Pin(cache))
+                    continue;
+
+                auto least_recently_used = cache->FindLeastRecentlyUsed();
+                Unpin(cache);
+
+                if (least_recently_used && (!oldest || least_recently_used->last_use < oldest->last_use))
+                {
+                    oldest_cache = cache;
+                    oldest = least_recently_used;
+                }
+            }
+
+            // the cache may have been unregistered since, the next round looks again
+            if (!oldest_cache)
+                return;
+
+            if (Pin(oldest_cache))
+            {
+                oldest_cache->EvictOldestOfOrigin(oldest->origin);
+                Unpin(oldest_cache);
+            }
+        }
+    }
+
+    void SessionReaper::ThreadLoop()
+    {
+        std::unique_lock lock(mutex_);
+        while (!stop_cv_.wait_for(lock, interval_, [this] { return stop_requested_; }))
+        {
+            lock.unlock();
+            const size_t evicted = Reap();
+            lock.lock();
+
+            if (evicted > 0)
+                ezhttp::trace::Writef("SessionReaper", "ThreadLoop evicted=%zu caches=%zu", evicted, caches_.size());
+        }
+    }
+
+    size_t SessionReaper::Reap()
+    {
+        std::lock_guard sweep_lock(sweep_mutex_);
+
+        size_t evicted = 0;
+        for (CprSessionCache* cache : GetCaches())
+        {
+            if (!Pin(cache))
+                continue;
+
+            evicted += cache->EvictIdle();
+            Unpin(cache);
+        }
+
+        return evicted;
+    }
+
+    std::vector<CprSessionCache*> SessionReaper::GetCaches()
+    {
+        std::lock_guard lock(mutex_);
+
+        std::vector<CprSessionCache*> caches;
+        caches.reserve(caches_.size());
+        for (const auto& registered : caches_)
+            caches.push_back(registered.cache);
+
+        return caches;
+    }
+
+    std::vector<SessionReaper::RegisteredCache>::iterator SessionReaper::FindLocked(CprSessionCache* cache)
+    {
+        return std::find_if(caches_.begin(), caches_.end(), [cache](const RegisteredCache& registered) { return registered.cache == cache; });
+    }
+
+    bool SessionReaper::Pin(CprSessionCache* cache)
+    {
+        std::lock_guard lock(mutex_);
+        auto it = FindLocked(cache);
+        if (it == caches_.end() || it->unregistering)
+            return false;
+
+        ++it->users;
+        return true;
+    }
+
+    void SessionReaper::Unpin(CprSessionCache* cache)
+    {
+        {
+            std::lock_guard lock(mutex_);
+            auto it = FindLocked(cache);
+            --it->users;
+        }
+
+        cache_idle_cv_.notify_all();
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ezhttp
+{
+    class CprSessionCache;
+
+    // One background thread for the module that periodically evicts idle handles from every registered
+    // CprSessionCache, so a host contacted once doesn't keep its socket and pool entry until it is used again.
+    // It also caps the idle handles of all the caches together, so the sockets the module keeps open are
+    // bounded however many queues there are
+    class SessionReaper
+    {
+        struct RegisteredCache
+        {
+            CprSessionCache *cache;
+            int users = 0; // sweeps and evictions running on the cache, they work without mutex_
+            bool unregistering = false;
+        };
+
+        // Guards the registrations and the stop flag only, so workers returning handles and Unregister()
+        // don't wait for a sweep of the other caches
+        std::mutex mutex_;
+        std::condition_variable stop_cv_;
+        std::condition_variable cache_idle_cv_;
+        std::vector<RegisteredCache> caches_;
+
+        std::mutex sweep_mutex_; // one sweep at a time, taken only by the sweeps
+        std::chrono::milliseconds interval_;
+        size_t max_pooled_sessions_; // 0 means no limit
+        std::atomic<size_t> pooled_count_{0}; // kept up to date by the caches
+        bool stop_requested_{false};
+        std::thread thread_;
+
+    public:
+        explicit SessionReaper(std::chrono::milliseconds interval, size_t max_pooled_sessions = 0);
+        ~SessionReaper();
+
+        SessionReaper(const SessionReaper &) = delete;
+        SessionReaper &operator=(const SessionReaper &) = delete;
+
+        void Register(CprSessionCache *cache);
+
+        // Waits for a sweep or an eviction that is running on this cache, not for the other caches
+        void Unregister(CprSessionCache *cache);
+
+        // Sweeps every cache on the calling thread, returns the number of closed handles
+        size_t ReapNow();
+
+        void AddPooled(size_t count) { pooled_count_ += count; }
+        void RemovePooled(size_t count) { pooled_count_ -= count; }
+        [[nodiscard]] size_t GetPooledCount() const { return pooled_count_.load(); }
+
+        // Closes the least recently used idle handle of all the caches while they hold more than the cap.
+        // Workers returning handles at the same time may close one handle more than needed
+        void EnforcePooledLimit();
+
+    private:
+        void ThreadLoop();
+        size_t Reap();
+
+        // A pinned cache stays registered until it is unpinned, the registration lock is not held meanwhile
+        std::vector<CprSessionCache *> GetCaches();
+        bool Pin(CprSessionCache *cache);
+        void Unpin(CprSessionCache *cache);
+        std::vector<RegisteredCache>::iterator FindLocked(CprSessionCache *cache);
+    };
+}
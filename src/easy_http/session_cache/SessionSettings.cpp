@@ -0,0 +1,98 @@
+#include "SessionSettings.h"
+
+#include <curl/curl.h>
+
+namespace ezhttp
+{
+    void SessionSettings::SetAuth(const std::optional<cpr::Authentication> &new_auth)
+    {
+        auth = new_auth;
+        auth_string = auth ? std::string(auth->GetAuthString()) : std::string();
+    }
+
+    SessionSettingsDelta GetSessionSettingsDelta(const std::optional<SessionSettings> &applied, const SessionSettings &desired)
+    {
+        SessionSettingsDelta delta;
+        if (!applied)
+        {
+            delta.ssl = !desired.ca_info.empty();
+            delta.tls_sessions = true;
+            delta.timeout = true;
+            delta.connect_timeout = true;
+            delta.connect_policy = true;
+            delta.auth = true;
+            return delta;
+        }
+
+        delta.ssl = (desired.ca_info != applied->ca_info || desired.ca_cert_store != applied->ca_cert_store) && !desired.ca_info.empty();
+        delta.tls_sessions = desired.tls_session_cache != applied->tls_session_cache;
+        delta.timeout = desired.timeout_ms != applied->timeout_ms;
+        delta.connect_timeout = desired.connect_timeout_ms != applied->connect_timeout_ms;
+        delta.connect_policy = desired.ip_resolve != applied->ip_resolve || desired.happy_eyeballs_timeout_ms != applied->happy_eyeballs_timeout_ms ||
+                               desired.resolve != applied->resolve;
+        delta.auth = desired.auth.has_value() != applied->auth.has_value() || desired.auth_string != applied->auth_string;
+        return delta;
+    }
+
+    void ApplySessionSettings(cpr::Session &session, std::optional<SessionSettings> &applied, const SessionSettings &desired)
+    {
+        const SessionSettingsDelta delta = GetSessionSettingsDelta(applied, desired);
+        if (delta.Empty())
+            return;
+
+        // the handle keeps pointing to the list until it is replaced
+        std::shared_ptr<curl_slist> resolve_list = applied ? applied->resolve_list : nullptr;
+
+        if (delta.ssl)
+        {
+            cpr::SslOptions ssl_opt;
+            ssl_opt.ca_info = desired.ca_info;
+            session.SetSslOptions(ssl_opt);
+
+            CURL *curl = session.GetCurlHolder()->handle;
+            if (!desired.ca_cert_store || !desired.ca_cert_store->Apply(curl))
+                curl_easy_setopt(curl, CURLOPT_SSL_CTX_FUNCTION, nullptr);
+        }
+
+        if (delta.tls_sessions)
+        {
+            CURL *curl = session.GetCurlHolder()->handle;
+            if (!desired.tls_session_cache || !desired.tls_session_cache->Attach(curl))
+                curl_easy_setopt(curl, CURLOPT_SHARE, nullptr);
+        }
+
+        if (delta.timeout)
+            session.SetTimeout(cpr::Timeout{desired.timeout_ms});
+
+        if (delta.connect_timeout)
+            session.SetConnectTimeout(cpr::ConnectTimeout{desired.connect_timeout_ms});
+
+        if (delta.connect_policy)
+        {
+            CURL *curl = session.GetCurlHolder()->handle;
+            curl_easy_setopt(curl, CURLOPT_IPRESOLVE, desired.ip_resolve);
+            curl_easy_setopt(curl, CURLOPT_HAPPY_EYEBALLS_TIMEOUT_MS, desired.happy_eyeballs_timeout_ms);
+
+            // a + entry expires like a resolved one, so a removed pin is forgotten with the dns cache
+            resolve_list = desired.resolve.empty() ? nullptr : std::shared_ptr<curl_slist>(curl_slist_append(nullptr, desired.resolve.c_str()), curl_slist_free_all);
+            curl_easy_setopt(curl, CURLOPT_RESOLVE, resolve_list.get());
+        }
+
+        if (delta.auth)
+        {
+            if (desired.auth)
+            {
+                session.SetAuth(*desired.auth);
+            }
+            else
+            {
+                CURL *curl = session.GetCurlHolder()->handle;
+                curl_easy_setopt(curl, CURLOPT_USERPWD, nullptr);
+                curl_easy_setopt(curl, CURLOPT_HTTPAUTH, CURLAUTH_BASIC);
+            }
+        }
+
+        applied = desired;
+        applied->resolve_list = std::move(resolve_list);
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include <cpr/session.h>
+#include <curl/curl.h>
+
+#include "../CaCertStore.h"
+#include "TlsSessionCache.h"
+
+namespace ezhttp
+{
+    // Options that cpr sets on the curl handle itself instead of keeping them in cpr::Session, so they
+    // stay on a pooled handle for the next requests. The pool keeps this record with the handle and the
+    // next request sets only the options that differ, options it doesn't use are reset to the defaults
+    struct SessionSettings
+    {
+        std::string ca_info; // ssl options are set if not empty
+        std::shared_ptr<const CaCertStore> ca_cert_store; // used instead of ca_info if it is loaded
+        std::shared_ptr<TlsSessionCache> tls_session_cache; // the handle is detached from the share if null
+        int32_t timeout_ms = 0; // 0 means the curl defaults for both timeouts
+        int32_t connect_timeout_ms = 0;
+        long ip_resolve = CURL_IPRESOLVE_WHATEVER;
+        long happy_eyeballs_timeout_ms = CURL_HET_DEFAULT;
+        std::string resolve; // +host:port:addresses, new connections skip dns if not empty
+        std::shared_ptr<curl_slist> resolve_list; // the list curl reads at every transfer, not compared
+        std::optional<cpr::Authentication> auth;
+        std::string auth_string; // user:password of auth, to compare it
+
+        void SetAuth(const std::optional<cpr::Authentication> &new_auth);
+    };
+
+    struct SessionSettingsDelta
+    {
+        bool ssl = false;
+        bool tls_sessions = false;
+        bool timeout = false;
+        bool connect_timeout = false;
+        bool connect_policy = false;
+        bool auth = false;
+
+        [[nodiscard]] bool Empty() const { return !ssl && !tls_sessions && !timeout && !connect_timeout && !connect_policy && !auth; }
+    };
+
+    // Everything is applied if it is unknown what the handle has, e.g. after a transfer that set options directly
+    SessionSettingsDelta GetSessionSettingsDelta(const std::optional<SessionSettings> &applied, const SessionSettings &desired);
+
+    // Applies the delta to the session and updates the record of the handle
+    void ApplySessionSettings(cpr::Session &session, std::optional<SessionSettings> &applied, const SessionSettings &desired);
+}
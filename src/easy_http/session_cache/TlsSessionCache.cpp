@@ -0,0 +1,98 @@
+#include "TlsSessionCache.h"
+
+#ifdef LINUX
+#include <openssl/ssl.h>
+#endif
+
+#include "utils/TraceLog.h"
+
+using namespace ezhttp;
+
+TlsSessionCache::TlsSessionCache()
+{
+    share_ = curl_share_init();
+    if (!share_)
+        return;
+
+    curl_share_setopt(share_, CURLSHOPT_LOCKFUNC, OnLock);
+    curl_share_setopt(share_, CURLSHOPT_UNLOCKFUNC, OnUnlock);
+    curl_share_setopt(share_, CURLSHOPT_USERDATA, this);
+
+    if (curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION) != CURLSHE_OK)
+    {
+        ezhttp::trace::Writef("TlsSessionCache", "ctor tls sessions can't be shared");
+        curl_share_cleanup(share_);
+        share_ = nullptr;
+    }
+}
+
+TlsSessionCache::~TlsSessionCache()
+{
+    if (share_)
+        curl_share_cleanup(share_);
+}
+
+bool TlsSessionCache::Attach(CURL *curl)
+{
+    if (!share_)
+        return false;
+
+    return curl_easy_setopt(curl, CURLOPT_SHARE, share_) == CURLE_OK;
+}
+
+void TlsSessionCache::RecordHandshake(CURL *curl)
+{
+    // the ssl object is available only while the transfer holds the connection
+    curl_tlssessioninfo *session_info = nullptr;
+    if (curl_easy_getinfo(curl, CURLINFO_TLS_SSL_PTR, &session_info) != CURLE_OK || !session_info || !session_info->internals)
+        return;
+
+#ifdef LINUX
+    if (session_info->backend == CURLSSLBACKEND_OPENSSL)
+    {
+        if (SSL_session_reused(static_cast<SSL *>(session_info->internals)))
+            resumed_handshakes_.fetch_add(1);
+        else
+            full_handshakes_.fetch_add(1);
+    }
+#endif
+}
+
+void TlsSessionCache::OnLock(CURL * /*curl*/, curl_lock_data data, curl_lock_access /*access*/, void *user_data)
+{
+    static_cast<TlsSessionCache *>(user_data)->mutexes_[data].lock();
+}
+
+void TlsSessionCache::OnUnlock(CURL * /*curl*/, curl_lock_data data, void *user_data)
+{
+    static_cast<TlsSessionCache *>(user_data)->mutexes_[data].unlock();
+}
+
+TlsSessionCache::TransferScope::TransferScope(TlsSessionCache &cache, CURL *curl) : cache_(cache),
+                                                                                   curl_(curl)
+{
+    curl_easy_setopt(curl_, CURLOPT_PREREQFUNCTION, OnPreRequest);
+    curl_easy_setopt(curl_, CURLOPT_PREREQDATA, this);
+}
+
+TlsSessionCache::TransferScope::~TransferScope()
+{
+    // a pooled handle must not point to the scope of a finished transfer
+    curl_easy_setopt(curl_, CURLOPT_PREREQFUNCTION, nullptr);
+    curl_easy_setopt(curl_, CURLOPT_PREREQDATA, nullptr);
+}
+
+int TlsSessionCache::TransferScope::OnPreRequest(void *user_data, char * /*conn_primary_ip*/, char * /*conn_local_ip*/, int /*conn_primary_port*/, int /*conn_local_port*/)
+{
+    // called for every request of the transfer, including redirects, but only new connections have a handshake
+    auto *scope = static_cast<TransferScope *>(user_data);
+
+    long connects = 0;
+    if (curl_easy_getinfo(scope->curl_, CURLINFO_NUM_CONNECTS, &connects) == CURLE_OK && connects > scope->counted_connects_)
+    {
+        scope->counted_connects_ = connects;
+        scope->cache_.RecordHandshake(scope->curl_);
+    }
+
+    return CURL_PREREQFUNC_OK;
+}
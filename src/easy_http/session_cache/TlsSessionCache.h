@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+#include <curl/curl.h>
+
+namespace ezhttp
+{
+    // TLS sessions shared by all handles through a curl share, so a new connection to a host that was
+    // visited before resumes the session with an abbreviated handshake, even if the pooled handle
+    // of the previous connection has been evicted or has expired. curl keys the sessions by host, port
+    // and TLS options and keeps a small number of the most recently used ones.
+    // Handshakes of new connections are counted, so the hit rate can be monitored. Whether a session
+    // was resumed is known only with the OpenSSL backend, other backends leave the counters untouched.
+    // Thread-safe, must outlive the handles it is attached to
+    class TlsSessionCache
+    {
+        CURLSH *share_ = nullptr;
+        std::mutex mutexes_[CURL_LOCK_DATA_LAST]; // curl locks the share data and the sessions separately
+        std::atomic<uint64_t> full_handshakes_{0};
+        std::atomic<uint64_t> resumed_handshakes_{0};
+
+    public:
+        TlsSessionCache();
+        ~TlsSessionCache();
+
+        TlsSessionCache(const TlsSessionCache &other) = delete;
+        TlsSessionCache &operator=(const TlsSessionCache &other) = delete;
+
+        // Makes the handle store and look up its TLS sessions in the shared cache
+        bool Attach(CURL *curl);
+
+        [[nodiscard]] uint64_t GetFullHandshakes() const { return full_handshakes_.load(); }
+        [[nodiscard]] uint64_t GetResumedHandshakes() const { return resumed_handshakes_.load(); }
+
+        // Counts the handshakes of the connections a transfer makes, lives on the stack around the transfer
+        class TransferScope
+        {
+            TlsSessionCache &cache_;
+            CURL *curl_;
+            long counted_connects_ = 0;
+
+        public:
+            TransferScope(TlsSessionCache &cache, CURL *curl);
+            ~TransferScope();
+
+            TransferScope(const TransferScope &other) = delete;
+            TransferScope &operator=(const TransferScope &other) = delete;
+
+        private:
+            static int OnPreRequest(void *user_data, char *conn_primary_ip, char *conn_local_ip, int conn_primary_port, int conn_local_port);
+        };
+
+    private:
+        void RecordHandshake(CURL *curl);
+
+        static void OnLock(CURL *curl, curl_lock_data data, curl_lock_access access, void *user_data);
+        static void OnUnlock(CURL *curl, curl_lock_data data, void *user_data);
+    };
+}
@@ -0,0 +1,202 @@
+//
+// JSON file I/O off the game thread
+//
+
+#include "JsonAsyncIO.h"
+#include "JsonFile.h"
+#include "JsonMngr.h"
+#include <utils/TraceLog.h>
+
+#include <algorithm>
+
+JSONAsyncIO::~JSONAsyncIO()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bStop = true;
+
+        // saves are finished before the server goes down, loads are useless now
+        m_Tasks.erase(std::remove_if(m_Tasks.begin(), m_Tasks.end(), [](const Task &task) { return task.m_Type == Operation::Load; }), m_Tasks.end());
+    }
+    m_TaskAdded.notify_all();
+
+    for (auto &worker : m_Workers)
+    {
+        worker.join();
+    }
+
+    // AMXX is already gone at this point, so forwards are not touched
+    for (auto &result : m_Results)
+    {
+        json_value_free(result.m_pValue);
+    }
+}
+
+void JSONAsyncIO::ParseFile(AMX *amx, const std::string &path, bool with_comments, int callback_id, std::unique_ptr<cell[]> data, int data_len)
+{
+    Enqueue(PendingOperation{Operation::Load, amx, callback_id, std::move(data), data_len},
+            Task{0, Operation::Load, path, with_comments, nullptr});
+}
+
+void JSONAsyncIO::SerialToFile(AMX *amx, const std::string &path, JSON_Value *value, bool pretty, int callback_id, std::unique_ptr<cell[]> data, int data_len)
+{
+    Enqueue(PendingOperation{Operation::Save, amx, callback_id, std::move(data), data_len},
+            Task{0, Operation::Save, path, pretty, value});
+}
+
+void JSONAsyncIO::Enqueue(PendingOperation operation, Task task)
+{
+    task.m_Id = m_NextId++;
+    m_Pending.emplace(task.m_Id, std::move(operation));
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Tasks.push_back(std::move(task));
+    }
+    m_TaskAdded.notify_one();
+
+    // threads are not needed until a plugin does something in the background
+    if (m_Workers.size() < kMaxWorkers)
+    {
+        m_Workers.emplace_back(&JSONAsyncIO::WorkerLoop, this);
+    }
+}
+
+void JSONAsyncIO::RunFrame(JSONMngr &json_mngr)
+{
+    std::vector<Result> results;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_Results.empty())
+        {
+            return;
+        }
+
+        results.swap(m_Results);
+    }
+
+    for (auto &result : results)
+    {
+        auto it = m_Pending.find(result.m_Id);
+        if (it == m_Pending.end())
+        {
+            json_value_free(result.m_pValue);
+            continue;
+        }
+
+        PendingOperation operation = std::move(it->second);
+        m_Pending.erase(it);
+
+        cell forward_value;
+        if (operation.m_Type == Operation::Save)
+        {
+            forward_value = result.m_bSuccess;
+        }
+        else
+        {
+            JS_Handle handle = -1;
+            if (result.m_pValue && json_mngr.IsOwnerAtLimit(operation.m_pAmx))
+            {
+                json_value_free(result.m_pValue);
+            }
+            else if (result.m_pValue)
+            {
+                json_mngr.SetOwner(operation.m_pAmx);
+                json_mngr.AdoptValue(result.m_pValue, &handle);
+            }
+
+            forward_value = handle;
+        }
+
+        if (operation.m_CallbackId == -1)
+        {
+            continue;
+        }
+
+        if (operation.m_pData)
+        {
+            MF_ExecuteForward(operation.m_CallbackId, forward_value, MF_PrepareCellArray(operation.m_pData.get(), operation.m_DataLen));
+        }
+        else
+        {
+            MF_ExecuteForward(operation.m_CallbackId, forward_value);
+        }
+
+        MF_UnregisterSPForward(operation.m_CallbackId);
+    }
+}
+
+void JSONAsyncIO::DropPending()
+{
+    size_t canceled;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        auto loads = std::remove_if(m_Tasks.begin(), m_Tasks.end(), [](const Task &task) { return task.m_Type == Operation::Load; });
+        canceled = static_cast<size_t>(m_Tasks.end() - loads);
+        m_Tasks.erase(loads, m_Tasks.end());
+    }
+
+    ezhttp::trace::Writef("JSONAsyncIO", "DropPending pending=%zu canceled_loads=%zu", m_Pending.size(), canceled);
+
+    for (auto &pending_kv : m_Pending)
+    {
+        if (pending_kv.second.m_CallbackId != -1)
+        {
+            MF_UnregisterSPForward(pending_kv.second.m_CallbackId);
+        }
+    }
+    m_Pending.clear();
+}
+
+std::deque<JSONAsyncIO::Task>::iterator JSONAsyncIO::FindRunnableTaskLocked()
+{
+    return std::find_if(m_Tasks.begin(), m_Tasks.end(), [this](const Task &task) { return m_BusyPaths.count(task.m_Path) == 0; });
+}
+
+void JSONAsyncIO::WorkerLoop()
+{
+    while (true)
+    {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            auto it = m_Tasks.end();
+            m_TaskAdded.wait(lock, [this, &it] {
+                it = FindRunnableTaskLocked();
+                return it != m_Tasks.end() || (m_bStop && m_Tasks.empty());
+            });
+
+            if (it == m_Tasks.end())
+            {
+                return;
+            }
+
+            task = std::move(*it);
+            m_Tasks.erase(it);
+            m_BusyPaths.insert(task.m_Path);
+        }
+
+        Result result{task.m_Id, false, nullptr};
+        if (task.m_Type == Operation::Load)
+        {
+            result.m_pValue = AMXX::JSONParseFile(task.m_Path.c_str(), task.m_bFlag);
+            result.m_bSuccess = result.m_pValue != nullptr;
+        }
+        else
+        {
+            // the game thread doesn't wait for it, so the file is made durable too
+            result.m_bSuccess = AMXX::JSONSerialToFile(task.m_pValue, task.m_Path.c_str(), task.m_bFlag, true);
+            json_value_free(task.m_pValue);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_BusyPaths.erase(task.m_Path);
+            m_Results.push_back(result);
+        }
+
+        // a task for the same file may be waiting for this one
+        m_TaskAdded.notify_all();
+    }
+}
@@ -0,0 +1,105 @@
+//
+// JSON file I/O off the game thread
+//
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <sdk/amxxmodule.h>
+#include <parson.h>
+
+class JSONMngr;
+
+class JSONAsyncIO
+{
+public:
+
+    // Operations on different files run in parallel, operations on the same file keep their order
+    static constexpr size_t kMaxWorkers = 2;
+
+    JSONAsyncIO() = default;
+    ~JSONAsyncIO();
+
+    JSONAsyncIO(const JSONAsyncIO &) = delete;
+    JSONAsyncIO &operator=(const JSONAsyncIO &) = delete;
+
+    // Parses the file on a worker thread, the forward receives the new handle or Invalid_JSON.
+    // Takes ownership of the forward
+    void ParseFile(AMX *amx, const std::string &path, bool with_comments, int callback_id, std::unique_ptr<cell[]> data, int data_len);
+
+    // Serializes the detached value to the file on a worker thread, the forward (optional, -1 if none)
+    // receives the result. Takes ownership of the value and the forward
+    void SerialToFile(AMX *amx, const std::string &path, JSON_Value *value, bool pretty, int callback_id, std::unique_ptr<cell[]> data, int data_len);
+
+    // Executes forwards of the finished operations, must be called from the game thread
+    void RunFrame(JSONMngr &json_mngr);
+
+    // Forgets every pending operation without executing its forward. Queued loads are canceled,
+    // queued saves are still written, so plugins can persist data right before a map change
+    void DropPending();
+
+    inline size_t GetPendingCount() const
+    {
+        return m_Pending.size();
+    }
+
+private:
+
+    enum class Operation
+    {
+        Load,
+        Save
+    };
+
+    struct PendingOperation
+    {
+        Operation                m_Type;
+        AMX                     *m_pAmx;        //Plugin that started the operation
+        int                      m_CallbackId;  //Forward to execute, -1 if none
+        std::unique_ptr<cell[]>  m_pData;       //Data passed to the forward
+        int                      m_DataLen;
+    };
+
+    struct Task
+    {
+        uint32_t    m_Id;
+        Operation   m_Type;
+        std::string m_Path;
+        bool        m_bFlag;                    //with_comments for loads, pretty for saves
+        JSON_Value *m_pValue;                   //Value to save, owned by the task
+    };
+
+    struct Result
+    {
+        uint32_t    m_Id;
+        bool        m_bSuccess;
+        JSON_Value *m_pValue;                   //Loaded value, nullptr for saves
+    };
+
+    void Enqueue(PendingOperation operation, Task task);
+    void WorkerLoop();
+    std::deque<Task>::iterator FindRunnableTaskLocked();
+
+    // Accessed only by the game thread
+    uint32_t m_NextId = 0;
+    std::unordered_map<uint32_t, PendingOperation> m_Pending;
+
+    // Shared with the worker threads
+    std::mutex m_Mutex;
+    std::condition_variable m_TaskAdded;
+    std::deque<Task> m_Tasks;
+    std::unordered_set<std::string> m_BusyPaths;
+    std::vector<Result> m_Results;
+    bool m_bStop = false;
+
+    std::vector<std::thread> m_Workers;
+};
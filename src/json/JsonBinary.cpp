@@ -0,0 +1,770 @@
+//
+// Binary JSON encodings (MessagePack and CBOR) for parson values
+//
+
+#include "JsonBinary.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace AMXX
+{
+    namespace
+    {
+        // Protects the decoder from stack exhaustion on hostile input
+        const int kMaxNesting = 512;
+
+        class BinaryReader
+        {
+        public:
+            BinaryReader(const char *data, size_t size) : m_pData(reinterpret_cast<const uint8_t *>(data)), m_Size(size)
+            {
+            }
+
+            size_t Remaining() const
+            {
+                return m_Size - m_Pos;
+            }
+
+            bool Peek(uint8_t &byte) const
+            {
+                if (!Remaining())
+                {
+                    return false;
+                }
+
+                byte = m_pData[m_Pos];
+                return true;
+            }
+
+            bool ReadByte(uint8_t &byte)
+            {
+                if (!Peek(byte))
+                {
+                    return false;
+                }
+
+                m_Pos++;
+                return true;
+            }
+
+            // Reads big-endian unsigned integer of 1, 2, 4 or 8 bytes
+            bool ReadUnsigned(int bytes, uint64_t &value)
+            {
+                if (Remaining() < static_cast<size_t>(bytes))
+                {
+                    return false;
+                }
+
+                value = 0;
+                for (int i = 0; i < bytes; i++)
+                {
+                    value = (value << 8) | m_pData[m_Pos++];
+                }
+
+                return true;
+            }
+
+            bool ReadBytes(uint64_t length, const char *&bytes)
+            {
+                if (length > Remaining())
+                {
+                    return false;
+                }
+
+                bytes = reinterpret_cast<const char *>(m_pData + m_Pos);
+                m_Pos += static_cast<size_t>(length);
+                return true;
+            }
+
+        private:
+            const uint8_t *m_pData;
+            size_t m_Size;
+            size_t m_Pos = 0;
+        };
+
+        void WriteBigEndian(std::string &out, uint64_t value, int bytes)
+        {
+            for (int i = bytes - 1; i >= 0; i--)
+            {
+                out.push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+            }
+        }
+
+        void WriteDouble(std::string &out, uint8_t type, double number)
+        {
+            uint64_t bits;
+            std::memcpy(&bits, &number, sizeof(bits));
+
+            out.push_back(static_cast<char>(type));
+            WriteBigEndian(out, bits, 8);
+        }
+
+        double ToDouble(uint64_t bits)
+        {
+            double number;
+            std::memcpy(&number, &bits, sizeof(number));
+            return number;
+        }
+
+        double ToFloat(uint64_t bits)
+        {
+            float number;
+            auto bits32 = static_cast<uint32_t>(bits);
+            std::memcpy(&number, &bits32, sizeof(number));
+            return number;
+        }
+
+        double HalfToDouble(uint64_t half)
+        {
+            auto exponent = static_cast<int>((half >> 10) & 0x1F);
+            auto mantissa = static_cast<int>(half & 0x3FF);
+
+            double number;
+            if (exponent == 0)
+            {
+                number = std::ldexp(mantissa, -24);
+            }
+            else if (exponent != 31)
+            {
+                number = std::ldexp(mantissa + 1024, exponent - 25);
+            }
+            else
+            {
+                number = (mantissa == 0) ? INFINITY : NAN;
+            }
+
+            return (half & 0x8000) ? -number : number;
+        }
+
+        // Checks if the number can be written as an integer without losing precision
+        bool IsIntegral(double number)
+        {
+            return std::isfinite(number) && std::floor(number) == number &&
+                   number >= -9223372036854775808.0 && number < 18446744073709551616.0;
+        }
+
+        bool TakeName(JSON_Value *key, std::string &name)
+        {
+            if (json_value_get_type(key) == JSONString)
+            {
+                name.assign(json_value_get_string(key), json_value_get_string_len(key));
+                return true;
+            }
+
+            // JSON object names are strings only, so other keys are stored in their serialized form
+            auto serialized = json_serialize_to_string(key);
+            if (!serialized)
+            {
+                return false;
+            }
+
+            name = serialized;
+            json_free_serialized_string(serialized);
+            return true;
+        }
+
+        template <class TReadFunc>
+        JSON_Value *ReadArray(BinaryReader &reader, uint64_t count, bool indefinite, int nesting, TReadFunc readValue)
+        {
+            if (!indefinite && count > reader.Remaining())
+            {
+                return nullptr;
+            }
+
+            auto JSValue = json_value_init_array();
+            if (!JSValue)
+            {
+                return nullptr;
+            }
+
+            auto JSArray = json_value_get_array(JSValue);
+            for (uint64_t i = 0; indefinite || i < count; i++)
+            {
+                uint8_t next;
+                if (indefinite && reader.Peek(next) && next == 0xFF)
+                {
+                    reader.ReadByte(next);
+                    break;
+                }
+
+                auto JSItem = readValue(reader, nesting + 1);
+                if (!JSItem)
+                {
+                    json_value_free(JSValue);
+                    return nullptr;
+                }
+
+                if (json_array_append_value(JSArray, JSItem) != JSONSuccess)
+                {
+                    json_value_free(JSItem);
+                    json_value_free(JSValue);
+                    return nullptr;
+                }
+            }
+
+            return JSValue;
+        }
+
+        template <class TReadFunc>
+        JSON_Value *ReadMap(BinaryReader &reader, uint64_t count, bool indefinite, int nesting, TReadFunc readValue)
+        {
+            if (!indefinite && count > reader.Remaining() / 2)
+            {
+                return nullptr;
+            }
+
+            auto JSValue = json_value_init_object();
+            if (!JSValue)
+            {
+                return nullptr;
+            }
+
+            auto JSObject = json_value_get_object(JSValue);
+            std::string name;
+            for (uint64_t i = 0; indefinite || i < count; i++)
+            {
+                uint8_t next;
+                if (indefinite && reader.Peek(next) && next == 0xFF)
+                {
+                    reader.ReadByte(next);
+                    break;
+                }
+
+                auto JSKey = readValue(reader, nesting + 1);
+                auto nameTaken = JSKey && TakeName(JSKey, name);
+                if (JSKey)
+                {
+                    json_value_free(JSKey);
+                }
+
+                auto JSItem = nameTaken ? readValue(reader, nesting + 1) : nullptr;
+                if (!JSItem)
+                {
+                    json_value_free(JSValue);
+                    return nullptr;
+                }
+
+                if (json_object_set_value(JSObject, name.c_str(), JSItem) != JSONSuccess)
+                {
+                    json_value_free(JSItem);
+                    json_value_free(JSValue);
+                    return nullptr;
+                }
+            }
+
+            return JSValue;
+        }
+
+        JSON_Value *ReadString(BinaryReader &reader, uint64_t length)
+        {
+            const char *bytes;
+            if (!reader.ReadBytes(length, bytes))
+            {
+                return nullptr;
+            }
+
+            return json_value_init_string_with_len(bytes, static_cast<size_t>(length));
+        }
+
+        //
+        // MessagePack (https://github.com/msgpack/msgpack/blob/master/spec.md)
+        //
+
+        void MsgPackWriteLength(std::string &out, size_t length, uint8_t fixType, size_t fixMax, uint8_t type8, uint8_t type16, uint8_t type32)
+        {
+            if (length <= fixMax)
+            {
+                out.push_back(static_cast<char>(fixType | length));
+            }
+            else if (type8 && length <= 0xFF)
+            {
+                out.push_back(static_cast<char>(type8));
+                WriteBigEndian(out, length, 1);
+            }
+            else if (length <= 0xFFFF)
+            {
+                out.push_back(static_cast<char>(type16));
+                WriteBigEndian(out, length, 2);
+            }
+            else
+            {
+                out.push_back(static_cast<char>(type32));
+                WriteBigEndian(out, length, 4);
+            }
+        }
+
+        void MsgPackWriteNumber(std::string &out, double number)
+        {
+            if (!IsIntegral(number))
+            {
+                WriteDouble(out, 0xCB, number);
+            }
+            else if (number >= 0)
+            {
+                auto value = static_cast<uint64_t>(number);
+                if (value <= 0x7F)
+                {
+                    out.push_back(static_cast<char>(value));
+                }
+                else if (value <= 0xFF)
+                {
+                    out.push_back('\xCC');
+                    WriteBigEndian(out, value, 1);
+                }
+                else if (value <= 0xFFFF)
+                {
+                    out.push_back('\xCD');
+                    WriteBigEndian(out, value, 2);
+                }
+                else if (value <= 0xFFFFFFFF)
+                {
+                    out.push_back('\xCE');
+                    WriteBigEndian(out, value, 4);
+                }
+                else
+                {
+                    out.push_back('\xCF');
+                    WriteBigEndian(out, value, 8);
+                }
+            }
+            else
+            {
+                auto value = static_cast<int64_t>(number);
+                if (value >= -32)
+                {
+                    out.push_back(static_cast<char>(value));
+                }
+                else if (value >= INT8_MIN)
+                {
+                    out.push_back('\xD0');
+                    WriteBigEndian(out, static_cast<uint64_t>(value), 1);
+                }
+                else if (value >= INT16_MIN)
+                {
+                    out.push_back('\xD1');
+                    WriteBigEndian(out, static_cast<uint64_t>(value), 2);
+                }
+                else if (value >= INT32_MIN)
+                {
+                    out.push_back('\xD2');
+                    WriteBigEndian(out, static_cast<uint64_t>(value), 4);
+                }
+                else
+                {
+                    out.push_back('\xD3');
+                    WriteBigEndian(out, static_cast<uint64_t>(value), 8);
+                }
+            }
+        }
+
+        bool MsgPackWriteValue(const JSON_Value *value, std::string &out)
+        {
+            switch (json_value_get_type(value))
+            {
+                case JSONNull:
+                {
+                    out.push_back('\xC0');
+                    return true;
+                }
+                case JSONBoolean:
+                {
+                    out.push_back(json_value_get_boolean(value) == 1 ? '\xC3' : '\xC2');
+                    return true;
+                }
+                case JSONNumber:
+                {
+                    MsgPackWriteNumber(out, json_value_get_number(value));
+                    return true;
+                }
+                case JSONString:
+                {
+                    auto length = json_value_get_string_len(value);
+                    if (length > 0xFFFFFFFF)
+                    {
+                        return false;
+                    }
+
+                    MsgPackWriteLength(out, length, 0xA0, 31, 0xD9, 0xDA, 0xDB);
+                    out.append(json_value_get_string(value), length);
+                    return true;
+                }
+                case JSONArray:
+                {
+                    auto JSArray = json_value_get_array(value);
+                    auto count = json_array_get_count(JSArray);
+
+                    MsgPackWriteLength(out, count, 0x90, 15, 0, 0xDC, 0xDD);
+                    for (size_t i = 0; i < count; i++)
+                    {
+                        if (!MsgPackWriteValue(json_array_get_value(JSArray, i), out))
+                        {
+                            return false;
+                        }
+                    }
+                    return true;
+                }
+                case JSONObject:
+                {
+                    auto JSObject = json_value_get_object(value);
+                    auto count = json_object_get_count(JSObject);
+
+                    MsgPackWriteLength(out, count, 0x80, 15, 0, 0xDE, 0xDF);
+                    for (size_t i = 0; i < count; i++)
+                    {
+                        auto name = json_object_get_name(JSObject, i);
+                        auto length = strlen(name);
+
+                        MsgPackWriteLength(out, length, 0xA0, 31, 0xD9, 0xDA, 0xDB);
+                        out.append(name, length);
+
+                        if (!MsgPackWriteValue(json_object_get_value_at(JSObject, i), out))
+                        {
+                            return false;
+                        }
+                    }
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        JSON_Value *MsgPackReadValue(BinaryReader &reader, int nesting)
+        {
+            uint8_t type;
+            if (nesting > kMaxNesting || !reader.ReadByte(type))
+            {
+                return nullptr;
+            }
+
+            if (type <= 0x7F)
+            {
+                return json_value_init_number(type);
+            }
+            if (type >= 0xE0)
+            {
+                return json_value_init_number(static_cast<int8_t>(type));
+            }
+            if ((type & 0xF0) == 0x80)
+            {
+                return ReadMap(reader, type & 0x0F, false, nesting, MsgPackReadValue);
+            }
+            if ((type & 0xF0) == 0x90)
+            {
+                return ReadArray(reader, type & 0x0F, false, nesting, MsgPackReadValue);
+            }
+            if ((type & 0xE0) == 0xA0)
+            {
+                return ReadString(reader, type & 0x1F);
+            }
+
+            uint64_t argument;
+            switch (type)
+            {
+                case 0xC0: return json_value_init_null();
+                case 0xC2: return json_value_init_boolean(0);
+                case 0xC3: return json_value_init_boolean(1);
+
+                // bin and str
+                case 0xC4: case 0xD9: return reader.ReadUnsigned(1, argument) ? ReadString(reader, argument) : nullptr;
+                case 0xC5: case 0xDA: return reader.ReadUnsigned(2, argument) ? ReadString(reader, argument) : nullptr;
+                case 0xC6: case 0xDB: return reader.ReadUnsigned(4, argument) ? ReadString(reader, argument) : nullptr;
+
+                case 0xCA: return reader.ReadUnsigned(4, argument) ? json_value_init_number(ToFloat(argument)) : nullptr;
+                case 0xCB: return reader.ReadUnsigned(8, argument) ? json_value_init_number(ToDouble(argument)) : nullptr;
+
+                case 0xCC: return reader.ReadUnsigned(1, argument) ? json_value_init_number(static_cast<double>(argument)) : nullptr;
+                case 0xCD: return reader.ReadUnsigned(2, argument) ? json_value_init_number(static_cast<double>(argument)) : nullptr;
+                case 0xCE: return reader.ReadUnsigned(4, argument) ? json_value_init_number(static_cast<double>(argument)) : nullptr;
+                case 0xCF: return reader.ReadUnsigned(8, argument) ? json_value_init_number(static_cast<double>(argument)) : nullptr;
+
+                case 0xD0: return reader.ReadUnsigned(1, argument) ? json_value_init_number(static_cast<int8_t>(argument)) : nullptr;
+                case 0xD1: return reader.ReadUnsigned(2, argument) ? json_value_init_number(static_cast<int16_t>(argument)) : nullptr;
+                case 0xD2: return reader.ReadUnsigned(4, argument) ? json_value_init_number(static_cast<int32_t>(argument)) : nullptr;
+                case 0xD3: return reader.ReadUnsigned(8, argument) ? json_value_init_number(static_cast<double>(static_cast<int64_t>(argument))) : nullptr;
+
+                case 0xDC: return reader.ReadUnsigned(2, argument) ? ReadArray(reader, argument, false, nesting, MsgPackReadValue) : nullptr;
+                case 0xDD: return reader.ReadUnsigned(4, argument) ? ReadArray(reader, argument, false, nesting, MsgPackReadValue) : nullptr;
+                case 0xDE: return reader.ReadUnsigned(2, argument) ? ReadMap(reader, argument, false, nesting, MsgPackReadValue) : nullptr;
+                case 0xDF: return reader.ReadUnsigned(4, argument) ? ReadMap(reader, argument, false, nesting, MsgPackReadValue) : nullptr;
+            }
+
+            // ext types and the never used 0xC1
+            return nullptr;
+        }
+
+        //
+        // CBOR (RFC 8949)
+        //
+
+        enum CborMajorType : uint8_t
+        {
+            Cbor_Unsigned = 0,
+            Cbor_Negative,
+            Cbor_Bytes,
+            Cbor_Text,
+            Cbor_Array,
+            Cbor_Map,
+            Cbor_Tag,
+            Cbor_Simple
+        };
+
+        void CborWriteHead(std::string &out, CborMajorType major, uint64_t argument)
+        {
+            auto type = static_cast<uint8_t>(major << 5);
+            if (argument < 24)
+            {
+                out.push_back(static_cast<char>(type | argument));
+            }
+            else if (argument <= 0xFF)
+            {
+                out.push_back(static_cast<char>(type | 24));
+                WriteBigEndian(out, argument, 1);
+            }
+            else if (argument <= 0xFFFF)
+            {
+                out.push_back(static_cast<char>(type | 25));
+                WriteBigEndian(out, argument, 2);
+            }
+            else if (argument <= 0xFFFFFFFF)
+            {
+                out.push_back(static_cast<char>(type | 26));
+                WriteBigEndian(out, argument, 4);
+            }
+            else
+            {
+                out.push_back(static_cast<char>(type | 27));
+                WriteBigEndian(out, argument, 8);
+            }
+        }
+
+        bool CborWriteValue(const JSON_Value *value, std::string &out)
+        {
+            switch (json_value_get_type(value))
+            {
+                case JSONNull:
+                {
+                    out.push_back('\xF6');
+                    return true;
+                }
+                case JSONBoolean:
+                {
+                    out.push_back(json_value_get_boolean(value) == 1 ? '\xF5' : '\xF4');
+                    return true;
+                }
+                case JSONNumber:
+                {
+                    auto number = json_value_get_number(value);
+                    if (!IsIntegral(number))
+                    {
+                        WriteDouble(out, 0xFB, number);
+                    }
+                    else if (number >= 0)
+                    {
+                        CborWriteHead(out, Cbor_Unsigned, static_cast<uint64_t>(number));
+                    }
+                    else
+                    {
+                        CborWriteHead(out, Cbor_Negative, static_cast<uint64_t>(-(static_cast<int64_t>(number) + 1)));
+                    }
+                    return true;
+                }
+                case JSONString:
+                {
+                    auto length = json_value_get_string_len(value);
+
+                    CborWriteHead(out, Cbor_Text, length);
+                    out.append(json_value_get_string(value), length);
+                    return true;
+                }
+                case JSONArray:
+                {
+                    auto JSArray = json_value_get_array(value);
+                    auto count = json_array_get_count(JSArray);
+
+                    CborWriteHead(out, Cbor_Array, count);
+                    for (size_t i = 0; i < count; i++)
+                    {
+                        if (!CborWriteValue(json_array_get_value(JSArray, i), out))
+                        {
+                            return false;
+                        }
+                    }
+                    return true;
+                }
+                case JSONObject:
+                {
+                    auto JSObject = json_value_get_object(value);
+                    auto count = json_object_get_count(JSObject);
+
+                    CborWriteHead(out, Cbor_Map, count);
+                    for (size_t i = 0; i < count; i++)
+                    {
+                        auto name = json_object_get_name(JSObject, i);
+                        auto length = strlen(name);
+
+                        CborWriteHead(out, Cbor_Text, length);
+                        out.append(name, length);
+
+                        if (!CborWriteValue(json_object_get_value_at(JSObject, i), out))
+                        {
+                            return false;
+                        }
+                    }
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        bool CborReadArgument(BinaryReader &reader, uint8_t info, uint64_t &argument)
+        {
+            switch (info)
+            {
+                case 24: return reader.ReadUnsigned(1, argument);
+                case 25: return reader.ReadUnsigned(2, argument);
+                case 26: return reader.ReadUnsigned(4, argument);
+                case 27: return reader.ReadUnsigned(8, argument);
+            }
+
+            if (info >= 24)
+            {
+                return false;
+            }
+
+            argument = info;
+            return true;
+        }
+
+        // Concatenates chunks of an indefinite-length string
+        JSON_Value *CborReadChunkedString(BinaryReader &reader, CborMajorType major)
+        {
+            std::string text;
+
+            while (true)
+            {
+                uint8_t type;
+                if (!reader.ReadByte(type))
+                {
+                    return nullptr;
+                }
+
+                if (type == 0xFF)
+                {
+                    break;
+                }
+
+                const char *bytes;
+                uint64_t length;
+                if ((type >> 5) != major || !CborReadArgument(reader, type & 0x1F, length) || !reader.ReadBytes(length, bytes))
+                {
+                    return nullptr;
+                }
+
+                text.append(bytes, static_cast<size_t>(length));
+            }
+
+            return json_value_init_string_with_len(text.c_str(), text.length());
+        }
+
+        JSON_Value *CborReadValue(BinaryReader &reader, int nesting)
+        {
+            uint8_t type;
+            if (nesting > kMaxNesting || !reader.ReadByte(type))
+            {
+                return nullptr;
+            }
+
+            auto major = static_cast<CborMajorType>(type >> 5);
+            auto info = static_cast<uint8_t>(type & 0x1F);
+
+            if (major == Cbor_Simple)
+            {
+                uint64_t bits;
+                switch (info)
+                {
+                    case 20: return json_value_init_boolean(0);
+                    case 21: return json_value_init_boolean(1);
+                    case 22: case 23: return json_value_init_null();
+                    case 25: return reader.ReadUnsigned(2, bits) ? json_value_init_number(HalfToDouble(bits)) : nullptr;
+                    case 26: return reader.ReadUnsigned(4, bits) ? json_value_init_number(ToFloat(bits)) : nullptr;
+                    case 27: return reader.ReadUnsigned(8, bits) ? json_value_init_number(ToDouble(bits)) : nullptr;
+                }
+
+                return nullptr;
+            }
+
+            auto indefinite = (info == 31);
+            uint64_t argument = 0;
+            if (indefinite ? (major == Cbor_Unsigned || major == Cbor_Negative || major == Cbor_Tag) : !CborReadArgument(reader, info, argument))
+            {
+                return nullptr;
+            }
+
+            switch (major)
+            {
+                case Cbor_Unsigned: return json_value_init_number(static_cast<double>(argument));
+                case Cbor_Negative: return json_value_init_number(-1.0 - static_cast<double>(argument));
+                case Cbor_Bytes:
+                case Cbor_Text: return indefinite ? CborReadChunkedString(reader, major) : ReadString(reader, argument);
+                case Cbor_Array: return ReadArray(reader, argument, indefinite, nesting, CborReadValue);
+                case Cbor_Map: return ReadMap(reader, argument, indefinite, nesting, CborReadValue);
+                // tags only add semantics to the enclosed item
+                case Cbor_Tag: return CborReadValue(reader, nesting + 1);
+                default: return nullptr;
+            }
+        }
+    }
+
+    const char *GetBinaryFormatContentType(JSONBinaryFormat format)
+    {
+        return (format == Binary_CBOR) ? "application/cbor" : "application/msgpack";
+    }
+
+    bool JSONToBinary(const JSON_Value *value, JSONBinaryFormat format, std::string &out)
+    {
+        if (!value)
+        {
+            return false;
+        }
+
+        switch (format)
+        {
+            case Binary_MessagePack: return MsgPackWriteValue(value, out);
+            case Binary_CBOR: return CborWriteValue(value, out);
+        }
+
+        return false;
+    }
+
+    JSON_Value *JSONFromBinary(const char *data, size_t size, JSONBinaryFormat format)
+    {
+        BinaryReader reader(data, size);
+
+        JSON_Value *JSValue = nullptr;
+        switch (format)
+        {
+            case Binary_MessagePack:
+            {
+                JSValue = MsgPackReadValue(reader, 0);
+                break;
+            }
+            case Binary_CBOR:
+            {
+                JSValue = CborReadValue(reader, 0);
+                break;
+            }
+        }
+
+        if (JSValue && reader.Remaining())
+        {
+            json_value_free(JSValue);
+            return nullptr;
+        }
+
+        return JSValue;
+    }
+}
@@ -0,0 +1,56 @@
+//
+// Binary JSON encodings (MessagePack and CBOR) for parson values
+//
+#pragma once
+
+#include <string>
+
+#include <parson.h>
+
+namespace AMXX
+{
+    /**
+     * @brief Lists of supported binary encodings.
+     */
+    enum JSONBinaryFormat
+    {
+        Binary_MessagePack = 0,
+        Binary_CBOR
+    };
+
+    inline bool IsValidBinaryFormat(int format)
+    {
+        return format == Binary_MessagePack || format == Binary_CBOR;
+    }
+
+    // MIME type used as Content-Type for the encoded body
+    const char *GetBinaryFormatContentType(JSONBinaryFormat format);
+
+    /**
+     * @brief                  Encodes value to the binary format.
+     *
+     * @note                   Integral numbers are encoded as integers, the rest as 64-bit floats.
+     *
+     * @param value            Value to encode
+     * @param format           Binary format
+     * @param out              String where encoded bytes will be appended
+     *
+     * @return                 True if succeed, false otherwise
+     */
+    bool JSONToBinary(const JSON_Value *value, JSONBinaryFormat format, std::string &out);
+
+    /**
+     * @brief                  Decodes a binary document to a new value.
+     *
+     * @note                   Returned value needs to be freed using json_value_free().
+     * @note                   Byte strings are decoded as strings, so they must contain valid UTF-8.
+     *                         Non-string map keys are converted to strings.
+     *
+     * @param data             Encoded bytes
+     * @param size             Number of bytes
+     * @param format           Binary format
+     *
+     * @return                 Decoded value or nullptr if data is malformed or has trailing bytes
+     */
+    JSON_Value *JSONFromBinary(const char *data, size_t size, JSONBinaryFormat format);
+}
@@ -0,0 +1,80 @@
+//
+// JSON file reading and writing that is safe to run on worker threads
+//
+
+#include "JsonFile.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace AMXX
+{
+    JSON_Value *JSONParseFile(const char *path, bool with_comments)
+    {
+        auto jsonFunc = (!with_comments) ? json_parse_file : json_parse_file_with_comments;
+        return jsonFunc(path);
+    }
+
+    bool JSONSerialToFile(const JSON_Value *value, const char *path, bool pretty, bool sync_to_disk)
+    {
+        auto serialized = (!pretty) ? json_serialize_to_string(value) : json_serialize_to_string_pretty(value);
+        if (!serialized)
+        {
+            return false;
+        }
+
+        // a sync save, an async save of the same path and another server process never share a temp file
+        static std::atomic<uint32_t> next_temp_id{0};
+#ifdef _WIN32
+        const unsigned long process_id = GetCurrentProcessId();
+#else
+        const unsigned long process_id = static_cast<unsigned long>(getpid());
+#endif
+        std::string temp_path = std::string(path) + "." + std::to_string(process_id) + "." + std::to_string(next_temp_id.fetch_add(1)) + ".tmp";
+
+        auto fp = fopen(temp_path.c_str(), "wb");
+        if (!fp)
+        {
+            json_free_serialized_string(serialized);
+            return false;
+        }
+
+        auto length = strlen(serialized);
+        auto written = (fwrite(serialized, 1, length, fp) == length) && (fflush(fp) == 0);
+        json_free_serialized_string(serialized);
+
+#ifndef _WIN32
+        // the data must reach the disk before the rename does
+        if (sync_to_disk)
+        {
+            written = written && (fsync(fileno(fp)) == 0);
+        }
+#endif
+        written = (fclose(fp) == 0) && written;
+
+        if (written)
+        {
+#ifdef _WIN32
+            written = MoveFileExA(temp_path.c_str(), path, MOVEFILE_REPLACE_EXISTING | (sync_to_disk ? MOVEFILE_WRITE_THROUGH : 0)) != 0;
+#else
+            written = rename(temp_path.c_str(), path) == 0;
+#endif
+        }
+
+        if (!written)
+        {
+            remove(temp_path.c_str());
+        }
+
+        return written;
+    }
+}
@@ -0,0 +1,41 @@
+//
+// JSON file reading and writing that is safe to run on worker threads
+//
+#pragma once
+
+#include <parson.h>
+
+namespace AMXX
+{
+    /**
+     * @brief                  Parses a file that contains JSON.
+     *
+     * @note                   The file is read into one buffer by parson and parsed from that copy, so
+     *                         another process truncating or rewriting the file meanwhile can't crash the parse.
+     * @note                   Doesn't use any game thread state, so it can be called from a worker thread.
+     *
+     * @param path             Absolute path to the file
+     * @param with_comments    True if parsing JSON includes comments (it will ignore them), false otherwise
+     *
+     * @return                 Parsed value or nullptr if the file can't be read or contains invalid JSON
+     */
+    JSON_Value *JSONParseFile(const char *path, bool with_comments);
+
+    /**
+     * @brief                  Serializes value to the file.
+     *
+     * @note                   The data is written to a temporary file next to the target, named after the
+     *                         process and a counter, and then renamed over the target, so the file is never
+     *                         left half-written after a crash and concurrent saves don't clobber each other.
+     * @note                   Doesn't use any game thread state, so it can be called from a worker thread.
+     *
+     * @param value            Value to serialize
+     * @param path             Absolute path to the file
+     * @param pretty           True to format pretty JSON string, false to not
+     * @param sync_to_disk     True to flush the data to the disk before the rename, so the file also survives
+     *                         a power loss. Blocks until the disk write is done, meant for worker threads
+     *
+     * @return                 True if succeed, false otherwise
+     */
+    bool JSONSerialToFile(const JSON_Value *value, const char *path, bool pretty, bool sync_to_disk = false);
+}
@@ -12,6 +12,8 @@
 //
 
 #include "JsonMngr.h"
+#include "JsonFile.h"
+#include <utils/TraceLog.h>
 
 JSONMngr::~JSONMngr()
 {
@@ -22,93 +24,130 @@ JS_Handle JSONMngr::_MakeHandle(void *value, JSONHandleType type, bool must_be_f
 {
     JS_Handle id;
 
-    if (!m_OldHandles.empty())
+    if (m_FreeHead != -1)
     {
-        id = m_OldHandles.front();
-        m_OldHandles.pop_front();
+        id = m_FreeHead;
+        m_FreeHead = m_Handles[id].m_NextFree;
 
-        m_Handles[id] = std::make_unique<JSONHandle>();
+        if (m_FreeHead == -1)
+        {
+            m_FreeTail = -1;
+        }
     }
     else
     {
-        m_Handles.push_back(std::make_unique<JSONHandle>());
+        m_Handles.emplace_back();
         id = m_Handles.size() - 1;
     }
 
+    auto &handle = m_Handles[id];
+    handle.m_pValue = nullptr;
+    handle.m_pArray = nullptr;
+    handle.m_pObject = nullptr;
+
     switch (type)
     {
         case Handle_Value:
         {
-            auto getHandleType = [this](JSON_Value *jsvalue, JS_Handle id)
+            auto JSValue = handle.m_pValue = static_cast<JSON_Value *>(value);
+            if (!(handle.m_pArray = json_value_get_array(JSValue)))
             {
-                if (!(m_Handles[id]->m_pArray = json_value_get_array(jsvalue)))
-                {
-                    m_Handles[id]->m_pObject = json_value_get_object(jsvalue);
-                }
-            };
-
-            auto JSValue = m_Handles[id]->m_pValue = static_cast<JSON_Value *>(value);
-            getHandleType(JSValue, id);
+                handle.m_pObject = json_value_get_object(JSValue);
+            }
             break;
         }
         case Handle_Array:
         {
-            auto JSArray = m_Handles[id]->m_pArray = static_cast<JSON_Array *>(value);
-            m_Handles[id]->m_pValue = json_array_get_wrapping_value(JSArray);
+            auto JSArray = handle.m_pArray = static_cast<JSON_Array *>(value);
+            handle.m_pValue = json_array_get_wrapping_value(JSArray);
             break;
         }
         case Handle_Object:
         {
-            auto JSObject = m_Handles[id]->m_pObject = static_cast<JSON_Object *>(value);
-            m_Handles[id]->m_pValue = json_object_get_wrapping_value(JSObject);
+            auto JSObject = handle.m_pObject = static_cast<JSON_Object *>(value);
+            handle.m_pValue = json_object_get_wrapping_value(JSObject);
             break;
         }
     }
 
-    m_Handles[id]->m_bMustBeFreed = must_be_freed;
+    handle.m_bMustBeFreed = must_be_freed;
+    handle.m_bInUse = true;
+    handle.m_NextFree = -1;
+    handle.m_pOwner = m_pCurrentOwner;
+
+    auto &stats = m_OwnerStats[m_pCurrentOwner];
+    stats.m_Created++;
+    stats.m_Live++;
+    if (stats.m_Live > stats.m_Peak)
+    {
+        stats.m_Peak = stats.m_Live;
+    }
 
     return id;
 }
 
-void JSONMngr::_FreeHandle(std::unique_ptr<JSONHandle> &ptr)
+void JSONMngr::_FreeHandle(JSONHandle &handle)
 {
-    if (ptr->m_bMustBeFreed && ptr->m_pValue)
+    if (handle.m_bMustBeFreed && handle.m_pValue)
     {
-        json_value_free(ptr->m_pValue);
+        json_value_free(handle.m_pValue);
     }
 }
 
 void JSONMngr::Free(JS_Handle id)
 {
-    auto handle = std::move(m_Handles[id]);
+    auto &handle = m_Handles[id];
 
-    if (!handle)
+    if (!handle.m_bInUse)
     {
         return;
     }
 
     _FreeHandle(handle);
-    m_OldHandles.push_back(id);
+
+    auto stats = m_OwnerStats.find(handle.m_pOwner);
+    if (stats != m_OwnerStats.end())
+    {
+        stats->second.m_Freed++;
+        stats->second.m_Live--;
+    }
+
+    handle.m_bInUse = false;
+    handle.m_pValue = nullptr;
+    handle.m_pArray = nullptr;
+    handle.m_pObject = nullptr;
+    handle.m_NextFree = -1;
+
+    if (m_FreeTail != -1)
+    {
+        m_Handles[m_FreeTail].m_NextFree = id;
+    }
+    else
+    {
+        m_FreeHead = id;
+    }
+
+    m_FreeTail = id;
 }
 
 bool JSONMngr::IsValidHandle(JS_Handle handle, JSONHandleType type)
 {
-    if (handle >= m_Handles.size() || !m_Handles[handle])
+    if (handle < 0 || static_cast<size_t>(handle) >= m_Handles.size() || !m_Handles[handle].m_bInUse)
     {
         return false;
     }
 
     switch (type)
     {
-        case Handle_Array: return m_Handles[handle]->m_pArray != nullptr;
-        case Handle_Object: return m_Handles[handle]->m_pObject != nullptr;
+        case Handle_Array: return m_Handles[handle].m_pArray != nullptr;
+        case Handle_Object: return m_Handles[handle].m_pObject != nullptr;
         default: return true;
     }
 }
 
 bool JSONMngr::GetValueParent(JS_Handle value, JS_Handle *parent)
 {
-    auto JSParent = json_value_get_parent(m_Handles[value]->m_pValue);
+    auto JSParent = json_value_get_parent(m_Handles[value].m_pValue);
     if (!JSParent)
     {
         return false;
@@ -196,13 +235,16 @@ bool JSONMngr::InitNull(JS_Handle *handle)
 
 bool JSONMngr::Parse(const char *string, JS_Handle *handle, bool is_file, bool with_comments)
 {
-    auto jsonFunc = (!with_comments) ? json_parse_string : json_parse_string_with_comments;
+    JSON_Value *JSValue;
     if (is_file)
     {
-        jsonFunc = (!with_comments) ? json_parse_file : json_parse_file_with_comments;
+        JSValue = JSONParseFile(string, with_comments);
+    }
+    else
+    {
+        JSValue = (!with_comments) ? json_parse_string(string) : json_parse_string_with_comments(string);
     }
 
-    auto JSValue = jsonFunc(string);
     if (!JSValue)
     {
         return false;
@@ -214,7 +256,7 @@ bool JSONMngr::Parse(const char *string, JS_Handle *handle, bool is_file, bool w
 
 bool JSONMngr::DeepCopyValue(JS_Handle value, JS_Handle *handle)
 {
-    auto JSValue = json_value_deep_copy(m_Handles[value]->m_pValue);
+    auto JSValue = json_value_deep_copy(m_Handles[value].m_pValue);
     if (!JSValue)
     {
         return false;
@@ -224,15 +266,25 @@ bool JSONMngr::DeepCopyValue(JS_Handle value, JS_Handle *handle)
     return true;
 }
 
+JSON_Value *JSONMngr::CopyDetachedValue(JS_Handle value) const
+{
+    return json_value_deep_copy(m_Handles[value].m_pValue);
+}
+
+void JSONMngr::AdoptValue(JSON_Value *value, JS_Handle *handle)
+{
+    *handle = _MakeHandle(value, Handle_Value, true);
+}
+
 const char *JSONMngr::ValueToString(JS_Handle value)
 {
-    auto string = json_value_get_string(m_Handles[value]->m_pValue);
+    auto string = json_value_get_string(m_Handles[value].m_pValue);
     return (string) ? string : "";
 }
 
 bool JSONMngr::ArrayGetValue(JS_Handle array, size_t index, JS_Handle *handle)
 {
-    auto JSValue = json_array_get_value(m_Handles[array]->m_pArray, index);
+    auto JSValue = json_array_get_value(m_Handles[array].m_pArray, index);
     if (!JSValue)
     {
         return false;
@@ -244,13 +296,13 @@ bool JSONMngr::ArrayGetValue(JS_Handle array, size_t index, JS_Handle *handle)
 
 const char *JSONMngr::ArrayGetString(JS_Handle array, size_t index)
 {
-    auto string = json_array_get_string(m_Handles[array]->m_pArray, index);
+    auto string = json_array_get_string(m_Handles[array].m_pArray, index);
     return (string) ? string : "";
 }
 
 bool JSONMngr::ArrayReplaceValue(JS_Handle array, size_t index, JS_Handle value)
 {
-    auto JSValue = m_Handles[value]->m_pValue;
+    auto JSValue = m_Handles[value].m_pValue;
 
     //We cannot assign the same value to the different arrays or objects
     //So if value is already assigned somewhere else let's create a copy of it
@@ -261,14 +313,14 @@ bool JSONMngr::ArrayReplaceValue(JS_Handle array, size_t index, JS_Handle value)
     else
     {
         //Parson will take care of freeing child values
-        m_Handles[value]->m_bMustBeFreed = false;
+        m_Handles[value].m_bMustBeFreed = false;
     }
-    return json_array_replace_value(m_Handles[array]->m_pArray, index, JSValue) == JSONSuccess;
+    return json_array_replace_value(m_Handles[array].m_pArray, index, JSValue) == JSONSuccess;
 }
 
 bool JSONMngr::ArrayAppendValue(JS_Handle array, JS_Handle value)
 {
-    auto JSValue = m_Handles[value]->m_pValue;
+    auto JSValue = m_Handles[value].m_pValue;
 
     //We cannot assign the same value to the different arrays or objects
     //So if value is already assigned somewhere else let's create a copy of it
@@ -279,14 +331,14 @@ bool JSONMngr::ArrayAppendValue(JS_Handle array, JS_Handle value)
     else
     {
         //Parson will take care of freeing child values
-        m_Handles[value]->m_bMustBeFreed = false;
+        m_Handles[value].m_bMustBeFreed = false;
     }
-    return json_array_append_value(m_Handles[array]->m_pArray, JSValue) == JSONSuccess;
+    return json_array_append_value(m_Handles[array].m_pArray, JSValue) == JSONSuccess;
 }
 
 bool JSONMngr::ObjectGetValue(JS_Handle object, const char *name, JS_Handle *handle, bool dotfunc)
 {
-    auto JSObject = m_Handles[object]->m_pObject;
+    auto JSObject = m_Handles[object].m_pObject;
     auto JSValue = (!dotfunc) ? json_object_get_value(JSObject, name) :
                    json_object_dotget_value(JSObject, name);
 
@@ -301,7 +353,7 @@ bool JSONMngr::ObjectGetValue(JS_Handle object, const char *name, JS_Handle *han
 
 const char *JSONMngr::ObjectGetString(JS_Handle object, const char *name, bool dotfunc)
 {
-    auto JSObject = m_Handles[object]->m_pObject;
+    auto JSObject = m_Handles[object].m_pObject;
     auto string = (!dotfunc) ? json_object_get_string(JSObject, name) :
                   json_object_dotget_string(JSObject, name);
 
@@ -310,14 +362,14 @@ const char *JSONMngr::ObjectGetString(JS_Handle object, const char *name, bool d
 
 double JSONMngr::ObjectGetNum(JS_Handle object, const char *name, bool dotfunc)
 {
-    auto JSObject = m_Handles[object]->m_pObject;
+    auto JSObject = m_Handles[object].m_pObject;
     return (!dotfunc) ? json_object_get_number(JSObject, name) :
            json_object_dotget_number(JSObject, name);
 }
 
 bool JSONMngr::ObjectGetBool(JS_Handle object, const char *name, bool dotfunc)
 {
-    auto JSObject = m_Handles[object]->m_pObject;
+    auto JSObject = m_Handles[object].m_pObject;
     auto result = (!dotfunc) ? json_object_get_boolean(JSObject, name) :
                   json_object_dotget_boolean(JSObject, name);
 
@@ -326,13 +378,13 @@ bool JSONMngr::ObjectGetBool(JS_Handle object, const char *name, bool dotfunc)
 
 const char *JSONMngr::ObjectGetName(JS_Handle object, size_t index)
 {
-    auto string = json_object_get_name(m_Handles[object]->m_pObject, index);
+    auto string = json_object_get_name(m_Handles[object].m_pObject, index);
     return (string) ? string : "";
 }
 
 bool JSONMngr::ObjectGetValueAt(JS_Handle object, size_t index, JS_Handle *handle)
 {
-    auto JSValue = json_object_get_value_at(m_Handles[object]->m_pObject, index);
+    auto JSValue = json_object_get_value_at(m_Handles[object].m_pObject, index);
     if (!JSValue)
     {
         return false;
@@ -345,7 +397,7 @@ bool JSONMngr::ObjectGetValueAt(JS_Handle object, size_t index, JS_Handle *handl
 bool JSONMngr::ObjectHasValue(JS_Handle object, const char *name, JSONType type, bool dotfunc)
 {
     int result;
-    auto JSObject = m_Handles[object]->m_pObject;
+    auto JSObject = m_Handles[object].m_pObject;
 
     if (type == JSONTypeError)
     {
@@ -362,7 +414,7 @@ bool JSONMngr::ObjectHasValue(JS_Handle object, const char *name, JSONType type,
 
 bool JSONMngr::ObjectSetValue(JS_Handle object, const char *name, JS_Handle value, bool dotfunc)
 {
-    auto JSValue = m_Handles[value]->m_pValue;
+    auto JSValue = m_Handles[value].m_pValue;
 
     //We cannot assign the same value to the different arrays or objects
     //So if value is already assigned somewhere else let's create a copy of it
@@ -373,10 +425,10 @@ bool JSONMngr::ObjectSetValue(JS_Handle object, const char *name, JS_Handle valu
     else
     {
         //Parson will take care of freeing child values
-        m_Handles[value]->m_bMustBeFreed = false;
+        m_Handles[value].m_bMustBeFreed = false;
     }
 
-    auto JSObject = m_Handles[object]->m_pObject;
+    auto JSObject = m_Handles[object].m_pObject;
     auto JSResult = (!dotfunc) ? json_object_set_value(JSObject, name, JSValue) :
                     json_object_dotset_value(JSObject, name, JSValue);
 
@@ -385,7 +437,7 @@ bool JSONMngr::ObjectSetValue(JS_Handle object, const char *name, JS_Handle valu
 
 bool JSONMngr::ObjectSetString(JS_Handle object, const char *name, const char *string, bool dotfunc)
 {
-    auto JSObject = m_Handles[object]->m_pObject;
+    auto JSObject = m_Handles[object].m_pObject;
     auto JSResult = (!dotfunc) ? json_object_set_string(JSObject, name, string) :
                     json_object_dotset_string(JSObject, name, string);
 
@@ -394,7 +446,7 @@ bool JSONMngr::ObjectSetString(JS_Handle object, const char *name, const char *s
 
 bool JSONMngr::ObjectSetNum(JS_Handle object, const char *name, double number, bool dotfunc)
 {
-    auto JSObject = m_Handles[object]->m_pObject;
+    auto JSObject = m_Handles[object].m_pObject;
     auto JSResult = (!dotfunc) ? json_object_set_number(JSObject, name, number) :
                     json_object_dotset_number(JSObject, name, number);
 
@@ -403,7 +455,7 @@ bool JSONMngr::ObjectSetNum(JS_Handle object, const char *name, double number, b
 
 bool JSONMngr::ObjectSetBool(JS_Handle object, const char *name, bool boolean, bool dotfunc)
 {
-    auto JSObject = m_Handles[object]->m_pObject;
+    auto JSObject = m_Handles[object].m_pObject;
     auto JSResult = (!dotfunc) ? json_object_set_boolean(JSObject, name, boolean) :
                     json_object_dotset_boolean(JSObject, name, boolean);
 
@@ -412,7 +464,7 @@ bool JSONMngr::ObjectSetBool(JS_Handle object, const char *name, bool boolean, b
 
 bool JSONMngr::ObjectSetNull(JS_Handle object, const char *name, bool dotfunc)
 {
-    auto JSObject = m_Handles[object]->m_pObject;
+    auto JSObject = m_Handles[object].m_pObject;
     auto JSResult = (!dotfunc) ? json_object_set_null(JSObject, name) :
                     json_object_dotset_null(JSObject, name);
 
@@ -421,7 +473,7 @@ bool JSONMngr::ObjectSetNull(JS_Handle object, const char *name, bool dotfunc)
 
 bool JSONMngr::ObjectRemove(JS_Handle object, const char *name, bool dotfunc)
 {
-    auto JSObject = m_Handles[object]->m_pObject;
+    auto JSObject = m_Handles[object].m_pObject;
     auto JSResult = (!dotfunc) ? json_object_remove(JSObject, name) :
                     json_object_dotremove(JSObject, name);
 
@@ -430,14 +482,14 @@ bool JSONMngr::ObjectRemove(JS_Handle object, const char *name, bool dotfunc)
 
 size_t JSONMngr::SerialSize(JS_Handle value, bool pretty)
 {
-    auto JSValue = m_Handles[value]->m_pValue;
+    auto JSValue = m_Handles[value].m_pValue;
     return (!pretty) ? json_serialization_size(JSValue) :
            json_serialization_size_pretty(JSValue);
 }
 
 bool JSONMngr::SerialToBuffer(JS_Handle value, char *buffer, size_t size, bool pretty)
 {
-    auto JSValue = m_Handles[value]->m_pValue;
+    auto JSValue = m_Handles[value].m_pValue;
     auto JSResult = (!pretty) ? json_serialize_to_buffer(JSValue, buffer, size) :
                     json_serialize_to_buffer_pretty(JSValue, buffer, size);
 
@@ -446,16 +498,12 @@ bool JSONMngr::SerialToBuffer(JS_Handle value, char *buffer, size_t size, bool p
 
 bool JSONMngr::SerialToFile(JS_Handle value, const char *filepath, bool pretty)
 {
-    auto JSValue = m_Handles[value]->m_pValue;
-    auto JSResult = (!pretty) ? json_serialize_to_file(JSValue, filepath) :
-                    json_serialize_to_file_pretty(JSValue, filepath);
-
-    return JSResult == JSONSuccess;
+    return JSONSerialToFile(m_Handles[value].m_pValue, filepath, pretty);
 }
 
 char *JSONMngr::SerialToString(JS_Handle value, bool pretty)
 {
-    auto JSValue = m_Handles[value]->m_pValue;
+    auto JSValue = m_Handles[value].m_pValue;
     auto result = (!pretty) ? json_serialize_to_string(JSValue) :
                   json_serialize_to_string_pretty(JSValue);
 
@@ -466,12 +514,79 @@ void JSONMngr::FreeAllHandles()
 {
     for (auto &i : m_Handles)
     {
-        if (i)
+        if (i.m_bInUse)
         {
             _FreeHandle(i);
         }
     }
 
+    for (auto &i : m_OwnerStats)
+    {
+        if (i.second.m_Live == 0 || !ezhttp::trace::IsEnabled())
+        {
+            continue;
+        }
+
+        auto pluginId = (i.first) ? MF_FindScriptByAmx(i.first) : -1;
+        ezhttp::trace::Writef("JSONMngr", "FreeAllHandles plugin=%s leaked=%zu created=%zu freed=%zu peak=%zu",
+                              (pluginId != -1) ? MF_GetScriptName(pluginId) : "<module>",
+                              i.second.m_Live, i.second.m_Created, i.second.m_Freed, i.second.m_Peak);
+    }
+
+    // keep the capacity so the pool does not have to grow again on the next map
     m_Handles.clear();
-    m_OldHandles.clear();
+    m_FreeHead = -1;
+    m_FreeTail = -1;
+
+    m_OwnerStats.clear();
+    m_pCurrentOwner = nullptr;
+}
+
+const JSONMngr::JSONOwnerStats *JSONMngr::GetOwnerStats(AMX *amx) const
+{
+    auto stats = m_OwnerStats.find(amx);
+    return (stats != m_OwnerStats.end()) ? &stats->second : nullptr;
+}
+
+size_t JSONMngr::FreeOwnerHandles(AMX *amx)
+{
+    size_t freed = 0;
+
+    for (size_t i = 0; i < m_Handles.size(); i++)
+    {
+        if (m_Handles[i].m_bInUse && m_Handles[i].m_pOwner == amx)
+        {
+            Free(static_cast<JS_Handle>(i));
+            freed++;
+        }
+    }
+
+    return freed;
+}
+
+size_t JSONMngr::GetOwnerBytes(AMX *amx)
+{
+    size_t bytes = 0;
+
+    for (auto &i : m_Handles)
+    {
+        // handles that do not have to be freed point inside a tree that is accounted to its root
+        if (i.m_bInUse && i.m_bMustBeFreed && i.m_pOwner == amx && i.m_pValue)
+        {
+            bytes += json_serialization_size(i.m_pValue);
+        }
+    }
+
+    return bytes;
+}
+
+bool JSONMngr::IsOwnerAtLimit(AMX *amx) const
+{
+    if (!m_MaxHandlesPerOwner)
+    {
+        return false;
+    }
+
+    auto stats = GetOwnerStats(amx);
+    return stats && stats->m_Live >= m_MaxHandlesPerOwner;
 }
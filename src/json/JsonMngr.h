@@ -16,7 +16,7 @@
 
 #include <memory>
 #include <vector>
-#include <deque>
+#include <unordered_map>
 
 #include <sdk/amxxmodule.h>
 #include <parson.h>
@@ -35,7 +35,7 @@ public:
     void Free(JS_Handle id) override;
     inline JSONType GetHandleJSONType(JS_Handle value) override
     {
-        return static_cast<JSONType>(json_value_get_type(m_Handles[value]->m_pValue));
+        return static_cast<JSONType>(json_value_get_type(m_Handles[value].m_pValue));
     }
 
     // Parsing
@@ -45,13 +45,13 @@ public:
     inline bool AreValuesEquals(JS_Handle value1, JS_Handle value2) override
     {
         // to avoid ms compiler warning
-        return json_value_equals(m_Handles[value1]->m_pValue, m_Handles[value2]->m_pValue) == 1;
+        return json_value_equals(m_Handles[value1].m_pValue, m_Handles[value2].m_pValue) == 1;
     }
 
     // Validating
     inline bool IsValueValid(JS_Handle schema, JS_Handle value) override
     {
-        return json_validate(m_Handles[schema]->m_pValue, m_Handles[value]->m_pValue) == JSONSuccess;
+        return json_validate(m_Handles[schema].m_pValue, m_Handles[value].m_pValue) == JSONSuccess;
     }
 
     // Accessing parent value
@@ -72,11 +72,11 @@ public:
     const char *ValueToString(JS_Handle value) override;
     inline double ValueToNum(JS_Handle value) override
     {
-        return json_value_get_number(m_Handles[value]->m_pValue);
+        return json_value_get_number(m_Handles[value].m_pValue);
     }
     inline bool ValueToBool(JS_Handle value) override
     {
-        return json_value_get_boolean(m_Handles[value]->m_pValue) == 1;
+        return json_value_get_boolean(m_Handles[value].m_pValue) == 1;
     }
 
     // Wrappers for Array API
@@ -84,58 +84,58 @@ public:
     const char *ArrayGetString(JS_Handle array, size_t index) override;
     inline bool ArrayGetBool(JS_Handle array, size_t index) override
     {
-        return json_array_get_boolean(m_Handles[array]->m_pArray, index) == 1;
+        return json_array_get_boolean(m_Handles[array].m_pArray, index) == 1;
     }
     bool ArrayReplaceValue(JS_Handle array, size_t index, JS_Handle value) override;
     bool ArrayAppendValue(JS_Handle array, JS_Handle value) override;
 
     inline double ArrayGetNum(JS_Handle array, size_t index) override
     {
-        return json_array_get_number(m_Handles[array]->m_pArray, index);
+        return json_array_get_number(m_Handles[array].m_pArray, index);
     }
     inline size_t ArrayGetCount(JS_Handle array) override
     {
-        return json_array_get_count(m_Handles[array]->m_pArray);
+        return json_array_get_count(m_Handles[array].m_pArray);
     }
     inline bool ArrayReplaceString(JS_Handle array, size_t index, const char *string) override
     {
-        return json_array_replace_string(m_Handles[array]->m_pArray, index, string) == JSONSuccess;
+        return json_array_replace_string(m_Handles[array].m_pArray, index, string) == JSONSuccess;
     }
     inline bool ArrayReplaceNum(JS_Handle array, size_t index, double number) override
     {
-        return json_array_replace_number(m_Handles[array]->m_pArray, index, number) == JSONSuccess;
+        return json_array_replace_number(m_Handles[array].m_pArray, index, number) == JSONSuccess;
     }
     inline bool ArrayReplaceBool(JS_Handle array, size_t index, bool boolean) override
     {
-        return json_array_replace_boolean(m_Handles[array]->m_pArray, index, boolean) == JSONSuccess;
+        return json_array_replace_boolean(m_Handles[array].m_pArray, index, boolean) == JSONSuccess;
     }
     inline bool ArrayReplaceNull(JS_Handle array, size_t index) override
     {
-        return json_array_replace_null(m_Handles[array]->m_pArray, index) == JSONSuccess;
+        return json_array_replace_null(m_Handles[array].m_pArray, index) == JSONSuccess;
     }
     inline bool ArrayAppendString(JS_Handle array, const char *string) override
     {
-        return json_array_append_string(m_Handles[array]->m_pArray, string) == JSONSuccess;
+        return json_array_append_string(m_Handles[array].m_pArray, string) == JSONSuccess;
     }
     inline bool ArrayAppendNum(JS_Handle array, double number) override
     {
-        return json_array_append_number(m_Handles[array]->m_pArray, number) == JSONSuccess;
+        return json_array_append_number(m_Handles[array].m_pArray, number) == JSONSuccess;
     }
     inline bool ArrayAppendBool(JS_Handle array, bool boolean) override
     {
-        return json_array_append_boolean(m_Handles[array]->m_pArray, boolean) == JSONSuccess;
+        return json_array_append_boolean(m_Handles[array].m_pArray, boolean) == JSONSuccess;
     }
     inline bool ArrayAppendNull(JS_Handle array) override
     {
-        return json_array_append_null(m_Handles[array]->m_pArray) == JSONSuccess;
+        return json_array_append_null(m_Handles[array].m_pArray) == JSONSuccess;
     }
     inline bool ArrayRemove(JS_Handle array, size_t index) override
     {
-        return json_array_remove(m_Handles[array]->m_pArray, index) == JSONSuccess;
+        return json_array_remove(m_Handles[array].m_pArray, index) == JSONSuccess;
     }
     inline bool ArrayClear(JS_Handle array) override
     {
-        return json_array_clear(m_Handles[array]->m_pArray) == JSONSuccess;
+        return json_array_clear(m_Handles[array].m_pArray) == JSONSuccess;
     }
 
     // Wrappers for Object API
@@ -147,7 +147,7 @@ public:
     bool ObjectGetBool(JS_Handle object, const char *name, bool dotfunc) override;
     inline size_t ObjectGetCount(JS_Handle object) override
     {
-        return json_object_get_count(m_Handles[object]->m_pObject);
+        return json_object_get_count(m_Handles[object].m_pObject);
     }
     const char *ObjectGetName(JS_Handle object, size_t index) override;
     bool ObjectGetValueAt(JS_Handle object, size_t index, JS_Handle *handle) override;
@@ -164,7 +164,7 @@ public:
     bool ObjectRemove(JS_Handle object, const char *name, bool dotfunc) override;
     inline bool ObjectClear(JS_Handle object) override
     {
-        return json_object_clear(m_Handles[object]->m_pObject) == JSONSuccess;
+        return json_object_clear(m_Handles[object].m_pObject) == JSONSuccess;
     }
 
     // Serialization API
@@ -179,6 +179,48 @@ public:
 
     virtual void FreeAllHandles() override;
 
+    // Handle accounting per plugin
+    struct JSONOwnerStats
+    {
+        size_t m_Created = 0;           //Handles created since the last FreeAllHandles()
+        size_t m_Freed = 0;             //Handles released explicitly via Free()
+        size_t m_Live = 0;              //Handles currently alive
+        size_t m_Peak = 0;              //Maximum of m_Live
+    };
+
+    // Handles created after this call are accounted to the passed plugin
+    inline void SetOwner(AMX *amx)
+    {
+        m_pCurrentOwner = amx;
+    }
+    const JSONOwnerStats *GetOwnerStats(AMX *amx) const;
+    inline const std::unordered_map<AMX *, JSONOwnerStats> &GetAllOwnerStats() const
+    {
+        return m_OwnerStats;
+    }
+
+    // Frees every handle created by the plugin, returns the number of freed handles
+    size_t FreeOwnerHandles(AMX *amx);
+
+    // Serialized size of the values whose lifetime is controlled by the plugin's handles
+    size_t GetOwnerBytes(AMX *amx);
+
+    // Maximum of live handles per plugin, 0 means unlimited
+    inline void SetMaxHandlesPerOwner(size_t max_handles)
+    {
+        m_MaxHandlesPerOwner = max_handles;
+    }
+    inline size_t GetMaxHandlesPerOwner() const
+    {
+        return m_MaxHandlesPerOwner;
+    }
+    bool IsOwnerAtLimit(AMX *amx) const;
+
+    // Detached values are not bound to any handle, so they can be handed to worker threads.
+    // Copy must be freed using json_value_free(), adopted value is freed with its handle
+    JSON_Value *CopyDetachedValue(JS_Handle value) const;
+    void AdoptValue(JSON_Value *value, JS_Handle *handle);
+
 private:
 
     struct JSONHandle
@@ -187,11 +229,21 @@ private:
         JSON_Array  *m_pArray;          //Store an pointer to an array
         JSON_Object *m_pObject;         //Store an pointer to an object
         bool         m_bMustBeFreed;    //Must be freed using json_value_free()?
+        bool         m_bInUse;          //Is the pool slot taken by a live handle?
+        JS_Handle    m_NextFree;        //Next slot in the free-list (valid only when not in use)
+        AMX         *m_pOwner;          //Plugin that created the handle
     };
 
     JS_Handle _MakeHandle(void *value, JSONHandleType type, bool must_be_freed = false);
-    void _FreeHandle(std::unique_ptr<JSONHandle> &ptr);
+    void _FreeHandle(JSONHandle &handle);
+
+    // Slots are stored inline and recycled through an intrusive FIFO free-list,
+    // so creating a handle does not allocate once the pool has grown
+    std::vector<JSONHandle> m_Handles;
+    JS_Handle m_FreeHead = -1;
+    JS_Handle m_FreeTail = -1;
 
-    std::vector<std::unique_ptr<JSONHandle>> m_Handles;
-    std::deque<JS_Handle> m_OldHandles;
+    AMX *m_pCurrentOwner = nullptr;
+    std::unordered_map<AMX *, JSONOwnerStats> m_OwnerStats;
+    size_t m_MaxHandlesPerOwner = 0;
 };
@@ -12,9 +12,24 @@
 //
 
 #include "JsonMngr.h"
+#include "JsonAsyncIO.h"
 #include <utils/amxx_utils.h>
 
 extern std::unique_ptr<JSONMngr> g_JsonManager;
+extern std::unique_ptr<JSONAsyncIO> g_JsonAsyncIO;
+
+bool SetJsonHandleOwner(AMX *amx)
+{
+    if (g_JsonManager->IsOwnerAtLimit(amx))
+    {
+        MF_LogError(amx, AMX_ERR_NATIVE, "JSON handle limit reached (%d)! Free unused handles or raise ezjson_max_handles",
+                    static_cast<int>(g_JsonManager->GetMaxHandlesPerOwner()));
+        return false;
+    }
+
+    g_JsonManager->SetOwner(amx);
+    return true;
+}
 
 //native JSON:json_parse(const string[], bool:is_file = false, bool:with_comments = false);
 static cell AMX_NATIVE_CALL amxx_json_parse(AMX *amx, cell *params)
@@ -30,11 +45,62 @@ static cell AMX_NATIVE_CALL amxx_json_parse(AMX *amx, cell *params)
     }
 
     JS_Handle handle;
+    if (!SetJsonHandleOwner(amx))
+    {
+        return -1;
+    }
+
     auto result = g_JsonManager->Parse(string, &handle, is_file, params[3] != 0);
 
     return (result) ? handle : -1;
 }
 
+// Registers the forward of an async file native and copies its data, returns false on error
+static bool PrepareFileCallback(AMX *amx, cell callback_param, cell data_param, cell data_len, int *callback_id, std::unique_ptr<cell[]> *data)
+{
+    int len;
+    auto callback = MF_GetAmxString(amx, callback_param, 1, &len);
+
+    *callback_id = (data_len > 0) ? MF_RegisterSPForwardByName(amx, callback, FP_CELL, FP_ARRAY, FP_DONE) :
+                                    MF_RegisterSPForwardByName(amx, callback, FP_CELL, FP_DONE);
+    if (*callback_id == -1)
+    {
+        MF_LogError(amx, AMX_ERR_NATIVE, "Callback function \"%s\" is not exists", callback);
+        return false;
+    }
+
+    if (data_len > 0)
+    {
+        *data = std::make_unique<cell[]>(data_len);
+        MF_CopyAmxMemory(data->get(), MF_GetAmxAddr(amx, data_param), data_len);
+    }
+
+    return true;
+}
+
+//native ezjson_parse_file_async(const file[], const callback[], bool:with_comments = false, const data[] = "", data_len = 0);
+static cell AMX_NATIVE_CALL amxx_json_parse_file_async(AMX *amx, cell *params)
+{
+    if (!SetJsonHandleOwner(amx))
+    {
+        return 0;
+    }
+
+    int len;
+    char path[256];
+    MF_BuildPathnameR(path, sizeof(path), "%s", MF_GetAmxString(amx, params[1], 0, &len));
+
+    int callback_id;
+    std::unique_ptr<cell[]> data;
+    if (!PrepareFileCallback(amx, params[2], params[4], params[5], &callback_id, &data))
+    {
+        return 0;
+    }
+
+    g_JsonAsyncIO->ParseFile(amx, path, params[3] != 0, callback_id, std::move(data), params[5]);
+    return 1;
+}
+
 //native bool:json_equals(const JSON:value1, const JSON:value2);
 static cell AMX_NATIVE_CALL amxx_json_equals(AMX *amx, cell *params)
 {
@@ -90,6 +156,11 @@ static cell AMX_NATIVE_CALL amxx_json_get_parent(AMX *amx, cell *params)
     }
 
     JS_Handle parent;
+    if (!SetJsonHandleOwner(amx))
+    {
+        return -1;
+    }
+
     auto result = g_JsonManager->GetValueParent(value, &parent);
 
     return (result) ? parent : -1;
@@ -112,6 +183,11 @@ static cell AMX_NATIVE_CALL amxx_json_get_type(AMX *amx, cell *params)
 static cell AMX_NATIVE_CALL amxx_json_init_object(AMX *amx, cell *params)
 {
     JS_Handle handle;
+    if (!SetJsonHandleOwner(amx))
+    {
+        return -1;
+    }
+
     auto result = g_JsonManager->InitObject(&handle);
 
     return (result) ? handle : -1;
@@ -121,6 +197,11 @@ static cell AMX_NATIVE_CALL amxx_json_init_object(AMX *amx, cell *params)
 static cell AMX_NATIVE_CALL amxx_json_init_array(AMX *amx, cell *params)
 {
     JS_Handle handle;
+    if (!SetJsonHandleOwner(amx))
+    {
+        return -1;
+    }
+
     auto result = g_JsonManager->InitArray(&handle);
 
     return (result) ? handle : -1;
@@ -131,6 +212,11 @@ static cell AMX_NATIVE_CALL amxx_json_init_string(AMX *amx, cell *params)
 {
     int len;
     JS_Handle handle;
+    if (!SetJsonHandleOwner(amx))
+    {
+        return -1;
+    }
+
     auto result = g_JsonManager->InitString(MF_GetAmxString(amx, params[1], 0, &len), &handle);
 
     return (result) ? handle : -1;
@@ -140,6 +226,11 @@ static cell AMX_NATIVE_CALL amxx_json_init_string(AMX *amx, cell *params)
 static cell AMX_NATIVE_CALL amxx_json_init_number(AMX *amx, cell *params)
 {
     JS_Handle handle;
+    if (!SetJsonHandleOwner(amx))
+    {
+        return -1;
+    }
+
     auto result = g_JsonManager->InitNum(params[1], &handle);
 
     return (result) ? handle : -1;
@@ -149,6 +240,11 @@ static cell AMX_NATIVE_CALL amxx_json_init_number(AMX *amx, cell *params)
 static cell AMX_NATIVE_CALL amxx_json_init_real(AMX *amx, cell *params)
 {
     JS_Handle handle;
+    if (!SetJsonHandleOwner(amx))
+    {
+        return -1;
+    }
+
     auto result = g_JsonManager->InitNum(amx_ctof(params[1]), &handle);
 
     return (result) ? handle : -1;
@@ -158,6 +254,11 @@ static cell AMX_NATIVE_CALL amxx_json_init_real(AMX *amx, cell *params)
 static cell AMX_NATIVE_CALL amxx_json_init_bool(AMX *amx, cell *params)
 {
     JS_Handle handle;
+    if (!SetJsonHandleOwner(amx))
+    {
+        return -1;
+    }
+
     auto result = g_JsonManager->InitBool(params[1] != 0, &handle);
 
     return (result) ? handle : -1;
@@ -167,6 +268,11 @@ static cell AMX_NATIVE_CALL amxx_json_init_bool(AMX *amx, cell *params)
 static cell AMX_NATIVE_CALL amxx_json_init_null(AMX *amx, cell *params)
 {
     JS_Handle handle;
+    if (!SetJsonHandleOwner(amx))
+    {
+        return -1;
+    }
+
     auto result = g_JsonManager->InitNull(&handle);
 
     return (result) ? handle : -1;
@@ -183,6 +289,11 @@ static cell AMX_NATIVE_CALL amxx_json_deep_copy(AMX *amx, cell *params)
     }
 
     JS_Handle clonedHandle;
+    if (!SetJsonHandleOwner(amx))
+    {
+        return -1;
+    }
+
     auto result = g_JsonManager->DeepCopyValue(value, &clonedHandle);
 
     return (result) ? clonedHandle : -1;
@@ -204,6 +315,12 @@ static cell AMX_NATIVE_CALL amxx_json_free(AMX *amx, cell *params)
     return 1;
 }
 
+//native json_free_all();
+static cell AMX_NATIVE_CALL amxx_json_free_all(AMX *amx, cell *params)
+{
+    return g_JsonManager->FreeOwnerHandles(amx);
+}
+
 //native json_get_string(const JSON:value, buffer[], maxlen);
 static cell AMX_NATIVE_CALL amxx_json_get_string(AMX *amx, cell *params)
 {
@@ -271,6 +388,11 @@ static cell AMX_NATIVE_CALL amxx_json_array_get_value(AMX *amx, cell *params)
     }
 
     JS_Handle handle;
+    if (!SetJsonHandleOwner(amx))
+    {
+        return -1;
+    }
+
     auto result = g_JsonManager->ArrayGetValue(array, params[2], &handle);
 
     return (result) ? handle : -1;
@@ -557,6 +679,11 @@ static cell AMX_NATIVE_CALL amxx_json_object_get_value(AMX *amx, cell *params)
     auto name = MF_GetAmxString(amx, params[2], 0, &len);
 
     JS_Handle handle;
+    if (!SetJsonHandleOwner(amx))
+    {
+        return -1;
+    }
+
     auto result = g_JsonManager->ObjectGetValue(object, name, &handle, params[3] != 0);
 
     return (result) ? handle : -1;
@@ -667,6 +794,11 @@ static cell AMX_NATIVE_CALL amxx_json_object_get_value_at(AMX *amx, cell *params
     }
 
     JS_Handle valueHandle;
+    if (!SetJsonHandleOwner(amx))
+    {
+        return -1;
+    }
+
     auto result = g_JsonManager->ObjectGetValueAt(object, params[2], &valueHandle);
 
     return (result) ? valueHandle : -1;
@@ -872,9 +1004,47 @@ static cell AMX_NATIVE_CALL amxx_json_serial_to_file(AMX *amx, cell *params)
     return g_JsonManager->SerialToFile(value, path, params[3] != 0);
 }
 
+//native bool:ezjson_serial_to_file_async(const EzJSON:value, const file[], bool:pretty = false, const callback[] = "", const data[] = "", data_len = 0);
+static cell AMX_NATIVE_CALL amxx_json_serial_to_file_async(AMX *amx, cell *params)
+{
+    auto value = params[1];
+    if (!g_JsonManager->IsValidHandle(value))
+    {
+        MF_LogError(amx, AMX_ERR_NATIVE, "Invalid JSON value! %d", value);
+        return 0;
+    }
+
+    int len;
+    char path[256];
+    MF_BuildPathnameR(path, sizeof(path), "%s", MF_GetAmxString(amx, params[2], 0, &len));
+
+    int callback_id = -1;
+    std::unique_ptr<cell[]> data;
+    MF_GetAmxString(amx, params[4], 1, &len);
+    if (len > 0 && !PrepareFileCallback(amx, params[4], params[5], params[6], &callback_id, &data))
+    {
+        return 0;
+    }
+
+    // the plugin may change or free the value right after this call
+    auto JSValue = g_JsonManager->CopyDetachedValue(value);
+    if (!JSValue)
+    {
+        if (callback_id != -1)
+        {
+            MF_UnregisterSPForward(callback_id);
+        }
+        return 0;
+    }
+
+    g_JsonAsyncIO->SerialToFile(amx, path, JSValue, params[3] != 0, callback_id, std::move(data), params[6]);
+    return 1;
+}
+
 AMX_NATIVE_INFO g_JsonNatives[] =
 {
     { "ezjson_parse",                     amxx_json_parse },
+    { "ezjson_parse_file_async",          amxx_json_parse_file_async },
     { "ezjson_equals",                    amxx_json_equals },
     { "ezjson_validate",                  amxx_json_validate },
     { "ezjson_get_parent",                amxx_json_get_parent },
@@ -888,6 +1058,7 @@ AMX_NATIVE_INFO g_JsonNatives[] =
     { "ezjson_init_null",                 amxx_json_init_null },
     { "ezjson_deep_copy",                 amxx_json_deep_copy },
     { "ezjson_free",                      amxx_json_free },
+    { "ezjson_free_all",                  amxx_json_free_all },
     { "ezjson_get_string",                amxx_json_get_string },
     { "ezjson_get_number",                amxx_json_get_number },
     { "ezjson_get_real",                  amxx_json_get_real },
@@ -932,5 +1103,6 @@ AMX_NATIVE_INFO g_JsonNatives[] =
     { "ezjson_serial_size",               amxx_json_serial_size },
     { "ezjson_serial_to_string",          amxx_json_serial_to_string },
     { "ezjson_serial_to_file",            amxx_json_serial_to_file },
+    { "ezjson_serial_to_file_async",      amxx_json_serial_to_file_async },
     { nullptr,                            nullptr }
 };
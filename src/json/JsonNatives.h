@@ -3,3 +3,6 @@
 #include <sdk/amxxmodule.h>
 
 extern AMX_NATIVE_INFO g_JsonNatives[];
+
+// Accounts handles created by the calling native to the plugin, fails if the plugin reached ezjson_max_handles
+bool SetJsonHandleOwner(AMX *amx);
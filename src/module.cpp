@@ -8,6 +8,8 @@
 #include "EasyHttpModule.h"
 #include "json/JsonMngr.h"
 #include "json/JsonNatives.h"
+#include "json/JsonBinary.h"
+#include "json/JsonAsyncIO.h"
 #include "utils/ftp_utils.h"
 #include "utils/string_utils.h"
 #include "utils/amxx_utils.h"
@@ -18,9 +20,16 @@ using namespace ezhttp;
 bool ValidateOptionsId(AMX *amx, OptionsId options_id);
 bool ValidateRequestId(AMX *amx, RequestId request_id);
 bool ValidateQueueId(AMX *amx, QueueId queue_id);
+bool ValidateBatchId(AMX *amx, BatchId batch_id);
+bool ValidateTemplateId(AMX *amx, TemplateId template_id);
+bool ValidateHttpMethod(AMX *amx, RequestMethod method);
 bool ValidatePluginEndBehaviour(AMX *amx, PluginEndBehaviour plugin_end_behaviour);
+bool ValidatePriority(AMX *amx, RequestPriority priority);
 bool ValidateFtpSecurity(AMX *amx, cell security_value);
 bool ValidateDispatchOptions(AMX *amx, const OptionsData &options);
+bool ValidateRateLimit(AMX *amx, float requests_per_second, int burst);
+bool ValidateIpVersion(AMX *amx, IpVersion ip_version);
+bool ValidateConnectPolicy(AMX *amx, IpVersion ip_version, int happy_eyeballs_timeout_ms);
 template <class TMethod>
 void SetKeyValueOption(AMX *amx, cell *params, TMethod method);
 template <class TMethod>
@@ -40,17 +49,80 @@ RequestId DispatchRequest(
 
 std::unique_ptr<EasyHttpModule> g_EasyHttpModule;
 std::unique_ptr<JSONMngr> g_JsonManager;
+std::unique_ptr<JSONAsyncIO> g_JsonAsyncIO;
 bool g_MapChangeResetDone = false;
 
 namespace
 {
     cvar_t cvar_ezhttp_trace = {"ezhttp_trace_log", "0", FCVAR_SERVER | FCVAR_SPONLY};
+    cvar_t cvar_ezjson_max_handles = {"ezjson_max_handles", "0", FCVAR_SERVER | FCVAR_SPONLY};
 
     void RefreshTraceLogSetting()
     {
         ezhttp::trace::SetEnabled(CVAR_GET_FLOAT("ezhttp_trace_log") != 0.0f);
     }
 
+    void RefreshJsonLimitSetting()
+    {
+        if (g_JsonManager)
+            g_JsonManager->SetMaxHandlesPerOwner(static_cast<size_t>(std::max(0.0f, CVAR_GET_FLOAT("ezjson_max_handles"))));
+    }
+
+    // Tree decoded by the worker thread, waits in Response::decoded_body until a plugin takes it
+    struct DecodedJsonBody
+    {
+        JSONBinaryFormat format;
+        JSON_Value *value;
+
+        ~DecodedJsonBody()
+        {
+            if (value)
+                json_value_free(value);
+        }
+    };
+
+    bool ValidateBinaryFormat(AMX *amx, cell format)
+    {
+        if (!IsValidBinaryFormat(format))
+        {
+            MF_LogError(amx, AMX_ERR_NATIVE, "Invalid binary JSON format %d", format);
+            return false;
+        }
+
+        return true;
+    }
+
+    // ezjson_stats: prints live JSON handles and memory per plugin
+    void JsonStatsCommand()
+    {
+        if (!g_JsonManager)
+            return;
+
+        MF_PrintSrvConsole("%-32s %8s %8s %10s %10s %10s\n", "plugin", "live", "peak", "created", "freed", "bytes");
+
+        size_t total_live = 0;
+        size_t total_bytes = 0;
+        for (const auto &[amx, stats] : g_JsonManager->GetAllOwnerStats())
+        {
+            const int plugin_id = amx ? MF_FindScriptByAmx(amx) : -1;
+            const size_t bytes = g_JsonManager->GetOwnerBytes(amx);
+
+            MF_PrintSrvConsole(
+                "%-32s %8zu %8zu %10zu %10zu %10zu\n",
+                plugin_id != -1 ? MF_GetScriptName(plugin_id) : "<module>",
+                stats.m_Live,
+                stats.m_Peak,
+                stats.m_Created,
+                stats.m_Freed,
+                bytes);
+
+            total_live += stats.m_Live;
+            total_bytes += bytes;
+        }
+
+        MF_PrintSrvConsole("total: %zu live handles, %zu bytes, limit per plugin: %zu\n", total_live, total_bytes, g_JsonManager->GetMaxHandlesPerOwner());
+    }
+
     std::unique_ptr<cell[]> ReadCallbackData(AMX *amx, cell *params, int arg_data, int arg_data_len, int &data_len)
     {
         data_len = 0;
@@ -76,8 +148,12 @@ void CreateModules()
     ezhttp::trace::Initialize(MF_BuildPathname("addons/amxmodx/logs/ezhttp_trace.log"));
     RefreshTraceLogSetting();
     ezhttp::trace::Writef("module", "CreateModules begin");
-    g_EasyHttpModule = std::make_unique<EasyHttpModule>(MF_BuildPathname("addons/amxmodx/data/amxx_easy_http_cacert.pem"));
+    // MF_BuildPathname() returns a shared buffer, so the paths are copied one by one
+    std::string ca_cert_path = MF_BuildPathname("addons/amxmodx/data/amxx_easy_http_cacert.pem");
+    std::string disk_cache_directory = MF_BuildPathname("addons/amxmodx/data/easy_http_cache");
+    g_EasyHttpModule = std::make_unique<EasyHttpModule>(std::move(ca_cert_path), std::move(disk_cache_directory));
     g_JsonManager = std::make_unique<JSONMngr>();
+    g_JsonAsyncIO = std::make_unique<JSONAsyncIO>();
     g_MapChangeResetDone = false;
     ezhttp::trace::Writef("module", "CreateModules done easy_http=%p json=%p", g_EasyHttpModule.get(), g_JsonManager.get());
 }
@@ -86,6 +162,7 @@ void DestroyModules()
 {
     ezhttp::trace::Writef("module", "DestroyModules begin easy_http=%p json=%p", g_EasyHttpModule.get(), g_JsonManager.get());
     g_EasyHttpModule.reset();
+    g_JsonAsyncIO.reset();
     g_JsonManager.reset();
     ezhttp::trace::Writef("module", "DestroyModules done");
     ezhttp::trace::Shutdown();
@@ -167,6 +244,63 @@ cell AMX_NATIVE_CALL ezhttp_option_set_body_from_json(AMX *amx, cell *params)
     return 1;
 }
 
+// native bool:ezhttp_option_set_body_from_json_binary(EzHttpOptions:options_id, EzJSON:json, EzJSONBinaryFormat:format = EzJSONMessagePack);
+cell AMX_NATIVE_CALL ezhttp_option_set_body_from_json_binary(AMX *amx, cell *params)
+{
+    auto options_id = (OptionsId)params[1];
+    auto json_handle = (JS_Handle)params[2];
+    cell format = params[3];
+
+    if (!ValidateOptionsId(amx, options_id) || !ValidateBinaryFormat(amx, format))
+        return 0;
+
+    if (!g_JsonManager->IsValidHandle(json_handle))
+    {
+        MF_LogError(amx, AMX_ERR_NATIVE, "Invalid JSON handle! %d", json_handle);
+        return 0;
+    }
+
+    // the plugin may change or free the value after this call, so the worker gets its own copy
+    std::shared_ptr<JSON_Value> json_value(g_JsonManager->CopyDetachedValue(json_handle), json_value_free);
+    if (!json_value)
+        return 0;
+
+    auto binary_format = (JSONBinaryFormat)format;
+    ezhttp::EasyHttpOptionsBuilder &options_builder = g_EasyHttpModule->GetOptions(options_id).options_builder;
+
+    options_builder.SetBodyFactory([json_value, binary_format]() -> std::optional<std::string> {
+        std::string body;
+        if (!JSONToBinary(json_value.get(), binary_format, body))
+            return std::nullopt;
+
+        return body;
+    });
+    options_builder.SetHeader("Content-Type", GetBinaryFormatContentType(binary_format));
+
+    return 1;
+}
+
+// native ezhttp_option_set_response_json_binary(EzHttpOptions:options_id, EzJSONBinaryFormat:format = EzJSONMessagePack);
+cell AMX_NATIVE_CALL ezhttp_option_set_response_json_binary(AMX *amx, cell *params)
+{
+    auto options_id = (OptionsId)params[1];
+    cell format = params[2];
+
+    if (!ValidateOptionsId(amx, options_id) || !ValidateBinaryFormat(amx, format))
+        return 0;
+
+    auto binary_format = (JSONBinaryFormat)format;
+
+    g_EasyHttpModule->GetOptions(options_id).options_builder.SetResponseDecoder([binary_format](const Response &response) {
+        auto decoded = std::make_shared<DecodedJsonBody>();
+        decoded->format = binary_format;
+        decoded->value = JSONFromBinary(response.text().data(), response.text().size(), binary_format);
+        return std::static_pointer_cast<void>(decoded);
+    });
+
+    return 0;
+}
+
 // native ezhttp_option_append_body(EzHttpOptions:options_id, const body[]);
 cell AMX_NATIVE_CALL ezhttp_option_append_body(AMX *amx, cell *params)
 {
@@ -259,11 +393,10 @@ cell AMX_NATIVE_CALL ezhttp_option_set_user_data(AMX *amx, cell *params)
     if (!ValidateOptionsId(amx, options_id))
         return 0;
 
-    std::vector<cell> user_data;
-    user_data.resize(data_len);
-    MF_CopyAmxMemory(user_data.data(), data_addr, data_len);
+    auto user_data = std::make_shared<std::vector<cell>>(data_len);
+    MF_CopyAmxMemory(user_data->data(), data_addr, data_len);
 
-    g_EasyHttpModule->GetOptions(options_id).user_data = user_data;
+    g_EasyHttpModule->GetOptions(options_id).user_data = std::move(user_data);
     return 0;
 }
 
@@ -299,6 +432,112 @@ cell AMX_NATIVE_CALL ezhttp_option_set_queue(AMX *amx, cell *params)
     return 0;
 }
 
+// native ezhttp_option_set_priority(EzHttpOptions:options_id, EzHttpPriority:priority);
+cell AMX_NATIVE_CALL ezhttp_option_set_priority(AMX *amx, cell *params)
+{
+    auto options_id = (OptionsId)params[1];
+    auto priority = (RequestPriority)params[2];
+
+    if (!ValidateOptionsId(amx, options_id))
+        return 0;
+
+    if (!ValidatePriority(amx, priority))
+        return 0;
+
+    g_EasyHttpModule->GetOptions(options_id).options_builder.SetPriority(priority);
+    return 0;
+}
+
+// native ezhttp_option_set_retry(EzHttpOptions:options_id, max_attempts, backoff_base_ms = 500, backoff_cap_ms = 30000, Float:jitter = 0.5);
+cell AMX_NATIVE_CALL ezhttp_option_set_retry(AMX *amx, cell *params)
+{
+    auto options_id = (OptionsId)params[1];
+    const int max_attempts = params[2];
+    const int backoff_base_ms = params[3];
+    const int backoff_cap_ms = params[4];
+    const float jitter = amx_ctof(params[5]);
+
+    if (!ValidateOptionsId(amx, options_id))
+        return 0;
+
+    if (max_attempts < 1 || max_attempts > RetryPolicy::kMaxAttempts)
+    {
+        MF_LogError(amx, AMX_ERR_NATIVE, "Invalid max attempts %d, must be from 1 to %d", max_attempts, RetryPolicy::kMaxAttempts);
+        return 0;
+    }
+
+    if (backoff_base_ms < 0 || backoff_cap_ms < backoff_base_ms)
+    {
+        MF_LogError(amx, AMX_ERR_NATIVE, "Invalid backoff %d-%d ms", backoff_base_ms, backoff_cap_ms);
+        return 0;
+    }
+
+    if (!(jitter >= 0.0f && jitter <= 1.0f))
+    {
+        MF_LogError(amx, AMX_ERR_NATIVE, "Invalid jitter %f, must be from 0.0 to 1.0", jitter);
+        return 0;
+    }
+
+    g_EasyHttpModule->GetOptions(options_id).options_builder.SetRetry(
+        max_attempts,
+        std::chrono::milliseconds(backoff_base_ms),
+        std::chrono::milliseconds(backoff_cap_ms),
+        jitter);
+    return 0;
+}
+
+// native ezhttp_option_set_coalesce(EzHttpOptions:options_id, bool:coalesce);
+cell AMX_NATIVE_CALL ezhttp_option_set_coalesce(AMX *amx, cell *params)
+{
+    auto options_id = (OptionsId)params[1];
+    const bool coalesce = params[2] != 0;
+
+    if (!ValidateOptionsId(amx, options_id))
+        return 0;
+
+    g_EasyHttpModule->GetOptions(options_id).options_builder.SetCoalesce(coalesce);
+    return 0;
+}
+
+// native ezhttp_option_set_cache(EzHttpOptions:options_id, bool:use_cache);
+cell AMX_NATIVE_CALL ezhttp_option_set_cache(AMX *amx, cell *params)
+{
+    auto options_id = (OptionsId)params[1];
+    const bool use_cache = params[2] != 0;
+
+    if (!ValidateOptionsId(amx, options_id))
+        return 0;
+
+    g_EasyHttpModule->GetOptions(options_id).options_builder.SetUseCache(use_cache);
+    return 0;
+}
+
+// native ezhttp_option_add_retry_status(EzHttpOptions:options_id, status_code);
+cell AMX_NATIVE_CALL ezhttp_option_add_retry_status(AMX *amx, cell *params)
+{
+    auto options_id = (OptionsId)params[1];
+    const long status_code = params[2];
+
+    if (!ValidateOptionsId(amx, options_id))
+        return 0;
+
+    g_EasyHttpModule->GetOptions(options_id).options_builder.AddRetryStatusCode(status_code);
+    return 0;
+}
+
+// native ezhttp_option_add_retry_error(EzHttpOptions:options_id, EzHttpErrorCode:error_code);
+cell AMX_NATIVE_CALL ezhttp_option_add_retry_error(AMX *amx, cell *params)
+{
+    auto options_id = (OptionsId)params[1];
+    auto error_code = (cpr::ErrorCode)params[2];
+
+    if (!ValidateOptionsId(amx, options_id))
+        return 0;
+
+    g_EasyHttpModule->GetOptions(options_id).options_builder.AddRetryErrorCode(error_code);
+    return 0;
+}
+
 // native EzHttpRequest:ezhttp_get(const url[], const on_complete[], EzHttpOptions:options_id = EzHttpOptions:0);
 cell AMX_NATIVE_CALL ezhttp_get(AMX *amx, cell *params)
 {
@@ -429,6 +668,220 @@ cell AMX_NATIVE_CALL ezhttp_delete(AMX *amx, cell *params)
     return (cell)DispatchRequest(amx, RequestMethod::HttpDelete, options_id, std::string(url, url_len), std::string(callback, callback_len), std::move(request_data), data_len);
 }
 
+// native EzHttpBatch:ezhttp_batch_begin();
+cell AMX_NATIVE_CALL ezhttp_batch_begin(AMX *amx, cell *params)
+{
+    return (cell)g_EasyHttpModule->CreateBatch();
+}
+
+// native ezhttp_batch_add(EzHttpBatch:batch_id, EzHttpMethod:method, const url[], EzHttpOptions:options_id = EzHttpOptions:0);
+cell AMX_NATIVE_CALL ezhttp_batch_add(AMX *amx, cell *params)
+{
+    auto batch_id = (BatchId)params[1];
+    auto method = (RequestMethod)params[2];
+
+    int url_len;
+    char *url = MF_GetAmxString(amx, params[3], 0, &url_len);
+
+    auto options_id = (OptionsId)params[4];
+
+    if (!ValidateBatchId(amx, batch_id) || !ValidateHttpMethod(amx, method))
+        return -1;
+
+    if (options_id != OptionsId::Null && !ValidateOptionsId(amx, options_id))
+        return -1;
+
+    OptionsData request_options = options_id == OptionsId::Null
+                                      ? OptionsData{}
+                                      : g_EasyHttpModule->CreateOptionsSnapshot(options_id);
+
+    if (!ValidateDispatchOptions(amx, request_options))
+        return -1;
+
+    return g_EasyHttpModule->AddBatchRequest(batch_id, method, std::string(url, url_len), std::move(request_options), options_id);
+}
+
+// native ezhttp_batch_send(EzHttpBatch:batch_id, const on_all_done[] = "", const on_complete[] = "", const data[] = {}, const data_len = 0);
+cell AMX_NATIVE_CALL ezhttp_batch_send(AMX *amx, cell *params)
+{
+    enum
+    {
+        arg_count,
+        arg_batch_id,
+        arg_on_all_done,
+        arg_on_complete,
+        arg_data,
+        arg_data_len
+    };
+
+    auto batch_id = (BatchId)params[arg_batch_id];
+
+    int on_all_done_len;
+    char *on_all_done = MF_GetAmxString(amx, params[arg_on_all_done], 0, &on_all_done_len);
+
+    int on_complete_len;
+    char *on_complete = MF_GetAmxString(amx, params[arg_on_complete], 1, &on_complete_len);
+
+    int data_len = 0;
+    std::unique_ptr<cell[]> request_data = ReadCallbackData(amx, params, arg_data, arg_data_len, data_len);
+
+    if (!ValidateBatchId(amx, batch_id))
+        return 0;
+
+    // registered once, every request of the batch executes the same forward
+    int callback_id = -1;
+    if (on_complete_len > 0)
+    {
+        callback_id = request_data
+                          ? MF_RegisterSPForwardByName(amx, on_complete, FP_CELL, FP_ARRAY, FP_DONE)
+                          : MF_RegisterSPForwardByName(amx, on_complete, FP_CELL, FP_DONE);
+
+        if (callback_id == -1)
+        {
+            MF_LogError(amx, AMX_ERR_NATIVE, "Callback function \"%s\" is not exists", on_complete);
+            return 0;
+        }
+    }
+
+    int done_callback_id = -1;
+    if (on_all_done_len > 0)
+    {
+        done_callback_id = request_data
+                               ? MF_RegisterSPForwardByName(amx, on_all_done, FP_CELL, FP_CELL, FP_ARRAY, FP_DONE)
+                               : MF_RegisterSPForwardByName(amx, on_all_done, FP_CELL, FP_CELL, FP_DONE);
+
+        if (done_callback_id == -1)
+        {
+            if (callback_id != -1)
+                MF_UnregisterSPForward(callback_id);
+
+            MF_LogError(amx, AMX_ERR_NATIVE, "Callback function \"%s\" is not exists", on_all_done);
+            return 0;
+        }
+    }
+
+    return static_cast<cell>(g_EasyHttpModule->SendBatch(batch_id, callback_id, done_callback_id, std::move(request_data), data_len));
+}
+
+// native ezhttp_get_batch_index(EzHttpRequest:request_id);
+cell AMX_NATIVE_CALL ezhttp_get_batch_index(AMX *amx, cell *params)
+{
+    auto request_id = (RequestId)params[1];
+
+    if (!ValidateRequestId(amx, request_id))
+        return -1;
+
+    return g_EasyHttpModule->GetRequest(request_id).batch_index;
+}
+
+// native EzHttpTemplate:ezhttp_template_create(EzHttpOptions:options_id, const url_pattern[], EzHttpMethod:method = EZH_GET);
+cell AMX_NATIVE_CALL ezhttp_template_create(AMX *amx, cell *params)
+{
+    auto options_id = (OptionsId)params[1];
+
+    int url_pattern_len;
+    char *url_pattern = MF_GetAmxString(amx, params[2], 0, &url_pattern_len);
+
+    auto method = params[0] >= 3 * (cell)sizeof(cell) ? (RequestMethod)params[3] : RequestMethod::HttpGet;
+
+    if (!ValidateHttpMethod(amx, method))
+        return 0;
+
+    if (options_id != OptionsId::Null && !ValidateOptionsId(amx, options_id))
+        return 0;
+
+    OptionsData template_options = options_id == OptionsId::Null
+                                       ? OptionsData{}
+                                       : g_EasyHttpModule->CreateOptionsSnapshot(options_id);
+
+    if (!ValidateDispatchOptions(amx, template_options))
+        return 0;
+
+    std::string error;
+    std::optional<UrlTemplate> url_template = UrlTemplate::Parse(std::string(url_pattern, url_pattern_len), error);
+    if (!url_template)
+    {
+        MF_LogError(amx, AMX_ERR_NATIVE, "Invalid url pattern \"%s\": %s", url_pattern, error.c_str());
+        return 0;
+    }
+
+    return (cell)g_EasyHttpModule->CreateTemplate(method, std::move(*url_template), std::move(template_options));
+}
+
+// native EzHttpRequest:ezhttp_template_send(EzHttpTemplate:template_id, const on_complete[] = "", const any:...);
+cell AMX_NATIVE_CALL ezhttp_template_send(AMX *amx, cell *params)
+{
+    enum
+    {
+        arg_count,
+        arg_template_id,
+        arg_on_complete,
+        arg_values
+    };
+
+    auto template_id = (TemplateId)params[arg_template_id];
+    const int values_count = static_cast<int>(params[arg_count] / sizeof(cell)) - arg_on_complete;
+
+    if (!ValidateTemplateId(amx, template_id))
+        return 0;
+
+    if (values_count < 0 || values_count % 2 != 0)
+    {
+        MF_LogError(amx, AMX_ERR_NATIVE, "Template values must be passed as key-value pairs");
+        return 0;
+    }
+
+    UrlTemplate::Values values;
+    for (int i = 0; i < values_count; i += 2)
+    {
+        int len;
+        std::string key = MF_GetAmxString(amx, params[arg_values + i], 0, &len);
+        std::string value = MF_GetAmxString(amx, params[arg_values + i + 1], 0, &len);
+        values[std::move(key)] = std::move(value);
+    }
+
+    std::string error;
+    std::optional<std::string> url = g_EasyHttpModule->GetTemplate(template_id).url_template.Expand(values, error);
+    if (!url)
+    {
+        MF_LogError(amx, AMX_ERR_NATIVE, "Failed to fill template %d: %s", template_id, error.c_str());
+        return 0;
+    }
+
+    int on_complete_len;
+    char *on_complete = MF_GetAmxString(amx, params[arg_on_complete], 0, &on_complete_len);
+
+    int callback_id = -1;
+    if (on_complete_len > 0)
+    {
+        callback_id = MF_RegisterSPForwardByName(amx, on_complete, FP_CELL, FP_DONE);
+        if (callback_id == -1)
+        {
+            MF_LogError(amx, AMX_ERR_NATIVE, "Callback function \"%s\" is not exists", on_complete);
+            return 0;
+        }
+    }
+
+    RequestId request_id = g_EasyHttpModule->SendTemplateRequest(template_id, *url, callback_id);
+    if (request_id == RequestId::Null)
+    {
+        if (callback_id != -1)
+            MF_UnregisterSPForward(callback_id);
+
+        MF_LogError(amx, AMX_ERR_NATIVE, "Failed to dispatch request due to invalid internal state");
+    }
+
+    return (cell)request_id;
+}
+
+// native bool:ezhttp_template_destroy(EzHttpTemplate:template_id);
+cell AMX_NATIVE_CALL ezhttp_template_destroy(AMX *amx, cell *params)
+{
+    auto template_id = (TemplateId)params[1];
+
+    return g_EasyHttpModule->DeleteTemplate(template_id);
+}
+
 // native ezhttp_is_request_exists(EzHttpRequest:request_id);
 cell AMX_NATIVE_CALL ezhttp_is_request_exists(AMX *amx, cell *params)
 {
@@ -493,7 +946,7 @@ cell AMX_NATIVE_CALL ezhttp_get_data(AMX *amx, cell *params)
 
     const Response &response = g_EasyHttpModule->GetRequest(request_id).response;
 
-    utils::SetAmxStringUTF8CharSafe(amx, params[2], response.text.c_str(), response.text.length(), max_len);
+    utils::SetAmxStringUTF8CharSafe(amx, params[2], response.text().c_str(), response.text().length(), max_len);
 
     return 0;
 }
@@ -509,11 +962,11 @@ cell AMX_NATIVE_CALL ezhttp_get_data_binary(AMX *amx, cell *params)
 
     const Response &response = g_EasyHttpModule->GetRequest(request_id).response;
 
-    size_t to_copy = std::min(static_cast<size_t>(max_len), response.text.length());
+    size_t to_copy = std::min(static_cast<size_t>(max_len), response.text().length());
 
     cell *buffer = MF_GetAmxAddr(amx, params[2]);
     for (size_t i = 0; i < to_copy; ++i)
-        buffer[i] = static_cast<unsigned char>(response.text[i]);
+        buffer[i] = static_cast<unsigned char>(response.text()[i]);
 
     return static_cast<cell>(to_copy);
 }
@@ -529,12 +982,53 @@ cell AMX_NATIVE_CALL ezhttp_parse_json_response(AMX *amx, cell *params)
 
     const Response &response = g_EasyHttpModule->GetRequest(request_id).response;
 
+    if (!SetJsonHandleOwner(amx))
+        return -1;
+
     JS_Handle json_handle;
-    bool result = g_JsonManager->Parse(response.text.c_str(), &json_handle, false, with_comments);
+    bool result = g_JsonManager->Parse(response.text().c_str(), &json_handle, false, with_comments);
 
     return result ? json_handle : -1;
 }
 
+// native EzJSON:ezhttp_parse_json_binary_response(EzHttpRequest:request_id, EzJSONBinaryFormat:format = EzJSONMessagePack);
+cell AMX_NATIVE_CALL ezhttp_parse_json_binary_response(AMX *amx, cell *params)
+{
+    auto request_id = (RequestId)params[1];
+    cell format = params[2];
+
+    if (!ValidateRequestId(amx, request_id) || !ValidateBinaryFormat(amx, format))
+        return -1;
+
+    const Response &response = g_EasyHttpModule->GetRequest(request_id).response;
+
+    if (!SetJsonHandleOwner(amx))
+        return -1;
+
+    auto binary_format = (JSONBinaryFormat)format;
+    auto decoded = static_cast<DecodedJsonBody *>(response.decoded_body.get());
+
+    JSON_Value *json_value = nullptr;
+    if (decoded && decoded->format == binary_format && decoded->value)
+    {
+        // the tree was already decoded by the worker, the first call takes it
+        json_value = decoded->value;
+        decoded->value = nullptr;
+    }
+    else
+    {
+        json_value = JSONFromBinary(response.text().data(), response.text().size(), binary_format);
+    }
+
+    if (!json_value)
+        return -1;
+
+    JS_Handle json_handle;
+    g_JsonManager->AdoptValue(json_value, &json_handle);
+
+    return json_handle;
+}
+
 cell AMX_NATIVE_CALL ezhttp_get_url(AMX *amx, cell *params)
 {
     auto request_id = (RequestId)params[1];
@@ -562,17 +1056,17 @@ cell AMX_NATIVE_CALL ezhttp_save_data_to_file(AMX *amx, cell *params)
 
     const Response &response = g_EasyHttpModule->GetRequest(request_id).response;
 
-    if (response.text.empty())
+    if (response.text().empty())
         return 0;
 
     std::ofstream file(MF_BuildPathname("%s", file_path), std::ofstream::out | std::ofstream::binary);
     if (!file.is_open())
         return 0;
 
-    file.write(response.text.data(), response.text.length());
+    file.write(response.text().data(), response.text().length());
     file.close();
 
-    return response.text.length();
+    return response.text().length();
 }
 
 cell AMX_NATIVE_CALL ezhttp_save_data_to_file2(AMX *amx, cell *params)
@@ -585,7 +1079,7 @@ cell AMX_NATIVE_CALL ezhttp_save_data_to_file2(AMX *amx, cell *params)
 
     const Response &response = g_EasyHttpModule->GetRequest(request_id).response;
 
-    return std::fwrite(response.text.data(), sizeof(char), response.text.length(), file_handle);
+    return std::fwrite(response.text().data(), sizeof(char), response.text().length(), file_handle);
 }
 
 cell AMX_NATIVE_CALL ezhttp_get_headers_count(AMX *amx, cell *params)
@@ -727,6 +1221,30 @@ cell AMX_NATIVE_CALL ezhttp_get_error_message(AMX *amx, cell *params)
     return 0;
 }
 
+cell AMX_NATIVE_CALL ezhttp_get_attempts(AMX *amx, cell *params)
+{
+    auto request_id = (RequestId)params[1];
+
+    if (!ValidateRequestId(amx, request_id))
+        return 0;
+
+    const Response &response = g_EasyHttpModule->GetRequest(request_id).response;
+
+    return response.attempts;
+}
+
+cell AMX_NATIVE_CALL ezhttp_is_from_cache(AMX *amx, cell *params)
+{
+    auto request_id = (RequestId)params[1];
+
+    if (!ValidateRequestId(amx, request_id))
+        return 0;
+
+    const Response &response = g_EasyHttpModule->GetRequest(request_id).response;
+
+    return response.from_cache;
+}
+
 cell AMX_NATIVE_CALL ezhttp_get_redirect_count(AMX *amx, cell *params)
 {
     auto request_id = (RequestId)params[1];
@@ -771,11 +1289,11 @@ cell AMX_NATIVE_CALL ezhttp_get_user_data(AMX *amx, cell *params)
     if (!ValidateRequestId(amx, request_id))
         return 0;
 
-    const std::optional<std::vector<cell>> &user_data = g_EasyHttpModule->GetRequest(request_id).user_data;
+    const std::shared_ptr<const std::vector<cell>> &user_data = g_EasyHttpModule->GetRequest(request_id).user_data;
     if (!user_data)
         return 0;
 
-    MF_CopyAmxMemory(data_addr, user_data.value().data(), user_data.value().size());
+    MF_CopyAmxMemory(data_addr, user_data->data(), user_data->size());
 
     return 0;
 }
@@ -922,9 +1440,177 @@ cell AMX_NATIVE_CALL ezhttp_ftp_download2(AMX *amx, cell *params)
         });
 }
 
+// native EzHttpQueue:ezhttp_create_queue(max_concurrency = 1, min_threads = 0);
 cell AMX_NATIVE_CALL ezhttp_create_queue(AMX *amx, cell *params)
 {
-    return (cell)g_EasyHttpModule->CreateQueue();
+    // plugins compiled with the old include pass no arguments
+    const int args_passed = static_cast<int>(params[0] / sizeof(cell));
+    const int max_concurrency = args_passed >= 1 ? params[1] : 1;
+    const int min_threads = args_passed >= 2 ? params[2] : 0;
+
+    if (max_concurrency < 1 || max_concurrency > EasyHttpModule::kMaxQueueConcurrency)
+    {
+        MF_LogError(amx, AMX_ERR_NATIVE, "Invalid queue concurrency %d, must be from 1 to %d", max_concurrency, EasyHttpModule::kMaxQueueConcurrency);
+        return 0;
+    }
+
+    if (min_threads < 0 || min_threads > max_concurrency)
+    {
+        MF_LogError(amx, AMX_ERR_NATIVE, "Invalid queue min threads %d, must be from 0 to %d", min_threads, max_concurrency);
+        return 0;
+    }
+
+    return (cell)g_EasyHttpModule->CreateQueue(max_concurrency, min_threads);
+}
+
+// native ezhttp_get_queue_threads(EzHttpQueue:queue_id);
+cell AMX_NATIVE_CALL ezhttp_get_queue_threads(AMX *amx, cell *params)
+{
+    auto queue_id = (QueueId)params[1];
+
+    if (!ValidateQueueId(amx, queue_id))
+        return 0;
+
+    return g_EasyHttpModule->GetQueueRunningCount(queue_id);
+}
+
+// native ezhttp_queue_set_max_per_host(EzHttpQueue:queue_id, max_per_host);
+cell AMX_NATIVE_CALL ezhttp_queue_set_max_per_host(AMX *amx, cell *params)
+{
+    auto queue_id = (QueueId)params[1];
+    const int max_per_host = params[2];
+
+    if (!ValidateQueueId(amx, queue_id))
+        return 0;
+
+    if (max_per_host < 1 || max_per_host > EasyHttpModule::kMaxQueueConcurrency)
+    {
+        MF_LogError(amx, AMX_ERR_NATIVE, "Invalid max requests per host %d, must be from 1 to %d", max_per_host, EasyHttpModule::kMaxQueueConcurrency);
+        return 0;
+    }
+
+    g_EasyHttpModule->SetQueueMaxPerHost(queue_id, max_per_host);
+    return 0;
+}
+
+// native ezhttp_queue_set_rate_limit(EzHttpQueue:queue_id, Float:requests_per_second, burst = 1);
+cell AMX_NATIVE_CALL ezhttp_queue_set_rate_limit(AMX *amx, cell *params)
+{
+    auto queue_id = (QueueId)params[1];
+    const float requests_per_second = amx_ctof(params[2]);
+    const int burst = params[3];
+
+    if (!ValidateQueueId(amx, queue_id) || !ValidateRateLimit(amx, requests_per_second, burst))
+        return 0;
+
+    g_EasyHttpModule->SetQueueRateLimit(queue_id, requests_per_second, burst);
+    return 0;
+}
+
+// native ezhttp_set_host_rate_limit(const host[], Float:requests_per_second, burst = 1);
+cell AMX_NATIVE_CALL ezhttp_set_host_rate_limit(AMX *amx, cell *params)
+{
+    int host_len;
+    char *host = MF_GetAmxString(amx, params[1], 0, &host_len);
+    const float requests_per_second = amx_ctof(params[2]);
+    const int burst = params[3];
+
+    if (!ValidateRateLimit(amx, requests_per_second, burst))
+        return 0;
+
+    g_EasyHttpModule->SetHostRateLimit(std::string(host, host_len), requests_per_second, burst);
+    return 0;
+}
+
+// native ezhttp_queue_set_connect_policy(EzHttpQueue:queue_id, EzHttpIpVersion:ip_version = EZH_IP_ANY, happy_eyeballs_timeout_ms = -1);
+cell AMX_NATIVE_CALL ezhttp_queue_set_connect_policy(AMX *amx, cell *params)
+{
+    auto queue_id = (QueueId)params[1];
+    const auto ip_version = (IpVersion)params[2];
+    const int happy_eyeballs_timeout_ms = params[3];
+
+    if (!ValidateQueueId(amx, queue_id) || !ValidateConnectPolicy(amx, ip_version, happy_eyeballs_timeout_ms))
+        return 0;
+
+    g_EasyHttpModule->SetQueueConnectPolicy(queue_id, ConnectPolicy{ip_version, happy_eyeballs_timeout_ms, std::string()});
+    return 0;
+}
+
+// native ezhttp_set_host_connect_policy(const host[], EzHttpIpVersion:ip_version = EZH_IP_ANY, happy_eyeballs_timeout_ms = -1, const resolve[] = "");
+cell AMX_NATIVE_CALL ezhttp_set_host_connect_policy(AMX *amx, cell *params)
+{
+    int host_len;
+    char *host = MF_GetAmxString(amx, params[1], 0, &host_len);
+    const auto ip_version = (IpVersion)params[2];
+    const int happy_eyeballs_timeout_ms = params[3];
+    int resolve_len;
+    char *resolve = MF_GetAmxString(amx, params[4], 1, &resolve_len);
+
+    if (!ValidateConnectPolicy(amx, ip_version, happy_eyeballs_timeout_ms))
+        return 0;
+
+    std::string resolve_addresses(resolve, resolve_len);
+    if (!resolve_addresses.empty() && !ConnectPolicy::IsValidResolveAddresses(resolve_addresses))
+    {
+        MF_LogError(amx, AMX_ERR_NATIVE, "Invalid resolve addresses \"%s\", expected comma separated IP addresses", resolve);
+        return 0;
+    }
+
+    g_EasyHttpModule->SetHostConnectPolicy(std::string(host, host_len), ConnectPolicy{ip_version, happy_eyeballs_timeout_ms, std::move(resolve_addresses)});
+    return 0;
+}
+
+// native ezhttp_set_cache_size(max_bytes);
+cell AMX_NATIVE_CALL ezhttp_set_cache_size(AMX *amx, cell *params)
+{
+    const int max_bytes = params[1];
+
+    if (max_bytes < 0)
+    {
+        MF_LogError(amx, AMX_ERR_NATIVE, "Invalid cache size %d, must not be negative", max_bytes);
+        return 0;
+    }
+
+    g_EasyHttpModule->SetResponseCacheSize(static_cast<size_t>(max_bytes));
+    return 0;
+}
+
+// native ezhttp_set_disk_cache_size(max_bytes);
+cell AMX_NATIVE_CALL ezhttp_set_disk_cache_size(AMX *amx, cell *params)
+{
+    const int max_bytes = params[1];
+
+    if (max_bytes < 0)
+    {
+        MF_LogError(amx, AMX_ERR_NATIVE, "Invalid disk cache size %d, must not be negative", max_bytes);
+        return 0;
+    }
+
+    g_EasyHttpModule->SetDiskCacheSize(static_cast<size_t>(max_bytes));
+    return 0;
+}
+
+// native ezhttp_get_queue_depth(EzHttpQueue:queue_id, EzHttpPriority:priority);
+cell AMX_NATIVE_CALL ezhttp_get_queue_depth(AMX *amx, cell *params)
+{
+    auto queue_id = (QueueId)params[1];
+    auto priority = (RequestPriority)params[2];
+
+    if (!ValidateQueueId(amx, queue_id) || !ValidatePriority(amx, priority))
+        return 0;
+
+    return static_cast<cell>(g_EasyHttpModule->GetQueuePendingCount(queue_id, priority));
+}
+
+// native ezhttp_get_tls_handshakes(&full, &resumed);
+cell AMX_NATIVE_CALL ezhttp_get_tls_handshakes(AMX *amx, cell *params)
+{
+    const uint64_t full = g_EasyHttpModule->GetTlsFullHandshakes();
+    const uint64_t resumed = g_EasyHttpModule->GetTlsResumedHandshakes();
+
+    *MF_GetAmxAddr(amx, params[1]) = static_cast<cell>(std::min<uint64_t>(full, INT32_MAX));
+    *MF_GetAmxAddr(amx, params[2]) = static_cast<cell>(std::min<uint64_t>(resumed, INT32_MAX));
+    return 0;
 }
 
 cell AMX_NATIVE_CALL ezhttp_steam_to_steam64(AMX *amx, cell *params)
@@ -1055,6 +1741,51 @@ bool ValidateQueueId(AMX *amx, QueueId queue_id)
     return true;
 }
 
+bool ValidateBatchId(AMX *amx, BatchId batch_id)
+{
+    if (!g_EasyHttpModule->IsBatchExists(batch_id))
+    {
+        MF_LogError(amx, AMX_ERR_NATIVE, "Batch id %d not exists", batch_id);
+        return false;
+    }
+
+    if (g_EasyHttpModule->GetBatch(batch_id).sent)
+    {
+        MF_LogError(amx, AMX_ERR_NATIVE, "Batch id %d is already sent", batch_id);
+        return false;
+    }
+
+    return true;
+}
+
+bool ValidateTemplateId(AMX *amx, TemplateId template_id)
+{
+    if (!g_EasyHttpModule->IsTemplateExists(template_id))
+    {
+        MF_LogError(amx, AMX_ERR_NATIVE, "Template id %d not exists", template_id);
+        return false;
+    }
+
+    return true;
+}
+
+bool ValidateHttpMethod(AMX *amx, RequestMethod method)
+{
+    switch (method)
+    {
+    case RequestMethod::HttpGet:
+    case RequestMethod::HttpPost:
+    case RequestMethod::HttpPut:
+    case RequestMethod::HttpPatch:
+    case RequestMethod::HttpDelete:
+        return true;
+
+    default:
+        MF_LogError(amx, AMX_ERR_NATIVE, "Invalid request method %d", static_cast<int>(method));
+        return false;
+    }
+}
+
 bool ValidatePluginEndBehaviour(AMX *amx, PluginEndBehaviour plugin_end_behaviour)
 {
     switch (plugin_end_behaviour)
@@ -1068,6 +1799,65 @@ bool ValidatePluginEndBehaviour(AMX *amx, PluginEndBehaviour plugin_end_behaviou
     return false;
 }
 
+bool ValidatePriority(AMX *amx, RequestPriority priority)
+{
+    switch (priority)
+    {
+    case RequestPriority::Low:
+    case RequestPriority::Normal:
+    case RequestPriority::High:
+        return true;
+    }
+
+    MF_LogError(amx, AMX_ERR_NATIVE, "Invalid request priority %d", static_cast<int>(priority));
+    return false;
+}
+
+bool ValidateRateLimit(AMX *amx, float requests_per_second, int burst)
+{
+    if (!(requests_per_second >= 0.0f))
+    {
+        MF_LogError(amx, AMX_ERR_NATIVE, "Invalid requests per second %f, must not be negative", requests_per_second);
+        return false;
+    }
+
+    if (burst < 1)
+    {
+        MF_LogError(amx, AMX_ERR_NATIVE, "Invalid burst %d, must be at least 1", burst);
+        return false;
+    }
+
+    return true;
+}
+
+bool ValidateIpVersion(AMX *amx, IpVersion ip_version)
+{
+    switch (ip_version)
+    {
+    case IpVersion::Any:
+    case IpVersion::V4:
+    case IpVersion::V6:
+        return true;
+    }
+
+    MF_LogError(amx, AMX_ERR_NATIVE, "Invalid IP version %d", static_cast<int>(ip_version));
+    return false;
+}
+
+bool ValidateConnectPolicy(AMX *amx, IpVersion ip_version, int happy_eyeballs_timeout_ms)
+{
+    if (!ValidateIpVersion(amx, ip_version))
+        return false;
+
+    if (happy_eyeballs_timeout_ms < -1)
+    {
+        MF_LogError(amx, AMX_ERR_NATIVE, "Invalid happy eyeballs timeout %d, must be -1 for the default or not negative", happy_eyeballs_timeout_ms);
+        return false;
+    }
+
+    return true;
+}
+
 bool ValidateFtpSecurity(AMX *amx, cell security_value)
 {
     if (security_value == 0 || security_value == 1)
@@ -1157,6 +1947,8 @@ AMX_NATIVE_INFO g_Natives[] =
         {"ezhttp_option_add_form_payload", ezhttp_option_add_form_payload},
         {"ezhttp_option_set_body", ezhttp_option_set_body},
         {"ezhttp_option_set_body_from_json", ezhttp_option_set_body_from_json},
+        {"ezhttp_option_set_body_from_json_binary", ezhttp_option_set_body_from_json_binary},
+        {"ezhttp_option_set_response_json_binary", ezhttp_option_set_response_json_binary},
         {"ezhttp_option_append_body", ezhttp_option_append_body},
         {"ezhttp_option_set_body_binary", ezhttp_option_set_body_binary},
         {"ezhttp_option_append_body_binary", ezhttp_option_append_body_binary},
@@ -1170,6 +1962,12 @@ AMX_NATIVE_INFO g_Natives[] =
         {"ezhttp_option_set_user_data", ezhttp_option_set_user_data},
         {"ezhttp_option_set_plugin_end_behaviour", ezhttp_option_set_plugin_end_behaviour},
         {"ezhttp_option_set_queue", ezhttp_option_set_queue},
+        {"ezhttp_option_set_priority", ezhttp_option_set_priority},
+        {"ezhttp_option_set_retry", ezhttp_option_set_retry},
+        {"ezhttp_option_add_retry_status", ezhttp_option_add_retry_status},
+        {"ezhttp_option_add_retry_error", ezhttp_option_add_retry_error},
+        {"ezhttp_option_set_coalesce", ezhttp_option_set_coalesce},
+        {"ezhttp_option_set_cache", ezhttp_option_set_cache},
 
         // requests
         {"ezhttp_get", ezhttp_get},
@@ -1177,6 +1975,13 @@ AMX_NATIVE_INFO g_Natives[] =
         {"ezhttp_put", ezhttp_put},
         {"ezhttp_patch", ezhttp_patch},
         {"ezhttp_delete", ezhttp_delete},
+        {"ezhttp_batch_begin", ezhttp_batch_begin},
+        {"ezhttp_batch_add", ezhttp_batch_add},
+        {"ezhttp_batch_send", ezhttp_batch_send},
+        {"ezhttp_get_batch_index", ezhttp_get_batch_index},
+        {"ezhttp_template_create", ezhttp_template_create},
+        {"ezhttp_template_send", ezhttp_template_send},
+        {"ezhttp_template_destroy", ezhttp_template_destroy},
         {"ezhttp_is_request_exists", ezhttp_is_request_exists},
         {"ezhttp_cancel_request", ezhttp_cancel_request},
         {"ezhttp_request_progress", ezhttp_request_progress},
@@ -1186,6 +1991,7 @@ AMX_NATIVE_INFO g_Natives[] =
         {"ezhttp_get_data", ezhttp_get_data},
         {"ezhttp_get_data_binary", ezhttp_get_data_binary},
         {"ezhttp_parse_json_response", ezhttp_parse_json_response},
+        {"ezhttp_parse_json_binary_response", ezhttp_parse_json_binary_response},
         {"ezhttp_get_url", ezhttp_get_url},
         {"ezhttp_save_data_to_file", ezhttp_save_data_to_file},
         {"ezhttp_save_data_to_file2", ezhttp_save_data_to_file2},
@@ -1199,6 +2005,8 @@ AMX_NATIVE_INFO g_Natives[] =
         {"ezhttp_get_error_code", ezhttp_get_error_code},
         {"ezhttp_get_error_message", ezhttp_get_error_message},
         {"ezhttp_get_redirect_count", ezhttp_get_redirect_count},
+        {"ezhttp_get_attempts", ezhttp_get_attempts},
+        {"ezhttp_is_from_cache", ezhttp_is_from_cache},
         {"ezhttp_get_uploaded_bytes", ezhttp_get_uploaded_bytes},
         {"ezhttp_get_downloaded_bytes", ezhttp_get_downloaded_bytes},
         {"ezhttp_get_user_data", ezhttp_get_user_data},
@@ -1211,6 +2019,16 @@ AMX_NATIVE_INFO g_Natives[] =
 
         // queue
         {"ezhttp_create_queue", ezhttp_create_queue},
+        {"ezhttp_get_queue_depth", ezhttp_get_queue_depth},
+        {"ezhttp_get_tls_handshakes", ezhttp_get_tls_handshakes},
+        {"ezhttp_get_queue_threads", ezhttp_get_queue_threads},
+        {"ezhttp_queue_set_max_per_host", ezhttp_queue_set_max_per_host},
+        {"ezhttp_queue_set_rate_limit", ezhttp_queue_set_rate_limit},
+        {"ezhttp_set_host_rate_limit", ezhttp_set_host_rate_limit},
+        {"ezhttp_queue_set_connect_policy", ezhttp_queue_set_connect_policy},
+        {"ezhttp_set_host_connect_policy", ezhttp_set_host_connect_policy},
+        {"ezhttp_set_cache_size", ezhttp_set_cache_size},
+        {"ezhttp_set_disk_cache_size", ezhttp_set_disk_cache_size},
 
         // special
         {"_ezhttp_steam_to_steam64", ezhttp_steam_to_steam64},
@@ -1226,6 +2044,8 @@ void OnAmxxAttach()
 
     CVAR_REGISTER(&cvar_ezhttp_version);
     CVAR_REGISTER(&cvar_ezhttp_trace);
+    CVAR_REGISTER(&cvar_ezjson_max_handles);
+    REG_SVR_COMMAND("ezjson_stats", JsonStatsCommand);
 
     CreateModules();
 }
@@ -1243,6 +2063,9 @@ void OnPluginsUnloading()
     if (g_EasyHttpModule && !g_MapChangeResetDone)
         g_EasyHttpModule->ServerDeactivate();
 
+    if (g_JsonAsyncIO)
+        g_JsonAsyncIO->DropPending();
+
     if (g_JsonManager)
         g_JsonManager->FreeAllHandles();
 
@@ -1260,10 +2083,14 @@ void ServerActivate(edict_t * /*pEdictList*/, int /*edictCount*/, int /*clientMa
 void StartFrame()
 {
     RefreshTraceLogSetting();
+    RefreshJsonLimitSetting();
 
     if (g_EasyHttpModule)
         g_EasyHttpModule->RunFrame();
 
+    if (g_JsonAsyncIO && g_JsonManager)
+        g_JsonAsyncIO->RunFrame(*g_JsonManager);
+
     SET_META_RESULT(MRES_IGNORED);
 }
 
@@ -1277,6 +2104,9 @@ void ServerDeactivate()
 
     g_MapChangeResetDone = true;
 
+    if (g_JsonAsyncIO)
+        g_JsonAsyncIO->DropPending();
+
     if (g_JsonManager)
         g_JsonManager->FreeAllHandles();
 
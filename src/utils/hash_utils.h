@@ -0,0 +1,9 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+namespace utils
+{
+    // SHA-256 of the data as 64 lowercase hex digits. Portable, so it doesn't depend on the TLS backend of curl
+    std::string Sha256Hex(std::string_view data);
+}
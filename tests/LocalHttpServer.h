@@ -0,0 +1,131 @@
+#pragma once
+#ifndef _WIN32
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Serves one request per connection on 127.0.0.1 and closes it, connections are served in parallel.
+// The status of a response is chosen by the test from the path and the number of requests to that path
+// so far, starting at 0. A test that sleeps in the callback gets a slow server
+class LocalHttpServer
+{
+public:
+    using StatusForRequest = std::function<int(const std::string &path, int index)>;
+
+private:
+    StatusForRequest status_for_request_;
+    int listen_fd_ = -1;
+    std::thread thread_;
+    std::atomic<bool> stop_{false};
+
+    std::mutex mutex_;
+    std::map<std::string, int> request_counts_;
+    std::vector<std::thread> connection_threads_;
+    int requests_in_progress_ = 0;
+    int max_requests_in_progress_ = 0;
+
+public:
+    explicit LocalHttpServer(StatusForRequest status_for_request) : status_for_request_(std::move(status_for_request))
+    {
+        listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(listen_fd_, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+        listen(listen_fd_, 16);
+
+        thread_ = std::thread([this]()
+                              {
+                                  while (!stop_.load())
+                                  {
+                                      const int client_fd = accept(listen_fd_, nullptr, nullptr);
+                                      if (client_fd < 0)
+                                          continue;
+
+                                      std::lock_guard lock_guard(mutex_);
+                                      connection_threads_.emplace_back([this, client_fd]()
+                                                                       {
+                                                                           Serve(client_fd);
+                                                                           close(client_fd);
+                                                                       });
+                                  }
+                              });
+    }
+
+    ~LocalHttpServer()
+    {
+        stop_.store(true);
+        shutdown(listen_fd_, SHUT_RDWR);
+        thread_.join();
+        close(listen_fd_);
+
+        for (auto &connection_thread : connection_threads_)
+            connection_thread.join();
+    }
+
+    LocalHttpServer(const LocalHttpServer &) = delete;
+    LocalHttpServer &operator=(const LocalHttpServer &) = delete;
+
+    [[nodiscard]] std::string GetUrl(const std::string &path) const
+    {
+        sockaddr_in address{};
+        socklen_t length = sizeof(address);
+        getsockname(listen_fd_, reinterpret_cast<sockaddr *>(&address), &length);
+        return "http://127.0.0.1:" + std::to_string(ntohs(address.sin_port)) + path;
+    }
+
+    int GetRequestCount(const std::string &path)
+    {
+        std::lock_guard lock_guard(mutex_);
+        return request_counts_[path];
+    }
+
+    // The most requests that were being answered at the same time
+    int GetMaxRequestsInProgress()
+    {
+        std::lock_guard lock_guard(mutex_);
+        return max_requests_in_progress_;
+    }
+
+private:
+    void Serve(int client_fd)
+    {
+        std::string request;
+        char buffer[1024];
+        ssize_t received;
+        while (request.find("\r\n\r\n") == std::string::npos && (received = recv(client_fd, buffer, sizeof(buffer), 0)) > 0)
+            request.append(buffer, received);
+
+        // GET /path HTTP/1.1
+        const size_t path_begin = request.find(' ') + 1;
+        const std::string path = request.substr(path_begin, request.find(' ', path_begin) - path_begin);
+
+        int index;
+        {
+            std::lock_guard lock_guard(mutex_);
+            index = request_counts_[path]++;
+            max_requests_in_progress_ = std::max(max_requests_in_progress_, ++requests_in_progress_);
+        }
+
+        const int status = status_for_request_(path, index);
+        {
+            std::lock_guard lock_guard(mutex_);
+            --requests_in_progress_;
+        }
+
+        const std::string response = "HTTP/1.1 " + std::to_string(status) + " Status\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        send(client_fd, response.data(), response.size(), MSG_NOSIGNAL);
+    }
+};
+#endif
@@ -0,0 +1,82 @@
+// Measures get/return throughput of the session pool when many workers use it at once:
+// every worker requesting its own host, and all of them requesting one host.
+// Not a part of the test run, start AmxxEasyHttp-session_cache_benchmark manually.
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <easy_http/datetime_service/DateTimeService.h>
+#include <easy_http/session_cache/CprSessionCache.h>
+#include <easy_http/session_factory/CprSessionFactory.h>
+
+using namespace ezhttp;
+using namespace std::chrono_literals;
+
+namespace
+{
+    constexpr int kIterationsPerThread = 100000;
+    constexpr uint32_t kMaxSessionsPerHost = 32; // every worker finds a pooled handle, so only the pool is measured
+
+    double MeasureOpsPerSecond(int thread_count, bool same_host)
+    {
+        CprSessionCache session_cache(std::make_shared<CprSessionFactory>(), std::make_shared<DateTimeService>(), 118s, kMaxSessionsPerHost);
+
+        std::vector<std::string> urls;
+        std::vector<OriginId> origins;
+        for (int i = 0; i < thread_count; ++i)
+        {
+            urls.push_back(same_host ? "https://example.com/" : "https://host" + std::to_string(i) + ".example.com/");
+            origins.push_back(session_cache.GetOrigins().InternUrl(urls.back()));
+        }
+
+        std::atomic<int> ready{0};
+        std::atomic<bool> go{false};
+        std::vector<std::thread> threads;
+        for (int i = 0; i < thread_count; ++i)
+        {
+            threads.emplace_back([&, i]()
+                                 {
+                                     ready.fetch_add(1);
+                                     while (!go.load())
+                                         std::this_thread::yield();
+
+                                     for (int j = 0; j < kIterationsPerThread; ++j)
+                                     {
+                                         auto session = session_cache.GetSessionForOrigin(urls[i], origins[i]);
+                                         session_cache.ReturnSessionToOrigin(origins[i], session->GetCurlHolder());
+                                     }
+                                 });
+        }
+
+        while (ready.load() != thread_count)
+            std::this_thread::yield();
+
+        const auto start = std::chrono::steady_clock::now();
+        go.store(true);
+        for (auto &thread : threads)
+            thread.join();
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+
+        const double seconds = std::chrono::duration<double>(elapsed).count();
+        return static_cast<double>(thread_count) * kIterationsPerThread / seconds;
+    }
+}
+
+int main()
+{
+    std::printf("session pool get+return, %d per thread\n", kIterationsPerThread);
+    std::printf("  threads   own host ops/s   same host ops/s\n");
+
+    for (int thread_count : {1, 6, 32})
+    {
+        const double own_host = MeasureOpsPerSecond(thread_count, false);
+        const double same_host = MeasureOpsPerSecond(thread_count, true);
+        std::printf("  %7d %16.0f %17.0f\n", thread_count, own_host, same_host);
+    }
+
+    return 0;
+}
@@ -0,0 +1,63 @@
+// Measures the per-request cost of configuring a pooled curl handle: every option set again
+// versus only the options that differ from the ones the handle already has.
+// Not a part of the test run, start AmxxEasyHttp-session_setup_benchmark manually.
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <optional>
+
+#include <cpr/session.h>
+#include <easy_http/session_cache/SessionSettings.h>
+
+using namespace ezhttp;
+
+namespace
+{
+    constexpr int kIterations = 100000;
+
+    SessionSettings MakeSettings()
+    {
+        SessionSettings settings;
+        settings.ca_info = "amxx_easy_http_cacert.pem";
+        settings.timeout_ms = 5000;
+        settings.connect_timeout_ms = 2000;
+        settings.SetAuth(cpr::Authentication{"user", "password", cpr::AuthMode::BASIC});
+        return settings;
+    }
+
+    template <class TSetup>
+    double MeasureNsPerRequest(TSetup setup)
+    {
+        auto curl_holder = std::make_shared<cpr::CurlHolder>();
+        std::optional<SessionSettings> applied = SessionSettings{};
+
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kIterations; ++i)
+        {
+            cpr::Session session(curl_holder);
+            setup(session, applied);
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / kIterations;
+    }
+}
+
+int main()
+{
+    const SessionSettings desired = MakeSettings();
+
+    const double full_ns = MeasureNsPerRequest([&desired](cpr::Session &session, std::optional<SessionSettings> &applied)
+                                               {
+                                                   applied.reset();
+                                                   ApplySessionSettings(session, applied, desired);
+                                               });
+
+    const double delta_ns = MeasureNsPerRequest([&desired](cpr::Session &session, std::optional<SessionSettings> &applied)
+                                                { ApplySessionSettings(session, applied, desired); });
+
+    std::printf("session setup, %d requests on one handle\n", kIterations);
+    std::printf("  every option: %10.1f ns/request\n", full_ns);
+    std::printf("  delta only:   %10.1f ns/request\n", delta_ns);
+    return 0;
+}
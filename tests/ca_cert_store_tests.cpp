@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+
+#include <easy_http/CaCertStore.h>
+
+using namespace ezhttp;
+
+#ifndef _WIN32
+namespace
+{
+    // two self-signed certificates
+    const char *const kCaBundle =
+        "-----BEGIN CERTIFICATE-----\n"
+        "MIIBhzCCAS2gAwIBAgIUSYvXX9ZjqPvwSIRrmHtROracP+YwCgYIKoZIzj0EAwIw\n"
+        "GDEWMBQGA1UEAwwNZXpodHRwIHRlc3QgYTAgFw0yNjEwMTkwNjIyNTBaGA8yMTI2\n"
+        "MDkyNTA2MjI1MFowGDEWMBQGA1UEAwwNZXpodHRwIHRlc3QgYTBZMBMGByqGSM49\n"
+        "AgEGCCqGSM49AwEHA0IABN6qLCOeiYmG1WuihyJZXfHbILjbF3/5miAe3ESzaew6\n"
+        "5Wx3LE9Rr0Q7kU26gO/HgcZi5jA+jCiVZ4tFNPUpAjKjUzBRMB0GA1UdDgQWBBR3\n"
+        "hfeTzkifQe15iSmbytEWupnKpDAfBgNVHSMEGDAWgBR3hfeTzkifQe15iSmbytEW\n"
+        "upnKpDAPBgNVHRMBAf8EBTADAQH/MAoGCCqGSM49BAMCA0gAMEUCIQDMUKS2iv+D\n"
+        "A0q70B/oHn3QLYtCGFxMuGq57FbWY5BWtQIgAKru90n3qxjLZk+AYyq3tDWIhWqA\n"
+        "IFY1MoOOafyWh+I=\n"
+        "-----END CERTIFICATE-----\n"
+        "-----BEGIN CERTIFICATE-----\n"
+        "MIIBhzCCAS2gAwIBAgIUKrfEdHdsAiOXehus54MyyTDX6LUwCgYIKoZIzj0EAwIw\n"
+        "GDEWMBQGA1UEAwwNZXpodHRwIHRlc3QgYjAgFw0yNjEwMTkwNjIyNTBaGA8yMTI2\n"
+        "MDkyNTA2MjI1MFowGDEWMBQGA1UEAwwNZXpodHRwIHRlc3QgYjBZMBMGByqGSM49\n"
+        "AgEGCCqGSM49AwEHA0IABHwVDq4wGqSHmxGn96Gq6cTYJj3+NueYLgK5vg0VsReY\n"
+        "5UaJVPAlyYI8VbXUnY0mGLa0O/DiQN2XK43JSjQufF6jUzBRMB0GA1UdDgQWBBTX\n"
+        "EV5HjGwFE4TqH3gYKFTZ2c/WSTAfBgNVHSMEGDAWgBTXEV5HjGwFE4TqH3gYKFTZ\n"
+        "2c/WSTAPBgNVHRMBAf8EBTADAQH/MAoGCCqGSM49BAMCA0gAMEUCIQCulpRP5dgJ\n"
+        "uMIz/H7KnbvR8w8KqbFd1cB++GTvyycLeQIgJNFXJ8XwqF7m8Wu8k9kwdGnTcH0g\n"
+        "+8/7aeiWmrWpw0I=\n"
+        "-----END CERTIFICATE-----\n";
+
+    class CaCertStoreTest : public testing::Test
+    {
+    protected:
+        std::filesystem::path path_ = std::filesystem::temp_directory_path() / "ezhttp_ca_cert_store_test.pem";
+
+        void TearDown() override
+        {
+            std::filesystem::remove(path_);
+        }
+
+        void WriteBundle(const std::string &contents) const
+        {
+            std::ofstream(path_, std::ios::binary | std::ios::trunc) << contents;
+        }
+    };
+}
+
+TEST_F(CaCertStoreTest, LoadsBundleOnce)
+{
+    WriteBundle(kCaBundle);
+
+    CaCertStore store(path_.string());
+    EXPECT_TRUE(store.IsLoaded());
+    EXPECT_EQ(2u, store.GetCertCount());
+
+    CURL *curl = curl_easy_init();
+    EXPECT_TRUE(store.Apply(curl));
+    curl_easy_cleanup(curl);
+}
+
+TEST_F(CaCertStoreTest, FallsBackToPathIfBundleIsUnusable)
+{
+    CaCertStore missing(path_.string());
+    EXPECT_FALSE(missing.IsLoaded());
+    EXPECT_EQ(path_.string(), missing.GetPath());
+
+    WriteBundle("not a certificate");
+    CaCertStore garbage(path_.string());
+    EXPECT_FALSE(garbage.IsLoaded());
+
+    CURL *curl = curl_easy_init();
+    EXPECT_FALSE(garbage.Apply(curl));
+    curl_easy_cleanup(curl);
+}
+#endif
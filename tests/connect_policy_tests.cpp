@@ -0,0 +1,46 @@
+#include <gtest/gtest.h>
+
+#include <easy_http/ConnectPolicy.h>
+
+using namespace ezhttp;
+
+TEST(ConnectPolicyTest, HostPolicyFallsBackToQueuePolicy)
+{
+    const ConnectPolicy queue_policy{IpVersion::V4, 50, std::string()};
+    const ConnectPolicy host_policy{IpVersion::Any, -1, "10.0.0.1,10.0.0.2"};
+
+    const ConnectPolicy policy = host_policy.WithFallback(queue_policy);
+    EXPECT_EQ(IpVersion::V4, policy.ip_version);
+    EXPECT_EQ(50, policy.happy_eyeballs_timeout_ms);
+    EXPECT_EQ("10.0.0.1,10.0.0.2", policy.resolve_addresses);
+
+    const ConnectPolicy ipv6_policy = ConnectPolicy{IpVersion::V6, 0, std::string()}.WithFallback(queue_policy);
+    EXPECT_EQ(IpVersion::V6, ipv6_policy.ip_version);
+    EXPECT_EQ(0, ipv6_policy.happy_eyeballs_timeout_ms);
+}
+
+TEST(ConnectPolicyTest, DefaultPolicyRemovesEntry)
+{
+    ConnectPolicies policies;
+    EXPECT_TRUE(policies.Empty());
+
+    policies.Set("example.com", ConnectPolicy{IpVersion::V4, -1, std::string()});
+    ASSERT_TRUE(policies.Find("example.com"));
+    EXPECT_EQ(IpVersion::V4, policies.Find("example.com")->ip_version);
+    EXPECT_FALSE(policies.Find("other.com"));
+
+    policies.Set("example.com", ConnectPolicy{});
+    EXPECT_FALSE(policies.Find("example.com"));
+    EXPECT_TRUE(policies.Empty());
+}
+
+TEST(ConnectPolicyTest, ResolveAddressesMustBeIpLiterals)
+{
+    EXPECT_TRUE(ConnectPolicy::IsValidResolveAddresses("127.0.0.1"));
+    EXPECT_TRUE(ConnectPolicy::IsValidResolveAddresses("10.0.0.1,[2001:db8::1],2001:db8::2"));
+
+    EXPECT_FALSE(ConnectPolicy::IsValidResolveAddresses(""));
+    EXPECT_FALSE(ConnectPolicy::IsValidResolveAddresses("10.0.0.1,"));
+    EXPECT_FALSE(ConnectPolicy::IsValidResolveAddresses("example.com"));
+    EXPECT_FALSE(ConnectPolicy::IsValidResolveAddresses("10.0.0.1 10.0.0.2"));
+}
@@ -0,0 +1,176 @@
+#ifndef _WIN32
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <easy_http/datetime_service/DateTimeService.h>
+#include <easy_http/session_cache/ConnectionHealth.h>
+#include <easy_http/session_cache/CprSessionCache.h>
+#include <easy_http/session_factory/CprSessionFactory.h>
+
+using namespace ezhttp;
+using namespace std::chrono_literals;
+
+namespace
+{
+    // Answers one keep-alive request and keeps the connection open until Close()
+    class KeepAliveServer
+    {
+        int listen_fd_ = -1;
+        int client_fd_ = -1;
+        std::thread thread_;
+
+    public:
+        KeepAliveServer()
+        {
+            listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            bind(listen_fd_, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+            listen(listen_fd_, 1);
+
+            thread_ = std::thread([this]()
+                                  {
+                                      client_fd_ = accept(listen_fd_, nullptr, nullptr);
+
+                                      std::string request;
+                                      char buffer[1024];
+                                      ssize_t received;
+                                      while (request.find("\r\n\r\n") == std::string::npos && (received = recv(client_fd_, buffer, sizeof(buffer), 0)) > 0)
+                                          request.append(buffer, received);
+
+                                      const std::string response = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok";
+                                      send(client_fd_, response.data(), response.size(), 0);
+                                  });
+        }
+
+        ~KeepAliveServer()
+        {
+            Close();
+            close(listen_fd_);
+        }
+
+        [[nodiscard]] std::string GetUrl() const
+        {
+            sockaddr_in address{};
+            socklen_t length = sizeof(address);
+            getsockname(listen_fd_, reinterpret_cast<sockaddr *>(&address), &length);
+            return "http://127.0.0.1:" + std::to_string(ntohs(address.sin_port)) + "/";
+        }
+
+        void Close()
+        {
+            if (thread_.joinable())
+                thread_.join();
+
+            if (client_fd_ >= 0)
+                close(client_fd_);
+
+            client_fd_ = -1;
+        }
+    };
+
+    size_t DiscardBody(char * /*data*/, size_t size, size_t count, void * /*user_data*/)
+    {
+        return size * count;
+    }
+
+    void Perform(CURL *curl, const std::string &url)
+    {
+        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, DiscardBody);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 5L);
+        ASSERT_EQ(CURLE_OK, curl_easy_perform(curl));
+    }
+
+    // the FIN of the server takes a moment even on loopback
+    ConnectionState WaitForClosed(CURL *curl)
+    {
+        ConnectionState state = ProbeConnection(curl);
+        for (int i = 0; i < 100 && state != ConnectionState::Closed; ++i)
+        {
+            std::this_thread::sleep_for(10ms);
+            state = ProbeConnection(curl);
+        }
+
+        return state;
+    }
+}
+
+TEST(ConnectionHealthTest, DetectsConnectionClosedByServer)
+{
+    CURL *curl = curl_easy_init();
+    EXPECT_EQ(ConnectionState::None, ProbeConnection(curl));
+
+    KeepAliveServer server;
+    Perform(curl, server.GetUrl());
+    EXPECT_EQ(ConnectionState::Alive, ProbeConnection(curl));
+
+    server.Close();
+    EXPECT_EQ(ConnectionState::Closed, WaitForClosed(curl));
+
+    curl_easy_cleanup(curl);
+}
+
+TEST(ConnectionHealthTest, ClosedPooledConnectionsAreNotReused)
+{
+    CprSessionCache session_cache(std::make_shared<CprSessionFactory>(), std::make_shared<DateTimeService>(), 30s, 3);
+
+    KeepAliveServer server;
+    const std::string url = server.GetUrl();
+    const OriginId origin = session_cache.GetOrigins().InternUrl(url);
+
+    auto curl_holder = std::make_shared<cpr::CurlHolder>();
+    Perform(curl_holder->handle, url);
+    session_cache.ReturnSessionToOrigin(origin, curl_holder);
+
+    server.Close();
+    ASSERT_EQ(ConnectionState::Closed, WaitForClosed(curl_holder->handle));
+
+    auto session = session_cache.GetSessionForOrigin(url, origin);
+    EXPECT_NE(curl_holder, session->GetCurlHolder());
+    EXPECT_EQ(0u, session_cache.GetPooledCount());
+}
+
+TEST(ConnectionHealthTest, EvictIdleKeepsLiveConnectionsInOrder)
+{
+    CprSessionCache session_cache(std::make_shared<CprSessionFactory>(), std::make_shared<DateTimeService>(), 30s, 3);
+
+    KeepAliveServer live_server;
+    KeepAliveServer closed_server;
+    const std::string live_url = live_server.GetUrl();
+    const std::string closed_url = closed_server.GetUrl();
+    const OriginId live_origin = session_cache.GetOrigins().InternUrl(live_url);
+    const OriginId closed_origin = session_cache.GetOrigins().InternUrl(closed_url);
+
+    auto older_holder = std::make_shared<cpr::CurlHolder>();
+    Perform(older_holder->handle, live_url);
+    session_cache.ReturnSessionToOrigin(live_origin, older_holder);
+
+    auto newer_holder = std::make_shared<cpr::CurlHolder>();
+    session_cache.ReturnSessionToOrigin(live_origin, newer_holder);
+
+    auto closed_holder = std::make_shared<cpr::CurlHolder>();
+    Perform(closed_holder->handle, closed_url);
+    session_cache.ReturnSessionToOrigin(closed_origin, closed_holder);
+
+    closed_server.Close();
+    ASSERT_EQ(ConnectionState::Closed, WaitForClosed(closed_holder->handle));
+
+    // the handles are probed out of the pool and the live ones are put back
+    EXPECT_EQ(1u, session_cache.EvictIdle());
+    EXPECT_EQ(2u, session_cache.GetPooledCount());
+
+    EXPECT_EQ(newer_holder, session_cache.GetSessionForOrigin(live_url, live_origin)->GetCurlHolder());
+    EXPECT_EQ(older_holder, session_cache.GetSessionForOrigin(live_url, live_origin)->GetCurlHolder());
+}
+#endif
@@ -0,0 +1,234 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include <easy_http/DiskResponseCache.h>
+#include <easy_http/ResponseCache.h>
+#include <utils/hash_utils.h>
+
+using namespace ezhttp;
+
+namespace
+{
+    const cpr::Url kUrl{"https://example.com/motd"};
+
+    class DiskResponseCacheTest : public testing::Test
+    {
+    protected:
+        std::filesystem::path directory_ = std::filesystem::temp_directory_path() / "ezhttp_disk_cache_test";
+
+        void SetUp() override
+        {
+            std::filesystem::remove_all(directory_);
+        }
+
+        void TearDown() override
+        {
+            std::filesystem::remove_all(directory_);
+        }
+
+        size_t CountFiles(const std::string &extension) const
+        {
+            size_t count = 0;
+            for (const auto &entry : std::filesystem::directory_iterator(directory_))
+                count += entry.path().extension() == extension;
+
+            return count;
+        }
+
+        static Response MakeResponse(const std::string &text)
+        {
+            Response response;
+            response.status_code = 200;
+            response.url = kUrl;
+            response.header = {{"Cache-Control", "max-age=60"}, {"ETag", "\"v1\""}};
+            response.SetText(text);
+            return response;
+        }
+    };
+}
+
+TEST_F(DiskResponseCacheTest, ResponsesSurviveReload)
+{
+    {
+        DiskResponseCache cache(directory_, 1024);
+        cache.Store("motd", MakeResponse("welcome"), 1000);
+    }
+
+    DiskResponseCache cache(directory_, 1024);
+    ASSERT_EQ(1u, cache.GetCount());
+
+    std::time_t expires_at = 0;
+    auto response = cache.Load("motd", kUrl, expires_at);
+    ASSERT_TRUE(response);
+    EXPECT_EQ("welcome", response->text());
+    EXPECT_EQ(200, response->status_code);
+    EXPECT_EQ("\"v1\"", response->header["ETag"]);
+    EXPECT_EQ("https://example.com/motd", response->url.str());
+    EXPECT_EQ(1000, expires_at);
+}
+
+TEST_F(DiskResponseCacheTest, IdenticalBodiesShareBlob)
+{
+    DiskResponseCache cache(directory_, 1024);
+    cache.Store("a", MakeResponse("same body"), 1000);
+    cache.Store("b", MakeResponse("same body"), 1000);
+
+    EXPECT_EQ(2u, cache.GetCount());
+    EXPECT_EQ(9u, cache.GetSize());
+    EXPECT_EQ(1u, CountFiles(".blob"));
+
+    cache.Remove("a");
+    EXPECT_EQ(1u, CountFiles(".blob"));
+
+    cache.Remove("b");
+    EXPECT_EQ(0u, CountFiles(".blob"));
+    EXPECT_EQ(0u, cache.GetSize());
+}
+
+TEST_F(DiskResponseCacheTest, EvictsLeastRecentlyUsed)
+{
+    DiskResponseCache cache(directory_, 25);
+    cache.Store("a", MakeResponse(std::string(10, 'a')), 1000);
+    cache.Store("b", MakeResponse(std::string(10, 'b')), 1000);
+
+    std::time_t expires_at;
+    ASSERT_TRUE(cache.Load("a", kUrl, expires_at));
+
+    cache.Store("c", MakeResponse(std::string(10, 'c')), 1000);
+    EXPECT_TRUE(cache.Load("a", kUrl, expires_at));
+    EXPECT_FALSE(cache.Load("b", kUrl, expires_at));
+    EXPECT_TRUE(cache.Load("c", kUrl, expires_at));
+    EXPECT_EQ(2u, CountFiles(".blob"));
+}
+
+TEST_F(DiskResponseCacheTest, RecoversFromInterruptedWrites)
+{
+    {
+        DiskResponseCache cache(directory_, 1024);
+        cache.Store("motd", MakeResponse("welcome"), 1000);
+    }
+
+    // a blob written right before a crash and a half written index
+    std::ofstream(directory_ / "0000000000000000-3.blob") << "old";
+    std::ofstream(directory_ / "index.bin.tmp") << "partial";
+
+    {
+        DiskResponseCache cache(directory_, 1024);
+        EXPECT_EQ(1u, cache.GetCount());
+        EXPECT_EQ(1u, CountFiles(".blob"));
+        EXPECT_EQ(0u, CountFiles(".tmp"));
+    }
+
+    // a corrupted index is dropped with the blobs it referenced
+    std::ofstream(directory_ / "index.bin", std::ios::binary | std::ios::trunc) << "garbage";
+
+    DiskResponseCache cache(directory_, 1024);
+    EXPECT_EQ(0u, cache.GetCount());
+    EXPECT_EQ(0u, CountFiles(".blob"));
+}
+
+TEST_F(DiskResponseCacheTest, IndexDoesNotContainKeys)
+{
+    // a coalescing key carries the request headers and the proxy credentials
+    const std::string key = "GET https://example.com/motd|Authorization: Bearer secret-token|proxy_auth=user:secret-password";
+    {
+        DiskResponseCache cache(directory_, 1024);
+        cache.Store(key, MakeResponse("welcome"), 1000);
+    }
+
+    std::ifstream index_file(directory_ / "index.bin", std::ios::binary);
+    const std::string index((std::istreambuf_iterator<char>(index_file)), std::istreambuf_iterator<char>());
+    EXPECT_FALSE(index.empty());
+    EXPECT_EQ(std::string::npos, index.find("secret"));
+
+    DiskResponseCache cache(directory_, 1024);
+    std::time_t expires_at = 0;
+    auto response = cache.Load(key, kUrl, expires_at);
+    ASSERT_TRUE(response);
+    EXPECT_EQ("welcome", response->text());
+    EXPECT_FALSE(cache.Load("GET https://example.com/motd", kUrl, expires_at));
+}
+
+TEST_F(DiskResponseCacheTest, IndexDoesNotContainUrlsOrCookies)
+{
+    Response response = MakeResponse("welcome");
+    response.url = cpr::Url{"https://example.com/motd?api_key=secret-key"};
+    response.header["Set-Cookie"] = "session=secret-session";
+    {
+        DiskResponseCache cache(directory_, 1024);
+        cache.Store("motd", response, 1000);
+    }
+
+    std::ifstream index_file(directory_ / "index.bin", std::ios::binary);
+    const std::string index((std::istreambuf_iterator<char>(index_file)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(std::string::npos, index.find("secret"));
+
+    // the response gets the url it is requested with
+    DiskResponseCache cache(directory_, 1024);
+    std::time_t expires_at = 0;
+    auto loaded = cache.Load("motd", kUrl, expires_at);
+    ASSERT_TRUE(loaded);
+    EXPECT_EQ(kUrl.str(), loaded->url.str());
+    EXPECT_EQ(0u, loaded->header.count("Set-Cookie"));
+    EXPECT_EQ("\"v1\"", loaded->header["ETag"]);
+}
+
+TEST_F(DiskResponseCacheTest, BlobsAreNamedBySha256)
+{
+    DiskResponseCache cache(directory_, 1024);
+    cache.Store("motd", MakeResponse("welcome"), 1000);
+
+    EXPECT_TRUE(std::filesystem::exists(directory_ / (utils::Sha256Hex("welcome") + ".blob")));
+}
+
+TEST_F(DiskResponseCacheTest, OldIndexWithKeysIsRemoved)
+{
+    {
+        DiskResponseCache cache(directory_, 1024);
+        cache.Store("motd", MakeResponse("welcome"), 1000);
+    }
+
+    // version 1 wrote the keys themselves and version 2 the urls, the magic is followed by the version
+    std::fstream index_file(directory_ / "index.bin", std::ios::binary | std::ios::in | std::ios::out);
+    const uint32_t old_version = 1;
+    index_file.seekp(sizeof(uint32_t));
+    index_file.write(reinterpret_cast<const char *>(&old_version), sizeof(old_version));
+    index_file.close();
+
+    DiskResponseCache cache(directory_, 1024);
+    EXPECT_EQ(0u, cache.GetCount());
+    EXPECT_FALSE(std::filesystem::exists(directory_ / "index.bin"));
+    EXPECT_EQ(0u, CountFiles(".blob"));
+}
+
+TEST_F(DiskResponseCacheTest, ResponseCacheFallsBackToDisk)
+{
+    const auto now = ResponseCache::Clock::now();
+    const std::time_t date_now = 1000;
+
+    ResponseCache first(1024);
+    first.SetDiskCache(std::make_shared<DiskResponseCache>(directory_, 1024));
+    first.Store("motd", MakeResponse("welcome"), now, date_now);
+
+    // as if the server was restarted
+    ResponseCache second(1024);
+    second.SetDiskCache(std::make_shared<DiskResponseCache>(directory_, 1024));
+    EXPECT_FALSE(second.Find("motd", now));
+
+    auto cached = second.FindOnDisk("motd", kUrl, now, date_now + 30);
+    ASSERT_TRUE(cached);
+    EXPECT_TRUE(cached->fresh);
+    EXPECT_TRUE(cached->response.from_cache);
+    EXPECT_EQ("welcome", cached->response.text());
+
+    // kept in memory with the remaining lifetime
+    cached = second.Find("motd", now + std::chrono::seconds(31));
+    ASSERT_TRUE(cached);
+    EXPECT_FALSE(cached->fresh);
+    EXPECT_EQ("\"v1\"", cached->validators["If-None-Match"]);
+}
@@ -1,7 +1,11 @@
 #include <gtest/gtest.h>
 
+#include <chrono>
+
 #include <EasyHttpModule.h>
 
+#include "LocalHttpServer.h"
+
 TEST(EasyHttpModuleTest, SendRequestRejectsUnknownQueue)
 {
     EasyHttpModule module("test-ca.pem");
@@ -33,3 +37,54 @@ TEST(EasyHttpModuleTest, SendRequestRejectsInvalidPluginEndBehaviour)
 
     EXPECT_EQ(RequestId::Null, request_id);
 }
+
+TEST(EasyHttpModuleTest, QueuesShareExecutorThreads)
+{
+    EasyHttpModule module("test-ca.pem");
+
+    // the main queue keeps one thread
+    EXPECT_EQ(1, module.GetExecutorWorkerCount());
+
+    const QueueId lazy_queue_id = module.CreateQueue(3, 0);
+    EXPECT_EQ(1, module.GetExecutorWorkerCount());
+    EXPECT_EQ(0, module.GetQueueRunningCount(lazy_queue_id));
+
+    module.CreateQueue(2, 2);
+    EXPECT_EQ(3, module.GetExecutorWorkerCount());
+}
+
+TEST(EasyHttpModuleTest, BatchWithoutSendableRequestsIsRemoved)
+{
+    EasyHttpModule module("test-ca.pem");
+
+    OptionsData options;
+    options.queue_id = static_cast<QueueId>(999);
+
+    const BatchId batch_id = module.CreateBatch();
+    EXPECT_EQ(0, module.AddBatchRequest(batch_id, ezhttp::RequestMethod::HttpGet, "https://example.com/a", options));
+    EXPECT_EQ(1, module.AddBatchRequest(batch_id, ezhttp::RequestMethod::HttpGet, "https://example.com/b", options));
+
+    EXPECT_EQ(0u, module.SendBatch(batch_id, -1, -1));
+    EXPECT_FALSE(module.IsBatchExists(batch_id));
+}
+
+#ifndef _WIN32
+TEST(EasyHttpModuleTest, UnloadDoesNotWaitForRateLimitedRequests)
+{
+    LocalHttpServer server([](const std::string & /*path*/, int /*index*/) { return 200; });
+
+    auto module = std::make_unique<EasyHttpModule>("test-ca.pem");
+
+    // one request now, the next one in 100 seconds
+    module->SetHostRateLimit("127.0.0.1", 0.01, 1);
+    for (const char *path : {"/a", "/b", "/c"})
+        EXPECT_NE(RequestId::Null, module->SendRequest(ezhttp::RequestMethod::HttpGet, server.GetUrl(path), OptionsData()));
+
+    const auto unload_start = std::chrono::steady_clock::now();
+    module.reset();
+
+    EXPECT_LT(std::chrono::steady_clock::now() - unload_start, std::chrono::seconds(5));
+    EXPECT_EQ(0, server.GetRequestCount("/b"));
+    EXPECT_EQ(0, server.GetRequestCount("/c"));
+}
+#endif
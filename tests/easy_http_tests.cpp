@@ -0,0 +1,202 @@
+#ifndef _WIN32
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <easy_http/EasyHttp.h>
+
+#include "LocalHttpServer.h"
+
+using namespace ezhttp;
+using namespace std::chrono_literals;
+
+namespace
+{
+    class EasyHttpTest : public testing::Test
+    {
+    protected:
+        std::shared_ptr<RequestExecutor> executor_ = std::make_shared<RequestExecutor>(4, 0);
+
+        std::unique_ptr<EasyHttp> CreateEasyHttp(int max_concurrency, int max_per_host, std::shared_ptr<RateLimiter> host_rate_limiter = nullptr)
+        {
+            return std::make_unique<EasyHttp>(std::make_shared<CaCertStore>(std::string()), nullptr, std::make_shared<OriginRegistry>(), nullptr,
+                                              executor_, max_concurrency, max_per_host, std::move(host_rate_limiter));
+        }
+
+        static RequestOptionsSnapshot CreateRetryOptions(int max_attempts, std::chrono::milliseconds backoff)
+        {
+            auto options = std::make_shared<RequestOptions>();
+            options->retry_policy = RetryPolicy{};
+            options->retry_policy->max_attempts = max_attempts;
+            options->retry_policy->backoff_base = backoff;
+            options->retry_policy->backoff_cap = backoff;
+            options->retry_policy->jitter = 0.0;
+            return options;
+        }
+
+        // Runs frames until done() or the timeout
+        static bool RunFramesUntil(EasyHttpInterface &easy_http, const std::function<bool()> &done, std::chrono::milliseconds timeout = 5s)
+        {
+            const auto deadline = std::chrono::steady_clock::now() + timeout;
+            while (!done() && std::chrono::steady_clock::now() < deadline)
+            {
+                easy_http.RunFrame();
+                std::this_thread::sleep_for(1ms);
+            }
+
+            return done();
+        }
+    };
+}
+
+TEST_F(EasyHttpTest, RetriesOnGroupedQueueReleaseHostSlot)
+{
+    // every path fails once, so every request is retried once
+    LocalHttpServer server([](const std::string & /*path*/, int index) { return index == 0 ? 503 : 200; });
+    auto easy_http = CreateEasyHttp(2, 1);
+    const RequestOptionsSnapshot options = CreateRetryOptions(2, 1ms);
+
+    std::vector<Response> responses;
+    for (const char *path : {"/a", "/b", "/c"})
+        easy_http->SendRequest(RequestMethod::HttpGet, cpr::Url{server.GetUrl(path)}, options, [&responses](Response response) { responses.push_back(std::move(response)); });
+
+    // a retry that kept the slot of its host would stall the host with max_per_host = 1
+    ASSERT_TRUE(RunFramesUntil(*easy_http, [&responses]() { return responses.size() == 3; }));
+    for (const auto &response : responses)
+    {
+        EXPECT_EQ(200, response.status_code);
+        EXPECT_EQ(2, response.attempts);
+    }
+}
+
+TEST_F(EasyHttpTest, DroppedRequestsDoNotWaitForRateLimits)
+{
+    LocalHttpServer server([](const std::string & /*path*/, int /*index*/) { return 200; });
+
+    // one request now, the next one in 100 seconds
+    auto host_rate_limiter = std::make_shared<RateLimiter>();
+    host_rate_limiter->SetLimit("127.0.0.1", 0.01, 1);
+    auto easy_http = CreateEasyHttp(2, 0, host_rate_limiter);
+
+    int callbacks = 0;
+    for (const char *path : {"/a", "/b", "/c"})
+        easy_http->SendRequest(RequestMethod::HttpGet, cpr::Url{server.GetUrl(path)}, std::make_shared<RequestOptions>(), [&callbacks](Response) { ++callbacks; });
+
+    ASSERT_TRUE(RunFramesUntil(*easy_http, [&server]() { return server.GetRequestCount("/a") == 1; }));
+
+    // what the module does on unload
+    easy_http->ForgetAllRequests();
+    easy_http->DropPendingRequests();
+
+    EXPECT_TRUE(RunFramesUntil(*easy_http, [&easy_http]() { return easy_http->GetActiveRequestCount() == 0; }, 2s));
+    EXPECT_EQ(0, callbacks);
+    EXPECT_EQ(0, server.GetRequestCount("/b"));
+    EXPECT_EQ(0, server.GetRequestCount("/c"));
+}
+
+TEST_F(EasyHttpTest, ForgottenRequestsAreNotRetried)
+{
+    LocalHttpServer server([](const std::string & /*path*/, int /*index*/) { return 503; });
+    auto easy_http = CreateEasyHttp(2, 0);
+    const RequestOptionsSnapshot options = CreateRetryOptions(5, 200ms);
+
+    int callbacks = 0;
+    easy_http->SendRequest(RequestMethod::HttpGet, cpr::Url{server.GetUrl("/a")}, options, [&callbacks](Response) { ++callbacks; });
+    ASSERT_TRUE(RunFramesUntil(*easy_http, [&server]() { return server.GetRequestCount("/a") == 1; }));
+
+    // what the module does with the queues of a finished map, the retry may already be waiting for its backoff
+    easy_http->ForgetAllRequests();
+
+    EXPECT_TRUE(RunFramesUntil(*easy_http, [&easy_http]() { return easy_http->GetActiveRequestCount() == 0; }, 2s));
+    EXPECT_EQ(0, callbacks);
+    EXPECT_EQ(1, server.GetRequestCount("/a"));
+}
+
+TEST_F(EasyHttpTest, BatchRunsInParallel)
+{
+    LocalHttpServer server([](const std::string & /*path*/, int /*index*/)
+                           {
+                               std::this_thread::sleep_for(300ms);
+                               return 200;
+                           });
+    auto easy_http = CreateEasyHttp(4, 0);
+
+    std::vector<EasyHttpInterface::BatchRequest> batch;
+    int callbacks = 0;
+    for (const char *path : {"/a", "/b", "/c", "/d"})
+        batch.push_back({RequestMethod::HttpGet, cpr::Url{server.GetUrl(path)}, std::make_shared<RequestOptions>(), [&callbacks](Response) { ++callbacks; }});
+
+    const auto start = std::chrono::steady_clock::now();
+    easy_http->SendRequests(std::move(batch));
+
+    ASSERT_TRUE(RunFramesUntil(*easy_http, [&callbacks]() { return callbacks == 4; }));
+    EXPECT_EQ(4, server.GetMaxRequestsInProgress());
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 1s);
+}
+
+TEST_F(EasyHttpTest, RequestsReleasedByRateLimitRunInParallel)
+{
+    LocalHttpServer server([](const std::string & /*path*/, int /*index*/)
+                           {
+                               std::this_thread::sleep_for(300ms);
+                               return 200;
+                           });
+
+    // as after a 429 with Retry-After, the host is blocked and its requests wait together
+    auto host_rate_limiter = std::make_shared<RateLimiter>();
+    host_rate_limiter->BlockUntil("127.0.0.1", RateLimiter::Clock::now() + 200ms);
+    auto easy_http = CreateEasyHttp(4, 0, host_rate_limiter);
+
+    int callbacks = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (const char *path : {"/a", "/b", "/c", "/d"})
+        easy_http->SendRequest(RequestMethod::HttpGet, cpr::Url{server.GetUrl(path)}, std::make_shared<RequestOptions>(), [&callbacks](Response) { ++callbacks; });
+
+    ASSERT_TRUE(RunFramesUntil(*easy_http, [&callbacks]() { return callbacks == 4; }));
+    EXPECT_EQ(4, server.GetMaxRequestsInProgress());
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 1s);
+}
+
+TEST_F(EasyHttpTest, RetryInBackoffDoesNotHoldBackQueue)
+{
+    LocalHttpServer server([](const std::string &path, int index) { return path == "/flaky" && index == 0 ? 503 : 200; });
+
+    // not grouped by host, as on plugin queues, so every request is in one group
+    auto easy_http = CreateEasyHttp(2, 0);
+
+    std::vector<std::string> completed;
+    easy_http->SendRequest(RequestMethod::HttpGet, cpr::Url{server.GetUrl("/flaky")}, CreateRetryOptions(2, 1s), [&completed](Response) { completed.emplace_back("/flaky"); });
+    ASSERT_TRUE(RunFramesUntil(*easy_http, [&server]() { return server.GetRequestCount("/flaky") == 1; }));
+
+    easy_http->SendRequest(RequestMethod::HttpGet, cpr::Url{server.GetUrl("/other")}, std::make_shared<RequestOptions>(), [&completed](Response) { completed.emplace_back("/other"); });
+    ASSERT_TRUE(RunFramesUntil(*easy_http, [&completed]() { return !completed.empty(); }, 500ms));
+    EXPECT_EQ("/other", completed.front());
+
+    // the retry still runs once its backoff is over
+    ASSERT_TRUE(RunFramesUntil(*easy_http, [&completed]() { return completed.size() == 2; }));
+    EXPECT_EQ(2, server.GetRequestCount("/flaky"));
+}
+
+TEST_F(EasyHttpTest, FailedBodyFactoryFailsRequestWithoutSending)
+{
+    LocalHttpServer server([](const std::string & /*path*/, int /*index*/) { return 200; });
+    auto easy_http = CreateEasyHttp(1, 0);
+
+    auto options = std::make_shared<RequestOptions>();
+    options->body_factory = []() -> std::optional<std::string> { return std::nullopt; };
+
+    std::optional<Response> response;
+    easy_http->SendRequest(RequestMethod::HttpPost, cpr::Url{server.GetUrl("/a")}, options, [&response](Response result) { response = std::move(result); });
+
+    ASSERT_TRUE(RunFramesUntil(*easy_http, [&response]() { return response.has_value(); }));
+    EXPECT_EQ(cpr::ErrorCode::INTERNAL_ERROR, response->error.code);
+    EXPECT_EQ(0, server.GetRequestCount("/a"));
+}
+
+#endif
@@ -0,0 +1,20 @@
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <utils/hash_utils.h>
+
+TEST(HashUtilsTest, Sha256HexMatchesKnownDigests)
+{
+    EXPECT_EQ("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855", utils::Sha256Hex(""));
+    EXPECT_EQ("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad", utils::Sha256Hex("abc"));
+    EXPECT_EQ("248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1", utils::Sha256Hex("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"));
+}
+
+TEST(HashUtilsTest, Sha256HexHandlesBlockBoundaries)
+{
+    // 55 bytes fit the padding into one block, 56 need a second one
+    EXPECT_EQ("9f4390f8d30c2dd92ec9f095b65e2b9ae9b0a925a5258e241c9f1e910f734318", utils::Sha256Hex(std::string(55, 'a')));
+    EXPECT_EQ("b35439a4ac6f0948b6d6f9e3c6af0f5f590ce20f1bde7090ef7970686ec6738a", utils::Sha256Hex(std::string(56, 'a')));
+    EXPECT_EQ("ffe054fe7ae0cb6dc65c3af9b61d5209f439851db43d0ba5997337df154668eb", utils::Sha256Hex(std::string(64, 'a')));
+}
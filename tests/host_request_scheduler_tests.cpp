@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include <easy_http/HostRequestScheduler.h>
+
+using namespace ezhttp;
+
+TEST(HostRequestSchedulerTest, HostsTakeTurns)
+{
+    HostRequestScheduler<int> scheduler(10);
+    for (int i = 0; i < 3; ++i)
+        scheduler.Push("slow.example.com", RequestPriority::Normal, i);
+
+    scheduler.Push("fast.example.com", RequestPriority::Normal, 100);
+    scheduler.Push("fast.example.com", RequestPriority::Normal, 101);
+    EXPECT_EQ(2u, scheduler.GetHostCount());
+
+    std::string host;
+    int item;
+    const int expected[] = {0, 100, 1, 101, 2};
+    for (int value : expected)
+    {
+        ASSERT_TRUE(scheduler.TryPop(host, item));
+        EXPECT_EQ(value, item);
+    }
+
+    EXPECT_FALSE(scheduler.TryPop(host, item));
+    EXPECT_TRUE(scheduler.Empty());
+}
+
+TEST(HostRequestSchedulerTest, HostAtLimitDoesNotBlockOtherHosts)
+{
+    HostRequestScheduler<int> scheduler(2);
+    for (int i = 0; i < 5; ++i)
+        scheduler.Push("slow.example.com", RequestPriority::Normal, i);
+
+    std::string host;
+    int item;
+    ASSERT_TRUE(scheduler.TryPop(host, item));
+    ASSERT_TRUE(scheduler.TryPop(host, item));
+    EXPECT_FALSE(scheduler.TryPop(host, item));
+
+    scheduler.Push("fast.example.com", RequestPriority::Low, 100);
+    ASSERT_TRUE(scheduler.TryPop(host, item));
+    EXPECT_EQ("fast.example.com", host);
+    EXPECT_EQ(100, item);
+
+    scheduler.Finish("slow.example.com");
+    ASSERT_TRUE(scheduler.TryPop(host, item));
+    EXPECT_EQ(2, item);
+    EXPECT_EQ(2u, scheduler.Size());
+}
+
+TEST(HostRequestSchedulerTest, HigherPriorityHostGoesFirstButLowerIsNotStarved)
+{
+    const int starvation_limit = 2;
+    HostRequestScheduler<int> scheduler(10, starvation_limit);
+    scheduler.Push("bulk.example.com", RequestPriority::Low, -1);
+    for (int i = 0; i < 5; ++i)
+        scheduler.Push("api.example.com", RequestPriority::High, i);
+
+    std::string host;
+    int item;
+    for (int i = 0; i < starvation_limit; ++i)
+    {
+        ASSERT_TRUE(scheduler.TryPop(host, item));
+        EXPECT_EQ(i, item);
+    }
+
+    ASSERT_TRUE(scheduler.TryPop(host, item));
+    EXPECT_EQ(-1, item);
+    EXPECT_EQ(0u, scheduler.Size(RequestPriority::Low));
+}
+
+TEST(HostRequestSchedulerTest, ClearKeepsInFlightCounters)
+{
+    HostRequestScheduler<int> scheduler(1);
+    scheduler.Push("example.com", RequestPriority::Normal, 1);
+    scheduler.Push("example.com", RequestPriority::Normal, 2);
+
+    std::string host;
+    int item;
+    ASSERT_TRUE(scheduler.TryPop(host, item));
+    scheduler.Clear();
+    EXPECT_TRUE(scheduler.Empty());
+
+    scheduler.Push("example.com", RequestPriority::Normal, 3);
+    EXPECT_FALSE(scheduler.TryPop(host, item));
+
+    scheduler.Finish("example.com");
+    ASSERT_TRUE(scheduler.TryPop(host, item));
+    EXPECT_EQ(3, item);
+}
+
+TEST(HostRequestSchedulerTest, DeclinedHostIsSkipped)
+{
+    HostRequestScheduler<int> scheduler(10);
+    scheduler.Push("limited.example.com", RequestPriority::High, 1);
+    scheduler.Push("free.example.com", RequestPriority::Low, 2);
+
+    auto try_start = [](int item) { return item != 1; };
+
+    std::string host;
+    int item;
+    ASSERT_TRUE(scheduler.TryPop(host, item, try_start));
+    EXPECT_EQ(2, item);
+    EXPECT_FALSE(scheduler.TryPop(host, item, try_start));
+    EXPECT_EQ(1u, scheduler.Size());
+}
@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <json/JsonAsyncIO.h>
+#include <json/JsonFile.h>
+#include <json/JsonMngr.h>
+
+namespace
+{
+    // forward id and its first parameter, in the order the forwards were executed
+    std::vector<std::pair<int, cell>> g_Forwards;
+
+    int RecordForward(int id, ...)
+    {
+        va_list params;
+        va_start(params, id);
+        g_Forwards.emplace_back(id, va_arg(params, cell));
+        va_end(params);
+        return 0;
+    }
+
+    void UnregisterForward(int /*id*/)
+    {
+    }
+
+    class JsonAsyncIOTest : public testing::Test
+    {
+    protected:
+        std::string path_ = (std::filesystem::temp_directory_path() / "ezjson_async_io_test.json").string();
+        AMX amx_{};
+        JSONMngr json_mngr_;
+
+        void SetUp() override
+        {
+            g_Forwards.clear();
+            g_fn_ExecuteForward = RecordForward;
+            g_fn_UnregisterSPForward = UnregisterForward;
+            std::remove(path_.c_str());
+        }
+
+        void TearDown() override
+        {
+            g_fn_ExecuteForward = nullptr;
+            g_fn_UnregisterSPForward = nullptr;
+            std::remove(path_.c_str());
+        }
+
+        void Save(JSONAsyncIO &async_io, const std::string &json, int callback_id)
+        {
+            async_io.SerialToFile(&amx_, path_, json_parse_string(json.c_str()), false, callback_id, nullptr, 0);
+        }
+
+        void WaitForPending(JSONAsyncIO &async_io)
+        {
+            for (int i = 0; i < 500 && async_io.GetPendingCount() > 0; ++i)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                async_io.RunFrame(json_mngr_);
+            }
+        }
+
+        double LoadNumber(const char *name)
+        {
+            JSON_Value *value = AMXX::JSONParseFile(path_.c_str(), false);
+            const double number = value ? json_object_get_number(json_object(value), name) : -1.0;
+            json_value_free(value);
+            return number;
+        }
+    };
+}
+
+TEST_F(JsonAsyncIOTest, SavesOfSamePathKeepTheirOrder)
+{
+    JSONAsyncIO async_io;
+
+    const int kSaves = 20;
+    for (int i = 0; i < kSaves; ++i)
+        Save(async_io, "{\"n\":" + std::to_string(i) + "}", i);
+
+    WaitForPending(async_io);
+    ASSERT_EQ(0u, async_io.GetPendingCount());
+
+    // the workers run in parallel, only the per-path order makes the last save win
+    EXPECT_EQ(kSaves - 1, LoadNumber("n"));
+    ASSERT_EQ(static_cast<size_t>(kSaves), g_Forwards.size());
+    for (const auto &forward : g_Forwards)
+        EXPECT_EQ(1, forward.second);
+}
+
+TEST_F(JsonAsyncIOTest, LoadWaitsForSaveOfSamePath)
+{
+    JSONAsyncIO async_io;
+
+    Save(async_io, R"({"kills":10})", 1);
+    async_io.ParseFile(&amx_, path_, false, 2, nullptr, 0);
+
+    WaitForPending(async_io);
+    ASSERT_EQ(2u, g_Forwards.size());
+
+    const auto &load = g_Forwards[0].first == 2 ? g_Forwards[0] : g_Forwards[1];
+    ASSERT_TRUE(json_mngr_.IsValidHandle(load.second));
+    EXPECT_EQ(10.0, json_mngr_.ObjectGetNum(load.second, "kills", false));
+}
+
+TEST_F(JsonAsyncIOTest, DropPendingKeepsSaves)
+{
+    {
+        JSONAsyncIO async_io;
+        Save(async_io, R"({"round":1})", 1);
+        Save(async_io, R"({"round":2})", 2);
+
+        async_io.DropPending();
+        EXPECT_EQ(0u, async_io.GetPendingCount());
+    }
+
+    // the saves are written before the workers stop, only their forwards are dropped
+    EXPECT_EQ(2.0, LoadNumber("round"));
+    EXPECT_TRUE(g_Forwards.empty());
+}
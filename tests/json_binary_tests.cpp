@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include <json/JsonBinary.h>
+
+using namespace AMXX;
+
+namespace
+{
+    const char *kDocument = R"({"name":"de_dust2","players":[1,-2,300,-70000,4294967296],"ratio":0.25,"ok":true,"none":null,"nested":{"empty":[],"text":"привет"}})";
+
+    std::string Encode(const char *json, JSONBinaryFormat format)
+    {
+        JSON_Value *value = json_parse_string(json);
+        std::string out;
+        EXPECT_TRUE(JSONToBinary(value, format, out));
+        json_value_free(value);
+        return out;
+    }
+
+    bool DecodesTo(const std::string &data, JSONBinaryFormat format, const char *json)
+    {
+        JSON_Value *decoded = JSONFromBinary(data.data(), data.size(), format);
+        JSON_Value *expected = json_parse_string(json);
+        bool equals = decoded && json_value_equals(decoded, expected) == 1;
+        json_value_free(decoded);
+        json_value_free(expected);
+        return equals;
+    }
+}
+
+TEST(JsonBinaryTest, RoundTripPreservesDocument)
+{
+    for (auto format : {Binary_MessagePack, Binary_CBOR})
+    {
+        EXPECT_TRUE(DecodesTo(Encode(kDocument, format), format, kDocument)) << "format " << format;
+    }
+}
+
+TEST(JsonBinaryTest, IntegersUseCompactEncoding)
+{
+    EXPECT_EQ(std::string("\x92\x05\xFF", 3), Encode("[5,-1]", Binary_MessagePack));
+    EXPECT_EQ(std::string("\x82\x05\x20", 3), Encode("[5,-1]", Binary_CBOR));
+    EXPECT_EQ(std::string("\xCD\x01\x2C", 3), Encode("300", Binary_MessagePack));
+    EXPECT_EQ(std::string("\x19\x01\x2C", 3), Encode("300", Binary_CBOR));
+}
+
+TEST(JsonBinaryTest, DecodesCborSpecificItems)
+{
+    // half float 1.5, tagged string, indefinite array of chunked text
+    EXPECT_TRUE(DecodesTo(std::string("\xF9\x3E\x00", 3), Binary_CBOR, "1.5"));
+    EXPECT_TRUE(DecodesTo(std::string("\xC1\x61\x61", 3), Binary_CBOR, R"("a")"));
+    EXPECT_TRUE(DecodesTo(std::string("\x9F\x7F\x61\x61\x61\x62\xFF\xFF", 8), Binary_CBOR, R"(["ab"])"));
+}
+
+TEST(JsonBinaryTest, NonStringKeysAreConvertedToStrings)
+{
+    EXPECT_TRUE(DecodesTo(std::string("\x81\x01\xC3", 3), Binary_MessagePack, R"({"1":true})"));
+}
+
+TEST(JsonBinaryTest, MalformedInputIsRejected)
+{
+    const std::string msgpack_cases[] = {
+        std::string(),
+        std::string("\xA5\x61\x62", 3),         // string longer than the input
+        std::string("\xDD\xFF\xFF\xFF\xFF", 5), // huge array count
+        std::string("\xC1", 1),                 // reserved type
+        std::string("\xD4\x01\x00", 3),         // ext type
+        std::string("\xA1\xFF", 2),             // invalid UTF-8
+        std::string("\x01\x02", 2),             // trailing bytes
+    };
+    for (const auto &data : msgpack_cases)
+    {
+        EXPECT_EQ(nullptr, JSONFromBinary(data.data(), data.size(), Binary_MessagePack));
+    }
+
+    const std::string cbor_cases[] = {
+        std::string("\x1C", 1),                 // reserved additional info
+        std::string("\x9F\x01", 2),             // missing break
+        std::string("\x7F\x41\x61\xFF", 4),     // byte chunk inside text string
+        std::string("\xF8\x20", 2),             // unsupported simple value
+    };
+    for (const auto &data : cbor_cases)
+    {
+        EXPECT_EQ(nullptr, JSONFromBinary(data.data(), data.size(), Binary_CBOR));
+    }
+}
+
+TEST(JsonBinaryTest, DeepNestingIsRejected)
+{
+    std::string data(100000, '\x91');
+    data.push_back('\xC0');
+
+    EXPECT_EQ(nullptr, JSONFromBinary(data.data(), data.size(), Binary_MessagePack));
+}
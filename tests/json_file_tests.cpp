@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <json/JsonFile.h>
+
+using namespace AMXX;
+
+namespace
+{
+    class JsonFileTest : public testing::Test
+    {
+    protected:
+        std::string path_ = (std::filesystem::temp_directory_path() / "ezjson_file_test.json").string();
+
+        void TearDown() override
+        {
+            std::remove(path_.c_str());
+        }
+
+        // temp files are named <path>.<pid>.<counter>.tmp
+        size_t CountTempFiles() const
+        {
+            const std::string prefix = std::filesystem::path(path_).filename().string() + ".";
+            size_t count = 0;
+            for (const auto &entry : std::filesystem::directory_iterator(std::filesystem::path(path_).parent_path()))
+            {
+                const std::string name = entry.path().filename().string();
+                if (name.compare(0, prefix.length(), prefix) == 0 && name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0)
+                    ++count;
+            }
+
+            return count;
+        }
+
+        void WriteFile(const std::string &contents)
+        {
+            std::ofstream file(path_, std::ios::binary | std::ios::trunc);
+            file << contents;
+        }
+    };
+}
+
+TEST_F(JsonFileTest, ParsesFile)
+{
+    WriteFile(R"({"map":"de_dust2","rounds":[1,2,3]})");
+
+    JSON_Value *value = JSONParseFile(path_.c_str(), false);
+    ASSERT_NE(nullptr, value);
+    EXPECT_STREQ("de_dust2", json_object_get_string(json_object(value), "map"));
+    EXPECT_EQ(3u, json_array_get_count(json_object_get_array(json_object(value), "rounds")));
+    json_value_free(value);
+}
+
+TEST_F(JsonFileTest, ParsesFileWithComments)
+{
+    WriteFile("/* config */ {\"a\": 1 // trailing\n}");
+
+    EXPECT_EQ(nullptr, JSONParseFile(path_.c_str(), false));
+
+    JSON_Value *value = JSONParseFile(path_.c_str(), true);
+    ASSERT_NE(nullptr, value);
+    EXPECT_EQ(1.0, json_object_get_number(json_object(value), "a"));
+    json_value_free(value);
+}
+
+TEST_F(JsonFileTest, ParsesFileEndingOnPageBoundary)
+{
+    const size_t size = 4096 * 2;
+    const std::string prefix = R"({"padding":")";
+    const std::string suffix = R"("})";
+    WriteFile(prefix + std::string(size - prefix.length() - suffix.length(), 'x') + suffix);
+
+    JSON_Value *value = JSONParseFile(path_.c_str(), false);
+    ASSERT_NE(nullptr, value);
+    EXPECT_EQ(size - prefix.length() - suffix.length(), json_object_get_string_len(json_object(value), "padding"));
+    json_value_free(value);
+}
+
+TEST_F(JsonFileTest, FailsOnMissingOrEmptyFile)
+{
+    EXPECT_EQ(nullptr, JSONParseFile(path_.c_str(), false));
+
+    WriteFile("");
+    EXPECT_EQ(nullptr, JSONParseFile(path_.c_str(), false));
+}
+
+TEST_F(JsonFileTest, SerialToFileReplacesFileAtomically)
+{
+    WriteFile(R"({"old":true})");
+
+    JSON_Value *value = json_parse_string(R"({"kills":10,"name":"player"})");
+    ASSERT_TRUE(JSONSerialToFile(value, path_.c_str(), true));
+    ASSERT_TRUE(JSONSerialToFile(value, path_.c_str(), true, true));
+    EXPECT_EQ(0u, CountTempFiles());
+
+    JSON_Value *loaded = JSONParseFile(path_.c_str(), false);
+    ASSERT_NE(nullptr, loaded);
+    EXPECT_TRUE(json_value_equals(value, loaded));
+
+    json_value_free(loaded);
+    json_value_free(value);
+}
+
+TEST_F(JsonFileTest, SerialToFileFailsOnMissingDirectory)
+{
+    JSON_Value *value = json_value_init_null();
+    std::string path = path_ + ".missing/file.json";
+
+    EXPECT_FALSE(JSONSerialToFile(value, path.c_str(), false));
+    EXPECT_FALSE(std::filesystem::exists(path));
+
+    json_value_free(value);
+}
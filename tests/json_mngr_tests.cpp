@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+
+#include <json/JsonMngr.h>
+
+TEST(JsonMngrTest, FreedHandlesAreRecycledInFifoOrder)
+{
+    JSONMngr json_mngr;
+
+    JS_Handle first, second, third;
+    ASSERT_TRUE(json_mngr.InitObject(&first));
+    ASSERT_TRUE(json_mngr.InitArray(&second));
+    ASSERT_TRUE(json_mngr.InitNull(&third));
+
+    json_mngr.Free(second);
+    json_mngr.Free(first);
+
+    EXPECT_FALSE(json_mngr.IsValidHandle(first));
+    EXPECT_FALSE(json_mngr.IsValidHandle(second));
+    EXPECT_TRUE(json_mngr.IsValidHandle(third));
+
+    JS_Handle reused1, reused2, fresh;
+    ASSERT_TRUE(json_mngr.InitNum(1.0, &reused1));
+    ASSERT_TRUE(json_mngr.InitNum(2.0, &reused2));
+    ASSERT_TRUE(json_mngr.InitNum(3.0, &fresh));
+
+    EXPECT_EQ(second, reused1);
+    EXPECT_EQ(first, reused2);
+    EXPECT_EQ(third + 1, fresh);
+    EXPECT_TRUE(json_mngr.IsValidHandle(reused1));
+    EXPECT_FALSE(json_mngr.IsValidHandle(reused1, Handle_Object));
+}
+
+TEST(JsonMngrTest, InvalidHandlesAreRejected)
+{
+    JSONMngr json_mngr;
+
+    EXPECT_FALSE(json_mngr.IsValidHandle(-1));
+    EXPECT_FALSE(json_mngr.IsValidHandle(0));
+
+    JS_Handle handle;
+    ASSERT_TRUE(json_mngr.InitObject(&handle));
+    EXPECT_TRUE(json_mngr.IsValidHandle(handle, Handle_Object));
+    EXPECT_FALSE(json_mngr.IsValidHandle(handle, Handle_Array));
+
+    json_mngr.Free(handle);
+    json_mngr.Free(handle);
+    EXPECT_FALSE(json_mngr.IsValidHandle(handle));
+}
+
+TEST(JsonMngrTest, OwnerStatsTrackLiveHandles)
+{
+    JSONMngr json_mngr;
+    auto plugin_a = reinterpret_cast<AMX *>(0x1000);
+    auto plugin_b = reinterpret_cast<AMX *>(0x2000);
+
+    JS_Handle a1, a2, b1;
+    json_mngr.SetOwner(plugin_a);
+    ASSERT_TRUE(json_mngr.InitObject(&a1));
+    ASSERT_TRUE(json_mngr.InitObject(&a2));
+    json_mngr.SetOwner(plugin_b);
+    ASSERT_TRUE(json_mngr.InitObject(&b1));
+
+    json_mngr.Free(a1);
+
+    auto stats_a = json_mngr.GetOwnerStats(plugin_a);
+    ASSERT_NE(nullptr, stats_a);
+    EXPECT_EQ(2u, stats_a->m_Created);
+    EXPECT_EQ(1u, stats_a->m_Freed);
+    EXPECT_EQ(1u, stats_a->m_Live);
+    EXPECT_EQ(2u, stats_a->m_Peak);
+
+    auto stats_b = json_mngr.GetOwnerStats(plugin_b);
+    ASSERT_NE(nullptr, stats_b);
+    EXPECT_EQ(1u, stats_b->m_Live);
+
+    json_mngr.FreeAllHandles();
+    EXPECT_EQ(nullptr, json_mngr.GetOwnerStats(plugin_a));
+    EXPECT_FALSE(json_mngr.IsValidHandle(a2));
+}
+
+TEST(JsonMngrTest, FreeOwnerHandlesReleasesOnlyOwnedHandles)
+{
+    JSONMngr json_mngr;
+    auto plugin_a = reinterpret_cast<AMX *>(0x1000);
+    auto plugin_b = reinterpret_cast<AMX *>(0x2000);
+
+    JS_Handle a1, a2, b1;
+    json_mngr.SetOwner(plugin_a);
+    ASSERT_TRUE(json_mngr.Parse("{\"key\": \"value\"}", &a1, false, false));
+    ASSERT_TRUE(json_mngr.ObjectGetValue(a1, "key", &a2, false));
+    json_mngr.SetOwner(plugin_b);
+    ASSERT_TRUE(json_mngr.InitString("value", &b1));
+
+    EXPECT_EQ(json_mngr.SerialSize(a1, false), json_mngr.GetOwnerBytes(plugin_a));
+    EXPECT_EQ(2u, json_mngr.FreeOwnerHandles(plugin_a));
+
+    EXPECT_FALSE(json_mngr.IsValidHandle(a1));
+    EXPECT_FALSE(json_mngr.IsValidHandle(a2));
+    EXPECT_TRUE(json_mngr.IsValidHandle(b1));
+    EXPECT_EQ(0u, json_mngr.GetOwnerStats(plugin_a)->m_Live);
+    EXPECT_EQ(0u, json_mngr.GetOwnerBytes(plugin_a));
+}
+
+TEST(JsonMngrTest, OwnerLimit)
+{
+    JSONMngr json_mngr;
+    auto plugin = reinterpret_cast<AMX *>(0x1000);
+
+    json_mngr.SetMaxHandlesPerOwner(2);
+    json_mngr.SetOwner(plugin);
+    EXPECT_FALSE(json_mngr.IsOwnerAtLimit(plugin));
+
+    JS_Handle h1, h2;
+    ASSERT_TRUE(json_mngr.InitNull(&h1));
+    ASSERT_TRUE(json_mngr.InitNull(&h2));
+    EXPECT_TRUE(json_mngr.IsOwnerAtLimit(plugin));
+
+    json_mngr.Free(h1);
+    EXPECT_FALSE(json_mngr.IsOwnerAtLimit(plugin));
+
+    json_mngr.SetMaxHandlesPerOwner(0);
+    ASSERT_TRUE(json_mngr.InitNull(&h1));
+    EXPECT_FALSE(json_mngr.IsOwnerAtLimit(plugin));
+}
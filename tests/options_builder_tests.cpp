@@ -0,0 +1,61 @@
+#include <gtest/gtest.h>
+
+#include <easy_http/EasyHttpOptionsBuilder.h>
+
+using namespace ezhttp;
+
+TEST(OptionsBuilderTest, SnapshotsShareOptionsUntilChanged)
+{
+    EasyHttpOptionsBuilder builder;
+    builder.SetBody(std::string(100 * 1024, 'x'));
+
+    const RequestOptionsSnapshot first = builder.Snapshot();
+    const RequestOptionsSnapshot second = builder.Snapshot();
+    EXPECT_EQ(first.get(), second.get());
+    EXPECT_EQ(&builder.BuildOptions(), first.get());
+}
+
+TEST(OptionsBuilderTest, ChangeAfterSnapshotCopiesOptions)
+{
+    EasyHttpOptionsBuilder builder;
+    builder.SetHeader("Authorization", "Bearer old");
+
+    const RequestOptionsSnapshot sent = builder.Snapshot();
+    builder.SetHeader("Authorization", "Bearer new");
+
+    EXPECT_NE(sent.get(), &builder.BuildOptions());
+    EXPECT_EQ("Bearer old", sent->header->at("Authorization"));
+    EXPECT_EQ("Bearer new", builder.BuildOptions().header->at("Authorization"));
+
+    // the copy is not handed out yet, so it is changed in place
+    const RequestOptions *options = &builder.BuildOptions();
+    builder.SetUserAgent("test");
+    EXPECT_EQ(options, &builder.BuildOptions());
+}
+
+TEST(OptionsBuilderTest, ChangeAfterReleasedSnapshotStillCopiesOptions)
+{
+    EasyHttpOptionsBuilder builder;
+    builder.SetHeader("Authorization", "Bearer old");
+
+    // a worker could still be reading the options when it drops its reference
+    const RequestOptions *sent_options = builder.Snapshot().get();
+    builder.SetHeader("Authorization", "Bearer new");
+
+    EXPECT_NE(sent_options, &builder.BuildOptions());
+    EXPECT_EQ("Bearer new", builder.BuildOptions().header->at("Authorization"));
+}
+
+TEST(OptionsBuilderTest, CopiesOfBuilderDontShareChanges)
+{
+    EasyHttpOptionsBuilder builder;
+    builder.SetUserAgent("first");
+
+    EasyHttpOptionsBuilder copy = builder;
+    EXPECT_EQ(&builder.BuildOptions(), &copy.BuildOptions());
+
+    copy.SetUserAgent("second");
+    builder.SetUserAgent("third");
+    EXPECT_EQ("second", copy.BuildOptions().user_agent->str());
+    EXPECT_EQ("third", builder.BuildOptions().user_agent->str());
+}
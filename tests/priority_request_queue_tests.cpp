@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+
+#include <easy_http/PriorityRequestQueue.h>
+
+using namespace ezhttp;
+
+TEST(PriorityRequestQueueTest, ServesHigherPriorityFirstAndKeepsFifoWithinLevel)
+{
+    PriorityRequestQueue<int> queue;
+    queue.Push(RequestPriority::Low, 1);
+    queue.Push(RequestPriority::Normal, 2);
+    queue.Push(RequestPriority::High, 3);
+    queue.Push(RequestPriority::Normal, 4);
+
+    EXPECT_EQ(4u, queue.Size());
+    EXPECT_EQ(2u, queue.Size(RequestPriority::Normal));
+
+    EXPECT_EQ(3, queue.Pop());
+    EXPECT_EQ(2, queue.Pop());
+    EXPECT_EQ(4, queue.Pop());
+    EXPECT_EQ(1, queue.Pop());
+    EXPECT_TRUE(queue.Empty());
+}
+
+TEST(PriorityRequestQueueTest, StarvingLevelGetsServed)
+{
+    const int starvation_limit = 3;
+    PriorityRequestQueue<int> queue(starvation_limit);
+    queue.Push(RequestPriority::Low, -1);
+    for (int i = 0; i < 10; ++i)
+        queue.Push(RequestPriority::High, i);
+
+    for (int i = 0; i < starvation_limit; ++i)
+        EXPECT_EQ(i, queue.Pop());
+
+    EXPECT_EQ(-1, queue.Pop());
+    EXPECT_EQ(starvation_limit, queue.Pop());
+    EXPECT_EQ(0u, queue.Size(RequestPriority::Low));
+}
+
+TEST(PriorityRequestQueueTest, BypassCounterResetsWhenLevelIsEmpty)
+{
+    PriorityRequestQueue<int> queue(2);
+    queue.Push(RequestPriority::High, 1);
+    queue.Push(RequestPriority::High, 2);
+    EXPECT_EQ(1, queue.Pop());
+    EXPECT_EQ(2, queue.Pop());
+
+    // normal level was empty while high was served, so it has not starved yet
+    queue.Push(RequestPriority::Normal, 3);
+    queue.Push(RequestPriority::High, 4);
+    EXPECT_EQ(4, queue.Pop());
+    EXPECT_EQ(3, queue.Pop());
+
+    queue.Push(RequestPriority::Low, 5);
+    queue.Clear();
+    EXPECT_TRUE(queue.Empty());
+    EXPECT_EQ(0u, queue.Size(RequestPriority::Low));
+}
@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+
+#include <easy_http/RateLimiter.h>
+
+using namespace ezhttp;
+using namespace std::chrono_literals;
+
+TEST(RateLimiterTest, KeyWithoutLimitIsNotThrottled)
+{
+    RateLimiter limiter;
+    const auto now = RateLimiter::Clock::now();
+    RateLimiter::Clock::time_point retry_at;
+
+    for (int i = 0; i < 100; ++i)
+        EXPECT_TRUE(limiter.TryAcquire("example.com", now, retry_at));
+}
+
+TEST(RateLimiterTest, BurstThenRefillsAtRate)
+{
+    RateLimiter limiter;
+    limiter.SetLimit("example.com", 2.0, 3);
+
+    const auto now = RateLimiter::Clock::now();
+    RateLimiter::Clock::time_point retry_at;
+
+    for (int i = 0; i < 3; ++i)
+        EXPECT_TRUE(limiter.TryAcquire("example.com", now, retry_at));
+
+    EXPECT_FALSE(limiter.TryAcquire("example.com", now, retry_at));
+    const double wait_ms = std::chrono::duration<double, std::milli>(retry_at - now).count();
+    EXPECT_NEAR(500.0, wait_ms, 1.0);
+
+    EXPECT_FALSE(limiter.TryAcquire("example.com", now + 400ms, retry_at));
+    EXPECT_TRUE(limiter.TryAcquire("example.com", now + 600ms, retry_at));
+    EXPECT_FALSE(limiter.TryAcquire("example.com", now + 600ms, retry_at));
+
+    // other keys are independent
+    EXPECT_TRUE(limiter.TryAcquire("other.com", now, retry_at));
+}
+
+TEST(RateLimiterTest, RefundReturnsToken)
+{
+    RateLimiter limiter;
+    limiter.SetLimit(std::string(), 1.0, 1);
+
+    const auto now = RateLimiter::Clock::now();
+    RateLimiter::Clock::time_point retry_at;
+
+    EXPECT_TRUE(limiter.TryAcquire(std::string(), now, retry_at));
+    limiter.Refund(std::string());
+    EXPECT_TRUE(limiter.TryAcquire(std::string(), now, retry_at));
+    EXPECT_FALSE(limiter.TryAcquire(std::string(), now, retry_at));
+}
+
+TEST(RateLimiterTest, BlockHoldsKeyWithoutLimit)
+{
+    RateLimiter limiter;
+    const auto now = RateLimiter::Clock::now();
+    RateLimiter::Clock::time_point retry_at;
+
+    limiter.BlockUntil("example.com", now + 2s);
+    EXPECT_FALSE(limiter.TryAcquire("example.com", now + 1s, retry_at));
+    EXPECT_EQ(now + 2s, retry_at);
+    EXPECT_TRUE(limiter.TryAcquire("example.com", now + 2s, retry_at));
+}
+
+TEST(RateLimiterTest, ReadsServerRateLimitHeaders)
+{
+    const std::time_t now = 1700000000;
+
+    EXPECT_EQ(std::chrono::milliseconds(3000), RateLimiter::GetServerBlockDuration(429, cpr::Header{{"Retry-After", "3"}}, now));
+    EXPECT_EQ(std::nullopt, RateLimiter::GetServerBlockDuration(200, cpr::Header{{"Retry-After", "3"}}, now));
+
+    const cpr::Header discord_header{{"X-RateLimit-Remaining", "0"}, {"X-RateLimit-Reset-After", "1.5"}};
+    EXPECT_EQ(std::chrono::milliseconds(1500), RateLimiter::GetServerBlockDuration(200, discord_header, now));
+
+    const cpr::Header epoch_header{{"X-RateLimit-Remaining", "0"}, {"X-RateLimit-Reset", "1700000010"}};
+    EXPECT_EQ(std::chrono::milliseconds(10000), RateLimiter::GetServerBlockDuration(200, epoch_header, now));
+
+    const cpr::Header remaining_header{{"X-RateLimit-Remaining", "5"}, {"X-RateLimit-Reset", "30"}};
+    EXPECT_EQ(std::nullopt, RateLimiter::GetServerBlockDuration(200, remaining_header, now));
+
+    const auto capped = RateLimiter::GetServerBlockDuration(503, cpr::Header{{"Retry-After", "86400"}}, now);
+    EXPECT_EQ(std::chrono::milliseconds(RateLimiter::kMaxServerBlockSeconds * 1000), capped);
+}
@@ -0,0 +1,51 @@
+#include <gtest/gtest.h>
+
+#include <easy_http/EasyHttpOptionsBuilder.h>
+#include <easy_http/RequestCoalescing.h>
+
+using namespace ezhttp;
+
+TEST(RequestCoalescingTest, IdenticalGetsShareKey)
+{
+    EasyHttpOptionsBuilder first;
+    first.SetHeader("Accept", "application/json");
+    first.AddUrlParameter("map", "de_dust2");
+
+    EasyHttpOptionsBuilder second;
+    second.SetHeader("Accept", "application/json");
+    second.AddUrlParameter("map", "de_dust2");
+
+    const cpr::Url url{"https://example.com/config"};
+    const auto first_key = GetCoalescingKey(RequestMethod::HttpGet, url, first.BuildOptions());
+    const auto second_key = GetCoalescingKey(RequestMethod::HttpGet, url, second.BuildOptions());
+
+    ASSERT_TRUE(first_key);
+    EXPECT_EQ(*first_key, *second_key);
+}
+
+TEST(RequestCoalescingTest, DifferentOptionsGetDifferentKeys)
+{
+    const cpr::Url url{"https://example.com/config"};
+
+    EasyHttpOptionsBuilder plain;
+    EasyHttpOptionsBuilder with_header;
+    with_header.SetHeader("Authorization", "Bearer token");
+    EasyHttpOptionsBuilder with_parameter;
+    with_parameter.AddUrlParameter("map", "de_dust2");
+
+    const auto plain_key = GetCoalescingKey(RequestMethod::HttpGet, url, plain.BuildOptions());
+    EXPECT_NE(plain_key, GetCoalescingKey(RequestMethod::HttpGet, url, with_header.BuildOptions()));
+    EXPECT_NE(plain_key, GetCoalescingKey(RequestMethod::HttpGet, url, with_parameter.BuildOptions()));
+    EXPECT_NE(plain_key, GetCoalescingKey(RequestMethod::HttpGet, cpr::Url{"https://example.com/other"}, plain.BuildOptions()));
+}
+
+TEST(RequestCoalescingTest, OnlyPlainGetsAreCoalesced)
+{
+    const cpr::Url url{"https://example.com/config"};
+
+    EasyHttpOptionsBuilder options;
+    EXPECT_FALSE(GetCoalescingKey(RequestMethod::HttpPost, url, options.BuildOptions()));
+
+    options.SetBody("data");
+    EXPECT_FALSE(GetCoalescingKey(RequestMethod::HttpGet, url, options.BuildOptions()));
+}
@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <easy_http/RequestExecutor.h>
+
+using namespace ezhttp;
+
+namespace
+{
+    class FakeChannel : public RequestExecutor::Channel
+    {
+    public:
+        std::mutex mutex;
+        std::condition_variable cv;
+        int max_concurrency = 1;
+        int pending = 0;
+        int running = 0;
+        int max_running_seen = 0;
+        int completed = 0;
+        bool release = false;
+
+        bool RunNext() override
+        {
+            std::unique_lock lock(mutex);
+            if (pending == 0 || running >= max_concurrency)
+                return false;
+
+            --pending;
+            ++running;
+            max_running_seen = std::max(max_running_seen, running);
+            cv.notify_all();
+
+            cv.wait(lock, [this]() { return release; });
+
+            --running;
+            ++completed;
+            cv.notify_all();
+            return true;
+        }
+
+        void Release()
+        {
+            std::lock_guard lock(mutex);
+            release = true;
+            cv.notify_all();
+        }
+
+        template <typename Predicate>
+        bool WaitFor(Predicate predicate)
+        {
+            std::unique_lock lock(mutex);
+            return cv.wait_for(lock, std::chrono::seconds(5), predicate);
+        }
+    };
+}
+
+TEST(RequestExecutorTest, StartsWorkersOnDemandUpToMax)
+{
+    RequestExecutor executor(2, 0);
+    EXPECT_EQ(0, executor.GetWorkerCount());
+
+    FakeChannel first;
+    FakeChannel second;
+    FakeChannel third;
+    first.pending = second.pending = third.pending = 1;
+
+    executor.Notify(&first);
+    executor.Notify(&second);
+    executor.Notify(&third);
+    EXPECT_EQ(2, executor.GetWorkerCount());
+
+    first.Release();
+    second.Release();
+    third.Release();
+    EXPECT_TRUE(third.WaitFor([&third]() { return third.completed == 1; }));
+
+    executor.RemoveChannel(&first);
+    executor.RemoveChannel(&second);
+    executor.RemoveChannel(&third);
+}
+
+TEST(RequestExecutorTest, KeepsMinThreads)
+{
+    RequestExecutor executor(8, 3);
+    EXPECT_EQ(3, executor.GetWorkerCount());
+
+    executor.SetMinThreads(5);
+    EXPECT_EQ(5, executor.GetWorkerCount());
+
+    executor.SetMinThreads(100);
+    EXPECT_EQ(8, executor.GetWorkerCount());
+}
+
+TEST(RequestExecutorTest, ChannelConcurrencyCapIsRespected)
+{
+    RequestExecutor executor(4, 4);
+
+    FakeChannel channel;
+    channel.pending = 3;
+    for (int i = 0; i < 3; ++i)
+        executor.Notify(&channel);
+
+    EXPECT_TRUE(channel.WaitFor([&channel]() { return channel.running == 1; }));
+    channel.Release();
+
+    // the channel declined the extra notifications while busy, so it is notified again like EasyHttp does
+    for (int i = 0; i < 3; ++i)
+    {
+        EXPECT_TRUE(channel.WaitFor([&channel, i]() { return channel.completed > i; }));
+        executor.Notify(&channel);
+    }
+
+    EXPECT_TRUE(channel.WaitFor([&channel]() { return channel.completed == 3; }));
+    EXPECT_EQ(1, channel.max_running_seen);
+
+    executor.RemoveChannel(&channel);
+}
+
+TEST(RequestExecutorTest, RemoveChannelWaitsForRunningWork)
+{
+    RequestExecutor executor(1, 1);
+
+    FakeChannel channel;
+    channel.pending = 1;
+    executor.Notify(&channel);
+    EXPECT_TRUE(channel.WaitFor([&channel]() { return channel.running == 1; }));
+
+    std::atomic<bool> removed{false};
+    std::thread remover([&executor, &channel, &removed]()
+                        {
+                            executor.RemoveChannel(&channel);
+                            removed.store(true);
+                        });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_FALSE(removed.load());
+
+    channel.Release();
+    remover.join();
+
+    EXPECT_TRUE(removed.load());
+    EXPECT_EQ(1, channel.completed);
+}
@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+
+#include <easy_http/ResponseCache.h>
+
+using namespace ezhttp;
+using namespace std::chrono_literals;
+
+namespace
+{
+    Response MakeResponse(const std::string &text, cpr::Header header)
+    {
+        Response response;
+        response.status_code = 200;
+        response.header = std::move(header);
+        response.SetText(text);
+        return response;
+    }
+}
+
+TEST(ResponseCacheTest, ServesFreshResponseUntilMaxAge)
+{
+    ResponseCache cache(1024 * 1024);
+    const auto now = ResponseCache::Clock::now();
+
+    cache.Store("motd", MakeResponse("hello", {{"Cache-Control", "public, max-age=60"}}), now, 0);
+
+    auto cached = cache.Find("motd", now + 59s);
+    ASSERT_TRUE(cached);
+    EXPECT_TRUE(cached->fresh);
+    EXPECT_TRUE(cached->response.from_cache);
+    EXPECT_EQ("hello", cached->response.text());
+
+    cached = cache.Find("motd", now + 61s);
+    ASSERT_TRUE(cached);
+    EXPECT_FALSE(cached->fresh);
+
+    EXPECT_FALSE(cache.Find("rules", now));
+}
+
+TEST(ResponseCacheTest, StoresOnlyCacheableResponses)
+{
+    ResponseCache cache(1024 * 1024);
+    const auto now = ResponseCache::Clock::now();
+
+    cache.Store("no-store", MakeResponse("a", {{"Cache-Control", "no-store"}, {"ETag", "\"1\""}}), now, 0);
+    cache.Store("no-validator", MakeResponse("a", {}), now, 0);
+
+    Response not_found = MakeResponse("a", {{"Cache-Control", "max-age=60"}});
+    not_found.status_code = 404;
+    cache.Store("not-found", not_found, now, 0);
+
+    EXPECT_EQ(0u, cache.GetCount());
+
+    // must be revalidated before every use, but is kept for that
+    cache.Store("no-cache", MakeResponse("a", {{"Cache-Control", "no-cache"}, {"ETag", "\"1\""}}), now, 0);
+    auto cached = cache.Find("no-cache", now);
+    ASSERT_TRUE(cached);
+    EXPECT_FALSE(cached->fresh);
+    EXPECT_EQ("\"1\"", cached->validators["If-None-Match"]);
+}
+
+TEST(ResponseCacheTest, RevalidateRefreshesEntryAndKeepsBody)
+{
+    ResponseCache cache(1024 * 1024);
+    const auto now = ResponseCache::Clock::now();
+
+    cache.Store("bans", MakeResponse("banlist", {{"Cache-Control", "max-age=0"}, {"ETag", "\"v1\""}, {"Content-Length", "7"}}), now, 0);
+    auto stale = cache.Find("bans", now + 1s);
+    ASSERT_TRUE(stale);
+    ASSERT_FALSE(stale->fresh);
+
+    Response not_modified;
+    not_modified.status_code = 304;
+    not_modified.header = {{"Cache-Control", "max-age=30"}, {"Content-Length", "0"}};
+
+    Response response = cache.Revalidate("bans", *stale, not_modified, now + 1s, 0);
+    EXPECT_EQ(200, response.status_code);
+    EXPECT_EQ("banlist", response.text());
+    EXPECT_TRUE(response.from_cache);
+    EXPECT_EQ("7", response.header["Content-Length"]);
+
+    auto cached = cache.Find("bans", now + 20s);
+    ASSERT_TRUE(cached);
+    EXPECT_TRUE(cached->fresh);
+}
+
+TEST(ResponseCacheTest, EvictsLeastRecentlyUsedWhenOverBudget)
+{
+    const std::string body(400, 'x');
+    const cpr::Header header{{"Cache-Control", "max-age=60"}};
+    ResponseCache cache(1000);
+    const auto now = ResponseCache::Clock::now();
+
+    cache.Store("a", MakeResponse(body, header), now, 0);
+    cache.Store("b", MakeResponse(body, header), now, 0);
+    ASSERT_TRUE(cache.Find("a", now));
+
+    cache.Store("c", MakeResponse(body, header), now, 0);
+    EXPECT_TRUE(cache.Find("a", now));
+    EXPECT_FALSE(cache.Find("b", now));
+    EXPECT_TRUE(cache.Find("c", now));
+    EXPECT_LE(cache.GetSize(), 1000u);
+
+    cache.SetMaxBytes(0);
+    EXPECT_EQ(0u, cache.GetCount());
+    EXPECT_EQ(0u, cache.GetSize());
+}
+
+TEST(ResponseCacheTest, FreshnessLifetimeFromHeaders)
+{
+    EXPECT_EQ(std::optional(100s), ResponseCache::GetFreshnessLifetime({{"Cache-Control", "max-age=120"}, {"Age", "20"}}, 0));
+    EXPECT_EQ(std::optional(0s), ResponseCache::GetFreshnessLifetime({{"Pragma", "no-cache"}}, 0));
+    EXPECT_EQ(std::nullopt, ResponseCache::GetFreshnessLifetime({{"Cache-Control", "max-age=60"}, {"Vary", "*"}}, 0));
+
+    // Expires is relative to the server Date, not to the local clock
+    const cpr::Header expires_header{{"Date", "Sun, 06 Nov 1994 08:49:37 GMT"}, {"Expires", "Sun, 06 Nov 1994 08:50:37 GMT"}};
+    EXPECT_EQ(std::optional(60s), ResponseCache::GetFreshnessLifetime(expires_header, 0));
+
+    // max-age wins over Expires
+    cpr::Header both_header = expires_header;
+    both_header["Cache-Control"] = "max-age=5";
+    EXPECT_EQ(std::optional(5s), ResponseCache::GetFreshnessLifetime(both_header, 0));
+}
@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+
+#include <easy_http/Response.h>
+#include <easy_http/RetryPolicy.h>
+
+using namespace ezhttp;
+using namespace std::chrono_literals;
+
+namespace
+{
+    Response MakeResponse(long status_code, cpr::ErrorCode error_code = cpr::ErrorCode::OK)
+    {
+        Response response;
+        response.status_code = status_code;
+        response.error.code = error_code;
+        return response;
+    }
+}
+
+TEST(RetryPolicyTest, DefaultsRetryTemporaryFailures)
+{
+    RetryPolicy policy;
+
+    EXPECT_TRUE(IsRetryableResponse(policy, MakeResponse(503)));
+    EXPECT_TRUE(IsRetryableResponse(policy, MakeResponse(429)));
+    EXPECT_TRUE(IsRetryableResponse(policy, MakeResponse(0, cpr::ErrorCode::CONNECTION_FAILURE)));
+    EXPECT_TRUE(IsRetryableResponse(policy, MakeResponse(0, cpr::ErrorCode::OPERATION_TIMEDOUT)));
+
+    EXPECT_FALSE(IsRetryableResponse(policy, MakeResponse(200)));
+    EXPECT_FALSE(IsRetryableResponse(policy, MakeResponse(404)));
+    EXPECT_FALSE(IsRetryableResponse(policy, MakeResponse(0, cpr::ErrorCode::SSL_CACERT_ERROR)));
+    EXPECT_FALSE(IsRetryableResponse(policy, MakeResponse(0, cpr::ErrorCode::REQUEST_CANCELLED)));
+}
+
+TEST(RetryPolicyTest, CustomCodesReplaceDefaults)
+{
+    RetryPolicy policy;
+    policy.status_codes = {404};
+    policy.error_codes = {cpr::ErrorCode::SSL_CONNECT_ERROR};
+
+    EXPECT_TRUE(IsRetryableResponse(policy, MakeResponse(404)));
+    EXPECT_FALSE(IsRetryableResponse(policy, MakeResponse(503)));
+    EXPECT_TRUE(IsRetryableResponse(policy, MakeResponse(0, cpr::ErrorCode::SSL_CONNECT_ERROR)));
+    EXPECT_FALSE(IsRetryableResponse(policy, MakeResponse(0, cpr::ErrorCode::CONNECTION_FAILURE)));
+}
+
+TEST(RetryPolicyTest, DelayGrowsExponentiallyUpToCap)
+{
+    RetryPolicy policy;
+    policy.backoff_base = 100ms;
+    policy.backoff_cap = 1000ms;
+    policy.jitter = 0.0;
+
+    EXPECT_EQ(100ms, GetRetryDelay(policy, 1, 0.5));
+    EXPECT_EQ(200ms, GetRetryDelay(policy, 2, 0.5));
+    EXPECT_EQ(800ms, GetRetryDelay(policy, 4, 0.5));
+    EXPECT_EQ(1000ms, GetRetryDelay(policy, 5, 0.5));
+    EXPECT_EQ(1000ms, GetRetryDelay(policy, 1000, 0.5));
+}
+
+TEST(RetryPolicyTest, JitterShortensDelay)
+{
+    RetryPolicy policy;
+    policy.backoff_base = 1000ms;
+    policy.jitter = 0.5;
+
+    EXPECT_EQ(1000ms, GetRetryDelay(policy, 1, 0.0));
+    EXPECT_EQ(750ms, GetRetryDelay(policy, 1, 0.5));
+    EXPECT_EQ(500ms, GetRetryDelay(policy, 1, 1.0));
+}
@@ -1,8 +1,14 @@
+#include <atomic>
 #include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
+#include <easy_http/datetime_service/DateTimeService.h>
 #include <easy_http/session_cache/CprSessionCache.h>
+#include <easy_http/session_factory/CprSessionFactory.h>
 
 #include "CurlHolderComparer.h"
 #include "mocks/CprSessionFactoryMock.h"
@@ -164,3 +170,263 @@ TEST(CprSessionCacheTest, FreeSpaceForSessionOnReturn)
     EXPECT_CALL(*cpr_session_factory, CreateSession(IsNull()));
     auto session11 = session_cache.GetSession("https://google.com/page11.html");
 }
+
+TEST(CprSessionCacheTest, PooledHandleKeepsAppliedSettings)
+{
+    auto cpr_session_factory = std::make_shared<CprSessionFactoryMock>();
+    auto date_time_service = std::make_shared<DateTimeServiceMock>();
+
+    ezhttp::CprSessionCache session_cache(cpr_session_factory, date_time_service, 30s, 3);
+
+    EXPECT_CALL(*cpr_session_factory, CreateSession(IsNull()));
+    date_time_service->SetNow(1s);
+
+    std::optional<ezhttp::SessionSettings> settings;
+    const ezhttp::OriginId origin = session_cache.GetOrigins().InternUrl("https://google.com/");
+    auto session1 = session_cache.GetSessionForOrigin("https://google.com/page1.html", origin, &settings);
+    ASSERT_TRUE(settings);
+    EXPECT_TRUE(settings->ca_info.empty());
+
+    settings->ca_info = "cacert.pem";
+    settings->timeout_ms = 5000;
+    session_cache.ReturnSessionToOrigin(origin, session1->GetCurlHolder(), settings);
+
+    EXPECT_CALL(*cpr_session_factory, CreateSession(Truly(CurlHolderComparer(session1->GetCurlHolder()))));
+    date_time_service->SetNow(2s);
+
+    settings.reset();
+    auto session2 = session_cache.GetSessionForOrigin("https://google.com/page2.html", origin, &settings);
+    ASSERT_TRUE(settings);
+    EXPECT_EQ("cacert.pem", settings->ca_info);
+    EXPECT_EQ(5000, settings->timeout_ms);
+}
+
+TEST(CprSessionCacheTest, OriginsIncludeSchemeAndPort)
+{
+    ezhttp::OriginRegistry origins;
+
+    const ezhttp::OriginId https = origins.InternUrl("https://google.com/page1.html");
+    EXPECT_NE(0u, https);
+    EXPECT_EQ(https, origins.InternUrl("https://google.com:443/page2.html"));
+    EXPECT_NE(https, origins.InternUrl("http://google.com/page1.html"));
+    EXPECT_NE(https, origins.InternUrl("https://google.com:8443/page1.html"));
+    EXPECT_EQ(0u, origins.InternUrl("not a url"));
+    EXPECT_EQ(3u, origins.GetCount());
+
+    EXPECT_EQ("https://google.com:443", origins.GetOrigin(https));
+    EXPECT_EQ("", origins.GetOrigin(0));
+    EXPECT_EQ("", origins.GetOrigin(4));
+}
+
+TEST(CprSessionCacheTest, OriginsPastTheLimitAreNotPooled)
+{
+    auto cpr_session_factory = std::make_shared<CprSessionFactoryMock>();
+    auto date_time_service = std::make_shared<DateTimeServiceMock>();
+    auto origins = std::make_shared<ezhttp::OriginRegistry>(2);
+
+    ezhttp::CprSessionCache session_cache(cpr_session_factory, date_time_service, 30s, 3, 0, origins);
+
+    const ezhttp::OriginId first = origins->InternUrl("https://first.com/");
+    EXPECT_NE(0u, origins->InternUrl("https://second.com/"));
+    EXPECT_EQ(ezhttp::kUnpooledOrigin, origins->InternUrl("https://third.com/"));
+    EXPECT_EQ(first, origins->InternUrl("https://first.com/page.html"));
+    EXPECT_EQ(2u, origins->GetCount());
+    EXPECT_EQ("", origins->GetOrigin(ezhttp::kUnpooledOrigin));
+
+    EXPECT_CALL(*cpr_session_factory, CreateSession(IsNull())).Times(2);
+    date_time_service->SetNow(1s);
+
+    // a handle of an origin without an id is closed instead of being pooled
+    auto session1 = session_cache.GetSession("https://third.com/");
+    ASSERT_TRUE(session1);
+    session_cache.ReturnSession(*session1);
+    EXPECT_EQ(0u, session_cache.GetPooledCount());
+
+    auto session2 = session_cache.GetSession("https://third.com/");
+    ASSERT_TRUE(session2);
+    EXPECT_NE(session1->GetCurlHolder(), session2->GetCurlHolder());
+}
+
+TEST(CprSessionCacheTest, HttpAndHttpsHaveSeparatePools)
+{
+    auto cpr_session_factory = std::make_shared<CprSessionFactoryMock>();
+    auto date_time_service = std::make_shared<DateTimeServiceMock>();
+
+    ezhttp::CprSessionCache session_cache(cpr_session_factory, date_time_service, 30s, 3);
+
+    EXPECT_CALL(*cpr_session_factory, CreateSession(IsNull())).Times(2);
+    date_time_service->SetNow(1s);
+
+    auto session1 = session_cache.GetSession("https://google.com/page1.html");
+    session_cache.ReturnSession(*session1);
+
+    // a handle connected with tls is not reused for plain http
+    auto session2 = session_cache.GetSession("http://google.com/page1.html");
+    EXPECT_NE(session1->GetCurlHolder(), session2->GetCurlHolder());
+}
+
+TEST(CprSessionCacheTest, IdleSessionsAreReaped)
+{
+    auto cpr_session_factory = std::make_shared<CprSessionFactoryMock>();
+    auto date_time_service = std::make_shared<DateTimeServiceMock>();
+    auto reaper = std::make_shared<ezhttp::SessionReaper>(std::chrono::hours(1)); // swept only by ReapNow
+
+    ezhttp::CprSessionCache session_cache(cpr_session_factory, date_time_service, 30s, 3, 0, nullptr, reaper);
+
+    EXPECT_CALL(*cpr_session_factory, CreateSession(IsNull())).Times(2);
+    date_time_service->SetNow(1s);
+
+    auto session1 = session_cache.GetSession("https://google.com/page1.html");
+    auto session2 = session_cache.GetSession("https://example.com/page1.html");
+    session_cache.ReturnSession(*session1);
+    session_cache.ReturnSession(*session2);
+
+    EXPECT_CALL(*cpr_session_factory, CreateSession(Truly(CurlHolderComparer(session2->GetCurlHolder()))));
+    date_time_service->SetNow(20s);
+    auto session3 = session_cache.GetSession("https://example.com/page2.html");
+    session_cache.ReturnSession(*session3);
+
+    EXPECT_EQ(2u, session_cache.GetPooledCount());
+    EXPECT_EQ(2u, session_cache.GetHostCount());
+
+    // google.com has been idle for 30 seconds
+    date_time_service->SetNow(31s);
+    EXPECT_EQ(1u, reaper->ReapNow());
+    EXPECT_EQ(1u, session_cache.GetPooledCount());
+    EXPECT_EQ(1u, session_cache.GetHostCount());
+
+    date_time_service->SetNow(60s);
+    EXPECT_EQ(1u, reaper->ReapNow());
+    EXPECT_EQ(0u, session_cache.GetPooledCount());
+    EXPECT_EQ(0u, session_cache.GetHostCount());
+}
+
+TEST(CprSessionCacheTest, PooledSessionsAreCappedAcrossHosts)
+{
+    auto cpr_session_factory = std::make_shared<CprSessionFactoryMock>();
+    auto date_time_service = std::make_shared<DateTimeServiceMock>();
+
+    ezhttp::CprSessionCache session_cache(cpr_session_factory, date_time_service, 30s, 3, 2);
+
+    EXPECT_CALL(*cpr_session_factory, CreateSession(IsNull())).Times(4);
+
+    date_time_service->SetNow(1s);
+    auto session1 = session_cache.GetSession("https://google.com/page1.html");
+    auto session2 = session_cache.GetSession("https://example.com/page1.html");
+    auto session3 = session_cache.GetSession("https://example.org/page1.html");
+    session_cache.ReturnSession(*session1);
+
+    date_time_service->SetNow(2s);
+    session_cache.ReturnSession(*session2);
+
+    date_time_service->SetNow(3s);
+    session_cache.ReturnSession(*session3);
+    EXPECT_EQ(2u, session_cache.GetPooledCount());
+
+    // the least recently used handle was closed
+    auto session4 = session_cache.GetSession("https://google.com/page2.html");
+
+    EXPECT_CALL(*cpr_session_factory, CreateSession(Truly(CurlHolderComparer(session3->GetCurlHolder()))));
+    auto session5 = session_cache.GetSession("https://example.org/page2.html");
+}
+
+TEST(CprSessionCacheTest, ReaperCapsPooledSessionsAcrossCaches)
+{
+    auto cpr_session_factory = std::make_shared<CprSessionFactoryMock>();
+    auto date_time_service = std::make_shared<DateTimeServiceMock>();
+    auto reaper = std::make_shared<ezhttp::SessionReaper>(std::chrono::hours(1), 2); // swept only by ReapNow
+
+    // two queues of the module, neither has a cap of its own
+    ezhttp::CprSessionCache first_cache(cpr_session_factory, date_time_service, 30s, 3, 0, nullptr, reaper);
+    ezhttp::CprSessionCache second_cache(cpr_session_factory, date_time_service, 30s, 3, 0, nullptr, reaper);
+
+    EXPECT_CALL(*cpr_session_factory, CreateSession(IsNull())).Times(4);
+
+    date_time_service->SetNow(1s);
+    auto session1 = first_cache.GetSession("https://google.com/page1.html");
+    auto session2 = second_cache.GetSession("https://example.com/page1.html");
+    auto session3 = first_cache.GetSession("https://example.org/page1.html");
+    first_cache.ReturnSession(*session1);
+
+    date_time_service->SetNow(2s);
+    second_cache.ReturnSession(*session2);
+
+    date_time_service->SetNow(3s);
+    first_cache.ReturnSession(*session3);
+    EXPECT_EQ(2u, reaper->GetPooledCount());
+    EXPECT_EQ(1u, first_cache.GetPooledCount());
+    EXPECT_EQ(1u, second_cache.GetPooledCount());
+
+    // the least recently used handle of both caches was closed
+    auto session4 = first_cache.GetSession("https://google.com/page2.html");
+
+    EXPECT_CALL(*cpr_session_factory, CreateSession(Truly(CurlHolderComparer(session2->GetCurlHolder()))));
+    auto session5 = second_cache.GetSession("https://example.com/page2.html");
+    EXPECT_EQ(1u, reaper->GetPooledCount());
+}
+
+TEST(CprSessionCacheTest, DestroyedCacheLeavesReaperCount)
+{
+    auto cpr_session_factory = std::make_shared<CprSessionFactoryMock>();
+    auto date_time_service = std::make_shared<DateTimeServiceMock>();
+    auto reaper = std::make_shared<ezhttp::SessionReaper>(std::chrono::hours(1), 2);
+
+    EXPECT_CALL(*cpr_session_factory, CreateSession(IsNull())).Times(1);
+    date_time_service->SetNow(1s);
+
+    {
+        ezhttp::CprSessionCache session_cache(cpr_session_factory, date_time_service, 30s, 3, 0, nullptr, reaper);
+        auto session = session_cache.GetSession("https://google.com/page1.html");
+        session_cache.ReturnSession(*session);
+        EXPECT_EQ(1u, reaper->GetPooledCount());
+    }
+
+    EXPECT_EQ(0u, reaper->GetPooledCount());
+}
+
+TEST(CprSessionCacheTest, ReaperCapHoldsWithConcurrentSweepsAndCaches)
+{
+    auto session_factory = std::make_shared<ezhttp::CprSessionFactory>();
+    auto date_time_service = std::make_shared<ezhttp::DateTimeService>();
+    auto reaper = std::make_shared<ezhttp::SessionReaper>(std::chrono::hours(1), 4); // swept by the thread below
+
+    ezhttp::CprSessionCache first_cache(session_factory, date_time_service, 30s, 3, 0, nullptr, reaper);
+    ezhttp::CprSessionCache second_cache(session_factory, date_time_service, 30s, 3, 0, nullptr, reaper);
+
+    std::atomic<bool> done{false};
+    std::thread sweeper([&reaper, &done]()
+                        {
+                            while (!done.load())
+                                reaper->ReapNow();
+                        });
+
+    std::vector<std::thread> workers;
+    for (auto *session_cache : {&first_cache, &second_cache, &first_cache, &second_cache})
+    {
+        workers.emplace_back([session_cache]()
+                             {
+                                 for (int i = 0; i < 200; ++i)
+                                 {
+                                     auto session = session_cache->GetSession("https://host" + std::to_string(i % 8) + ".example.com/");
+                                     session_cache->ReturnSession(*session);
+                                 }
+                             });
+    }
+
+    // caches register and unregister while the others are in use
+    for (int i = 0; i < 50; ++i)
+    {
+        ezhttp::CprSessionCache short_lived_cache(session_factory, date_time_service, 30s, 3, 0, nullptr, reaper);
+        auto session = short_lived_cache.GetSession("https://example.org/");
+        short_lived_cache.ReturnSession(*session);
+    }
+
+    for (auto &worker : workers)
+        worker.join();
+
+    done.store(true);
+    sweeper.join();
+
+    EXPECT_EQ(first_cache.GetPooledCount() + second_cache.GetPooledCount(), reaper->GetPooledCount());
+    EXPECT_LE(reaper->GetPooledCount(), 4u);
+}
@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+
+#include <easy_http/session_cache/SessionSettings.h>
+
+using namespace ezhttp;
+
+namespace
+{
+    SessionSettings MakeSettings()
+    {
+        SessionSettings settings;
+        settings.ca_info = "cacert.pem";
+        settings.timeout_ms = 5000;
+        settings.SetAuth(cpr::Authentication{"user", "password", cpr::AuthMode::BASIC});
+        return settings;
+    }
+}
+
+TEST(SessionSettingsTest, UnknownHandleGetsEverything)
+{
+    const SessionSettingsDelta delta = GetSessionSettingsDelta(std::nullopt, MakeSettings());
+    EXPECT_TRUE(delta.ssl);
+    EXPECT_TRUE(delta.tls_sessions);
+    EXPECT_TRUE(delta.timeout);
+    EXPECT_TRUE(delta.connect_timeout);
+    EXPECT_TRUE(delta.connect_policy);
+    EXPECT_TRUE(delta.auth);
+}
+
+TEST(SessionSettingsTest, ReusedHandleWithSameSettingsGetsNothing)
+{
+    const std::optional<SessionSettings> applied = MakeSettings();
+    EXPECT_TRUE(GetSessionSettingsDelta(applied, MakeSettings()).Empty());
+}
+
+TEST(SessionSettingsTest, ChangedAndDroppedOptionsAreApplied)
+{
+    const std::optional<SessionSettings> applied = MakeSettings();
+
+    SessionSettings desired = MakeSettings();
+    desired.timeout_ms = 0;
+    desired.SetAuth(std::nullopt);
+
+    const SessionSettingsDelta delta = GetSessionSettingsDelta(applied, desired);
+    EXPECT_FALSE(delta.ssl);
+    EXPECT_TRUE(delta.timeout);
+    EXPECT_FALSE(delta.connect_timeout);
+    EXPECT_TRUE(delta.auth);
+}
+
+TEST(SessionSettingsTest, NewHandleWithDefaultsGetsOnlySsl)
+{
+    const std::optional<SessionSettings> applied = SessionSettings{};
+
+    SessionSettings desired;
+    desired.ca_info = "cacert.pem";
+
+    const SessionSettingsDelta delta = GetSessionSettingsDelta(applied, desired);
+    EXPECT_TRUE(delta.ssl);
+    EXPECT_FALSE(delta.timeout);
+    EXPECT_FALSE(delta.connect_timeout);
+    EXPECT_FALSE(delta.auth);
+}
+
+TEST(SessionSettingsTest, TlsSessionCacheIsAttachedOnce)
+{
+    auto tls_session_cache = std::make_shared<TlsSessionCache>();
+
+    SessionSettings desired;
+    desired.tls_session_cache = tls_session_cache;
+
+    std::optional<SessionSettings> applied = SessionSettings{};
+    EXPECT_TRUE(GetSessionSettingsDelta(applied, desired).tls_sessions);
+
+    applied = desired;
+    EXPECT_TRUE(GetSessionSettingsDelta(applied, desired).Empty());
+}
+
+TEST(SessionSettingsTest, ConnectPolicyIsAppliedOnChange)
+{
+    const std::optional<SessionSettings> applied = MakeSettings();
+
+    SessionSettings desired = MakeSettings();
+    desired.ip_resolve = CURL_IPRESOLVE_V4;
+    EXPECT_TRUE(GetSessionSettingsDelta(applied, desired).connect_policy);
+
+    desired = MakeSettings();
+    desired.resolve = "+example.com:443:10.0.0.1";
+    const SessionSettingsDelta delta = GetSessionSettingsDelta(applied, desired);
+    EXPECT_TRUE(delta.connect_policy);
+    EXPECT_FALSE(delta.timeout);
+
+    // the list built for the handle is not a setting of its own
+    std::optional<SessionSettings> pinned = desired;
+    pinned->resolve_list.reset();
+    EXPECT_TRUE(GetSessionSettingsDelta(pinned, desired).Empty());
+}
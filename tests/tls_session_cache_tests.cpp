@@ -0,0 +1,36 @@
+#include <gtest/gtest.h>
+
+#include <easy_http/session_cache/TlsSessionCache.h>
+
+using namespace ezhttp;
+
+TEST(TlsSessionCacheTest, HandlesAttachToShare)
+{
+    TlsSessionCache cache;
+    CURL *curl = curl_easy_init();
+
+    EXPECT_TRUE(cache.Attach(curl));
+    EXPECT_EQ(CURLE_OK, curl_easy_setopt(curl, CURLOPT_SHARE, nullptr));
+
+    curl_easy_cleanup(curl);
+}
+
+TEST(TlsSessionCacheTest, TransferWithoutTlsIsNotCounted)
+{
+    TlsSessionCache cache;
+    CURL *curl = curl_easy_init();
+    ASSERT_TRUE(cache.Attach(curl));
+
+    // nothing listens on the port, so the transfer never gets to a handshake
+    curl_easy_setopt(curl, CURLOPT_URL, "https://127.0.0.1:1/");
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, 1000L);
+    {
+        TlsSessionCache::TransferScope scope(cache, curl);
+        EXPECT_NE(CURLE_OK, curl_easy_perform(curl));
+    }
+
+    EXPECT_EQ(0u, cache.GetFullHandshakes());
+    EXPECT_EQ(0u, cache.GetResumedHandshakes());
+
+    curl_easy_cleanup(curl);
+}
@@ -0,0 +1,50 @@
+#include <gtest/gtest.h>
+
+#include <easy_http/UrlTemplate.h>
+
+using namespace ezhttp;
+
+TEST(UrlTemplateTest, FillsPlaceholders)
+{
+    std::string error;
+    auto url_template = UrlTemplate::Parse("https://example.com/players/{steamid}/stats?mode={mode}", error);
+    ASSERT_TRUE(url_template) << error;
+    EXPECT_EQ("example.com", url_template->GetHost());
+    EXPECT_EQ("https://example.com:443", url_template->GetOrigin());
+
+    auto url = url_template->Expand({{"steamid", "STEAM_0:1:123"}, {"mode", "last week"}}, error);
+    ASSERT_TRUE(url) << error;
+    EXPECT_EQ("https://example.com/players/STEAM_0%3A1%3A123/stats?mode=last%20week", *url);
+}
+
+TEST(UrlTemplateTest, HostIsResolvedPerRequestIfItHasPlaceholder)
+{
+    std::string error;
+    auto url_template = UrlTemplate::Parse("https://{region}.example.com/status", error);
+    ASSERT_TRUE(url_template) << error;
+    EXPECT_TRUE(url_template->GetHost().empty());
+    EXPECT_TRUE(url_template->GetOrigin().empty());
+
+    auto url = url_template->Expand({{"region", "eu"}}, error);
+    ASSERT_TRUE(url) << error;
+    EXPECT_EQ("https://eu.example.com/status", *url);
+}
+
+TEST(UrlTemplateTest, RejectsMalformedPatterns)
+{
+    std::string error;
+    EXPECT_FALSE(UrlTemplate::Parse("https://example.com/{steamid", error));
+    EXPECT_FALSE(UrlTemplate::Parse("https://example.com/{}", error));
+    EXPECT_FALSE(UrlTemplate::Parse("https://example.com/{steam id}", error));
+    EXPECT_FALSE(UrlTemplate::Parse("https://example.com/}", error));
+}
+
+TEST(UrlTemplateTest, RequiresExactlyTheTemplateValues)
+{
+    std::string error;
+    auto url_template = UrlTemplate::Parse("https://example.com/players/{steamid}", error);
+    ASSERT_TRUE(url_template) << error;
+
+    EXPECT_FALSE(url_template->Expand({}, error));
+    EXPECT_FALSE(url_template->Expand({{"steamid", "1"}, {"name", "player"}}, error));
+}